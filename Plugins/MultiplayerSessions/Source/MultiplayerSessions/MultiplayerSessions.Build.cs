@@ -40,7 +40,9 @@ public class MultiplayerSessions : ModuleRules
 			new string[]
 			{
 				"CoreUObject",
-				"Engine"
+				"Engine",
+				"Icmp",
+				"Json"
 				// "Slate",
 				// "SlateCore",
 				// ... add private dependencies that you statically link with here ...	
@@ -0,0 +1,690 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FakeOnlineSession.h"
+
+#include "MultiplayerSessionQuery.h"
+#include "OnlineSubsystemTypes.h"
+#include "Online/OnlineSessionNames.h"
+#include "Containers/Ticker.h"
+#include "Misc/ConfigCacheIni.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogFakeOnlineSession, Log, All);
+
+namespace FakeOnlineSession
+{
+	const FName SessionIdType(TEXT("FAKE"));
+
+	double ToNumber(const FVariantData& Data)
+	{
+		switch (Data.GetType())
+		{
+		case EOnlineKeyValuePairDataType::Int32: { int32 Value; Data.GetValue(Value); return Value; }
+		case EOnlineKeyValuePairDataType::UInt32: { uint32 Value; Data.GetValue(Value); return Value; }
+		case EOnlineKeyValuePairDataType::Int64: { int64 Value; Data.GetValue(Value); return static_cast<double>(Value); }
+		case EOnlineKeyValuePairDataType::UInt64: { uint64 Value; Data.GetValue(Value); return static_cast<double>(Value); }
+		case EOnlineKeyValuePairDataType::Float: { float Value; Data.GetValue(Value); return Value; }
+		case EOnlineKeyValuePairDataType::Double: { double Value; Data.GetValue(Value); return Value; }
+		default: return 0.0;
+		}
+	}
+}
+
+class FFakeSessionInfo : public FOnlineSessionInfo
+{
+public:
+	FFakeSessionInfo(const FString& InSessionId, int32 InPort)
+		: SessionId(FUniqueNetIdString::Create(InSessionId, FakeOnlineSession::SessionIdType))
+		, Port(InPort)
+	{
+	}
+
+	virtual const uint8* GetBytes() const override { return nullptr; }
+	virtual int32 GetSize() const override { return sizeof(FFakeSessionInfo); }
+	virtual bool IsValid() const override { return true; }
+	virtual const FUniqueNetId& GetSessionId() const override { return *SessionId; }
+	virtual FString ToString() const override { return SessionId->ToString(); }
+	virtual FString ToDebugString() const override { return FString::Printf(TEXT("%s at %s"), *SessionId->ToString(), *GetConnectString()); }
+
+	FString GetConnectString() const { return FString::Printf(TEXT("127.0.0.1:%d"), Port); }
+
+private:
+	FUniqueNetIdRef SessionId;
+	int32 Port;
+};
+
+FFakeSessionSimulation FFakeSessionSimulation::LoadFromConfig()
+{
+	FFakeSessionSimulation Simulation;
+	const TCHAR* Section = TEXT("MultiplayerSessions.FakeOnlineSession");
+	GConfig->GetInt(Section, TEXT("NumHosts"), Simulation.NumHosts, GGameIni);
+	GConfig->GetFloat(Section, TEXT("Latency"), Simulation.Latency, GGameIni);
+	GConfig->GetFloat(Section, TEXT("LatencyJitter"), Simulation.LatencyJitter, GGameIni);
+	GConfig->GetFloat(Section, TEXT("FailureRate"), Simulation.FailureRate, GGameIni);
+	GConfig->GetFloat(Section, TEXT("JoinRaceRate"), Simulation.JoinRaceRate, GGameIni);
+	GConfig->GetInt(Section, TEXT("NumSearchBatches"), Simulation.NumSearchBatches, GGameIni);
+	GConfig->GetInt(Section, TEXT("RandomSeed"), Simulation.RandomSeed, GGameIni);
+	return Simulation;
+}
+
+FFakeOnlineSession::FFakeOnlineSession(const FFakeSessionSimulation& InSimulation)
+	: Simulation(InSimulation)
+	, Random(InSimulation.RandomSeed)
+{
+	SeedHosts();
+}
+
+void FFakeOnlineSession::SeedHosts()
+{
+	for (int32 Index = 0; Index < Simulation.NumHosts; ++Index)
+	{
+		FOnlineSessionSettings Settings;
+		Settings.NumPublicConnections = Random.RandRange(2, 16);
+		Settings.bShouldAdvertise = true;
+		Settings.bUsesPresence = true;
+		Settings.bAllowJoinInProgress = true;
+		Settings.BuildUniqueId = 1;
+		Settings.Set(FMultiplayerSessionQuery::MatchTypeKey, Random.RandRange(0, 3) == 0 ? FString(TEXT("TeamDeathMatch")) : FString(TEXT("FreeForAll")), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		Settings.Set(FMultiplayerSessionQuery::BuildIdKey, Settings.BuildUniqueId, EOnlineDataAdvertisementType::ViaOnlineService);
+		Settings.Set(FMultiplayerSessionQuery::HostQualityKey, Random.RandRange(0, 100), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		Settings.Set(SETTING_MAPNAME, FString(TEXT("/Game/ThirdPerson/Maps/Lobby")), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		const int32 PingInMs = Random.RandRange(10, 200);
+		const int32 NumOpenPublicConnections = Random.RandRange(0, Settings.NumPublicConnections);
+		// 与真实主机一样，满员的房间不再标记为可加入
+		Settings.Set(FMultiplayerSessionQuery::JoinableKey, NumOpenPublicConnections > 0 ? 1 : 0, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		AddHost(Settings, PingInMs, NumOpenPublicConnections);
+	}
+}
+
+FString FFakeOnlineSession::AddHost(const FOnlineSessionSettings& Settings, int32 PingInMs, int32 NumOpenPublicConnections)
+{
+	FFakeHost Host;
+	Host.Session = FOnlineSession(Settings);
+	Host.Session.SessionInfo = MakeSessionInfo();
+	Host.Session.NumOpenPublicConnections = FMath::Clamp(NumOpenPublicConnections, 0, Settings.NumPublicConnections);
+	Host.PingInMs = PingInMs;
+
+	const FString SessionId = Host.Session.GetSessionIdStr();
+	Hosts.Add(SessionId, MoveTemp(Host));
+	return SessionId;
+}
+
+void FFakeOnlineSession::RemoveAllHosts()
+{
+	Hosts.Reset();
+}
+
+TSharedRef<FOnlineSessionInfo> FFakeOnlineSession::MakeSessionInfo()
+{
+	const int32 Port = NextPort++;
+	return MakeShared<FFakeSessionInfo>(FString::Printf(TEXT("FakeSession-%d"), Port), Port);
+}
+
+float FFakeOnlineSession::NextLatency()
+{
+	return FMath::Max(0.f, Simulation.Latency + Random.FRandRange(-Simulation.LatencyJitter, Simulation.LatencyJitter));
+}
+
+bool FFakeOnlineSession::RollFailure()
+{
+	return Random.FRand() < Simulation.FailureRate;
+}
+
+void FFakeOnlineSession::CompleteLater(TFunction<void()> Completion, float Delay)
+{
+	TWeakPtr<FFakeOnlineSession, ESPMode::ThreadSafe> WeakThis = AsShared();
+	FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis, Completion = MoveTemp(Completion)](float)
+	{
+		if (const TSharedPtr<FFakeOnlineSession, ESPMode::ThreadSafe> Pinned = WeakThis.Pin())
+		{
+			Completion();
+		}
+		return false;
+	}), Delay < 0.f ? NextLatency() : Delay);
+}
+
+bool FFakeOnlineSession::PassesQuery(const FOnlineSessionSearch& Search, const FOnlineSession& Session) const
+{
+	for (const TPair<FName, FOnlineSessionSearchParam>& Param : Search.QuerySettings.SearchParams)
+	{
+		if (Param.Key == SEARCH_MINSLOTSAVAILABLE)
+		{
+			if (Session.NumOpenPublicConnections < FakeOnlineSession::ToNumber(Param.Value.Data)) return false;
+			continue;
+		}
+		// Backend switches rather than advertised settings
+		if (Param.Key == SEARCH_LOBBIES || Param.Key == SEARCH_PRESENCE)
+		{
+			continue;
+		}
+
+		const FOnlineSessionSetting* Setting = Session.SessionSettings.Settings.Find(Param.Key);
+		if (Setting == nullptr) return false;
+
+		const double Advertised = FakeOnlineSession::ToNumber(Setting->Data);
+		const double Wanted = FakeOnlineSession::ToNumber(Param.Value.Data);
+		switch (Param.Value.ComparisonOp)
+		{
+		case EOnlineComparisonOp::Equals:
+			if (!(Setting->Data == Param.Value.Data)) return false;
+			break;
+		case EOnlineComparisonOp::NotEquals:
+			if (Setting->Data == Param.Value.Data) return false;
+			break;
+		case EOnlineComparisonOp::GreaterThan:
+			if (!(Advertised > Wanted)) return false;
+			break;
+		case EOnlineComparisonOp::GreaterThanEquals:
+			if (!(Advertised >= Wanted)) return false;
+			break;
+		case EOnlineComparisonOp::LessThan:
+			if (!(Advertised < Wanted)) return false;
+			break;
+		case EOnlineComparisonOp::LessThanEquals:
+			if (!(Advertised <= Wanted)) return false;
+			break;
+		default:
+			// Near/In/NotIn are only ranking hints on most backends
+			break;
+		}
+	}
+	return true;
+}
+
+void FFakeOnlineSession::SetNumOpenPublicConnections(FNamedOnlineSession& Session, int32 NumOpenPublicConnections)
+{
+	Session.NumOpenPublicConnections = FMath::Clamp(NumOpenPublicConnections, 0, Session.SessionSettings.NumPublicConnections);
+	// 只有自己主持的会话才对应一个广播中的主机
+	if (FFakeHost* Host = Session.bHosting ? Hosts.Find(Session.GetSessionIdStr()) : nullptr)
+	{
+		Host->Session.NumOpenPublicConnections = Session.NumOpenPublicConnections;
+	}
+}
+
+FUniqueNetIdPtr FFakeOnlineSession::CreateSessionIdFromString(const FString& SessionIdStr)
+{
+	return FUniqueNetIdString::Create(SessionIdStr, FakeOnlineSession::SessionIdType);
+}
+
+FNamedOnlineSession* FFakeOnlineSession::GetNamedSession(FName SessionName)
+{
+	return Sessions.FindByPredicate([SessionName](const FNamedOnlineSession& Session) { return Session.SessionName == SessionName; });
+}
+
+void FFakeOnlineSession::RemoveNamedSession(FName SessionName)
+{
+	Sessions.RemoveAll([SessionName](const FNamedOnlineSession& Session) { return Session.SessionName == SessionName; });
+}
+
+bool FFakeOnlineSession::HasPresenceSession()
+{
+	return Sessions.ContainsByPredicate([](const FNamedOnlineSession& Session) { return Session.SessionSettings.bUsesPresence; });
+}
+
+EOnlineSessionState::Type FFakeOnlineSession::GetSessionState(FName SessionName) const
+{
+	const FNamedOnlineSession* Session = Sessions.FindByPredicate([SessionName](const FNamedOnlineSession& Named) { return Named.SessionName == SessionName; });
+	return Session ? Session->SessionState : EOnlineSessionState::NoSession;
+}
+
+FNamedOnlineSession* FFakeOnlineSession::AddNamedSession(FName SessionName, const FOnlineSessionSettings& SessionSettings)
+{
+	return &Sessions.Emplace_GetRef(SessionName, SessionSettings);
+}
+
+FNamedOnlineSession* FFakeOnlineSession::AddNamedSession(FName SessionName, const FOnlineSession& Session)
+{
+	return &Sessions.Emplace_GetRef(SessionName, Session);
+}
+
+bool FFakeOnlineSession::CreateSession(int32 HostingPlayerNum, FName SessionName, const FOnlineSessionSettings& NewSessionSettings)
+{
+	if (GetNamedSession(SessionName) != nullptr)
+	{
+		UE_LOG(LogFakeOnlineSession, Warning, TEXT("Cannot create session '%s': session already exists"), *SessionName.ToString());
+		return false;
+	}
+
+	FNamedOnlineSession* Session = AddNamedSession(SessionName, NewSessionSettings);
+	Session->HostingPlayerNum = HostingPlayerNum;
+	Session->bHosting = true;
+	Session->SessionState = EOnlineSessionState::Creating;
+	Session->NumOpenPublicConnections = NewSessionSettings.NumPublicConnections;
+	Session->NumOpenPrivateConnections = NewSessionSettings.NumPrivateConnections;
+	Session->SessionInfo = MakeSessionInfo();
+
+	const bool bFail = RollFailure();
+	CompleteLater([this, SessionName, bFail]()
+	{
+		if (FNamedOnlineSession* Created = GetNamedSession(SessionName))
+		{
+			if (bFail)
+			{
+				RemoveNamedSession(SessionName);
+			}
+			else
+			{
+				Created->SessionState = EOnlineSessionState::Pending;
+				// Our own session shows up in searches like any other host
+				if (Created->SessionSettings.bShouldAdvertise)
+				{
+					FFakeHost& Host = Hosts.Add(Created->GetSessionIdStr());
+					Host.Session = *Created;
+				}
+			}
+		}
+		TriggerOnCreateSessionCompleteDelegates(SessionName, !bFail);
+	});
+	return true;
+}
+
+bool FFakeOnlineSession::CreateSession(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& NewSessionSettings)
+{
+	if (!CreateSession(0, SessionName, NewSessionSettings)) return false;
+
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	Session->OwningUserId = HostingPlayerId.AsShared();
+	Session->LocalOwnerId = HostingPlayerId.AsShared();
+	return true;
+}
+
+bool FFakeOnlineSession::StartSession(FName SessionName)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr) return false;
+
+	Session->SessionState = EOnlineSessionState::Starting;
+	const bool bFail = RollFailure();
+	CompleteLater([this, SessionName, bFail]()
+	{
+		if (FNamedOnlineSession* Started = GetNamedSession(SessionName))
+		{
+			Started->SessionState = bFail ? EOnlineSessionState::Pending : EOnlineSessionState::InProgress;
+		}
+		TriggerOnStartSessionCompleteDelegates(SessionName, !bFail);
+	});
+	return true;
+}
+
+bool FFakeOnlineSession::UpdateSession(FName SessionName, FOnlineSessionSettings& UpdatedSessionSettings, bool bShouldRefreshOnlineData)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr) return false;
+
+	Session->SessionSettings = UpdatedSessionSettings;
+	const FString SessionId = Session->GetSessionIdStr();
+	const bool bFail = bShouldRefreshOnlineData && RollFailure();
+	CompleteLater([this, SessionName, SessionId, bFail]()
+	{
+		FNamedOnlineSession* Updated = GetNamedSession(SessionName);
+		FFakeHost* Host = Hosts.Find(SessionId);
+		if (Updated && Host && !bFail)
+		{
+			Host->Session.SessionSettings = Updated->SessionSettings;
+		}
+		TriggerOnUpdateSessionCompleteDelegates(SessionName, !bFail);
+	}, bShouldRefreshOnlineData ? -1.f : 0.f);
+	return true;
+}
+
+bool FFakeOnlineSession::EndSession(FName SessionName)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr) return false;
+
+	Session->SessionState = EOnlineSessionState::Ending;
+	CompleteLater([this, SessionName]()
+	{
+		if (FNamedOnlineSession* Ended = GetNamedSession(SessionName))
+		{
+			Ended->SessionState = EOnlineSessionState::Ended;
+		}
+		TriggerOnEndSessionCompleteDelegates(SessionName, true);
+	});
+	return true;
+}
+
+bool FFakeOnlineSession::DestroySession(FName SessionName, const FOnDestroySessionCompleteDelegate& CompletionDelegate)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	const bool bExists = Session != nullptr;
+	// Leaving someone else's session doesn't take it off the backend
+	const FString SessionId = bExists && Session->bHosting ? Session->GetSessionIdStr() : FString();
+	if (bExists)
+	{
+		Session->SessionState = EOnlineSessionState::Destroying;
+	}
+
+	const bool bFail = bExists && RollFailure();
+	CompleteLater([this, SessionName, SessionId, bExists, bFail, CompletionDelegate]()
+	{
+		const bool bWasSuccessful = bExists && !bFail;
+		if (bWasSuccessful)
+		{
+			Hosts.Remove(SessionId);
+			RemoveNamedSession(SessionName);
+		}
+		else if (FNamedOnlineSession* Remaining = GetNamedSession(SessionName))
+		{
+			Remaining->SessionState = EOnlineSessionState::Pending;
+		}
+		CompletionDelegate.ExecuteIfBound(SessionName, bWasSuccessful);
+		TriggerOnDestroySessionCompleteDelegates(SessionName, bWasSuccessful);
+	});
+	return true;
+}
+
+bool FFakeOnlineSession::IsPlayerInSession(FName SessionName, const FUniqueNetId& UniqueId)
+{
+	const FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	return Session && Session->RegisteredPlayers.ContainsByPredicate(FUniqueNetIdMatcher(UniqueId));
+}
+
+bool FFakeOnlineSession::StartMatchmaking(const TArray<FUniqueNetIdRef>& LocalPlayers, FName SessionName, const FOnlineSessionSettings& NewSessionSettings, TSharedRef<FOnlineSessionSearch>& SearchSettings)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::CancelMatchmaking(int32 SearchingPlayerNum, FName SessionName)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::CancelMatchmaking(const FUniqueNetId& SearchingPlayerId, FName SessionName)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::FindSessions(int32 SearchingPlayerNum, const TSharedRef<FOnlineSessionSearch>& SearchSettings)
+{
+	// Like the real backends, one search at a time
+	if (CurrentSearch.IsValid()) return false;
+
+	CurrentSearch = SearchSettings;
+	SearchSettings->SearchResults.Reset();
+	SearchSettings->SearchState = EOnlineAsyncTaskState::InProgress;
+
+	// The query is evaluated up front, the matches are then handed out in batches over the search latency
+	TSharedRef<TArray<FOnlineSessionSearchResult>> Matches = MakeShared<TArray<FOnlineSessionSearchResult>>();
+	for (const TPair<FString, FFakeHost>& Pair : Hosts)
+	{
+		if (Matches->Num() >= SearchSettings->MaxSearchResults) break;
+		if (!PassesQuery(*SearchSettings, Pair.Value.Session)) continue;
+
+		FOnlineSessionSearchResult& Result = Matches->AddDefaulted_GetRef();
+		Result.Session = Pair.Value.Session;
+		Result.PingInMs = FMath::Max(0, Pair.Value.PingInMs + FMath::RoundToInt(Random.FRandRange(-Simulation.LatencyJitter, Simulation.LatencyJitter) * 1000.f));
+	}
+
+	const bool bFail = RollFailure();
+	const float Latency = NextLatency();
+	const int32 NumBatches = FMath::Max(Simulation.NumSearchBatches, 1);
+	const int32 Serial = ++SearchSerial;
+	for (int32 Batch = 1; Batch <= NumBatches; ++Batch)
+	{
+		CompleteLater([this, SearchSettings, Matches, Batch, NumBatches, Serial, bFail]()
+		{
+			if (Serial != SearchSerial) return;
+
+			if (!bFail)
+			{
+				const int32 Begin = Matches->Num() * (Batch - 1) / NumBatches;
+				const int32 End = Matches->Num() * Batch / NumBatches;
+				for (int32 Index = Begin; Index < End; ++Index)
+				{
+					SearchSettings->SearchResults.Add((*Matches)[Index]);
+				}
+			}
+			if (Batch == NumBatches)
+			{
+				SearchSettings->SearchState = bFail ? EOnlineAsyncTaskState::Failed : EOnlineAsyncTaskState::Done;
+				CurrentSearch.Reset();
+				TriggerOnFindSessionsCompleteDelegates(!bFail);
+			}
+		}, Latency * Batch / NumBatches);
+	}
+	return true;
+}
+
+bool FFakeOnlineSession::FindSessions(const FUniqueNetId& SearchingPlayerId, const TSharedRef<FOnlineSessionSearch>& SearchSettings)
+{
+	return FindSessions(0, SearchSettings);
+}
+
+bool FFakeOnlineSession::FindSessionById(const FUniqueNetId& SearchingUserId, const FUniqueNetId& SessionId, const FUniqueNetId& FriendId, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate)
+{
+	const FFakeHost* Host = Hosts.Find(SessionId.ToString());
+	FOnlineSessionSearchResult Result;
+	if (Host)
+	{
+		Result.Session = Host->Session;
+		Result.PingInMs = Host->PingInMs;
+	}
+	const bool bFound = Host != nullptr;
+	const FUniqueNetIdRef UserId = SearchingUserId.AsShared();
+	CompleteLater([CompletionDelegate, UserId, bFound, Result]()
+	{
+		CompletionDelegate.ExecuteIfBound(0, bFound, Result);
+	});
+	return true;
+}
+
+bool FFakeOnlineSession::CancelFindSessions()
+{
+	if (!CurrentSearch.IsValid()) return false;
+
+	++SearchSerial;
+	CurrentSearch->SearchState = EOnlineAsyncTaskState::Failed;
+	CurrentSearch.Reset();
+	CompleteLater([this]()
+	{
+		TriggerOnCancelFindSessionsCompleteDelegates(true);
+	}, 0.f);
+	return true;
+}
+
+bool FFakeOnlineSession::PingSearchResults(const FOnlineSessionSearchResult& SearchResult)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::JoinSession(int32 LocalUserNum, FName SessionName, const FOnlineSessionSearchResult& DesiredSession)
+{
+	if (GetNamedSession(SessionName) != nullptr)
+	{
+		UE_LOG(LogFakeOnlineSession, Warning, TEXT("Cannot join into session '%s': session already exists"), *SessionName.ToString());
+		return false;
+	}
+
+	FNamedOnlineSession* Session = AddNamedSession(SessionName, DesiredSession.Session);
+	Session->HostingPlayerNum = LocalUserNum;
+	Session->bHosting = false;
+	Session->SessionState = EOnlineSessionState::Pending;
+
+	const FString SessionId = DesiredSession.GetSessionIdStr();
+	const bool bFail = RollFailure();
+	const bool bRaced = Random.FRand() < Simulation.JoinRaceRate;
+	CompleteLater([this, SessionName, SessionId, bFail, bRaced]()
+	{
+		EOnJoinSessionCompleteResult::Type Result = EOnJoinSessionCompleteResult::Success;
+		FFakeHost* Host = Hosts.Find(SessionId);
+		if (bFail)
+		{
+			Result = EOnJoinSessionCompleteResult::UnknownError;
+		}
+		else if (Host == nullptr)
+		{
+			Result = EOnJoinSessionCompleteResult::SessionDoesNotExist;
+		}
+		else
+		{
+			// Another client got a slot while our join was in flight
+			if (bRaced && Host->Session.NumOpenPublicConnections > 0)
+			{
+				--Host->Session.NumOpenPublicConnections;
+			}
+			if (Host->Session.NumOpenPublicConnections <= 0)
+			{
+				Result = EOnJoinSessionCompleteResult::SessionIsFull;
+			}
+			else
+			{
+				--Host->Session.NumOpenPublicConnections;
+			}
+		}
+
+		if (Result != EOnJoinSessionCompleteResult::Success)
+		{
+			RemoveNamedSession(SessionName);
+		}
+		TriggerOnJoinSessionCompleteDelegates(SessionName, Result);
+	});
+	return true;
+}
+
+bool FFakeOnlineSession::JoinSession(const FUniqueNetId& LocalUserId, FName SessionName, const FOnlineSessionSearchResult& DesiredSession)
+{
+	if (!JoinSession(0, SessionName, DesiredSession)) return false;
+
+	GetNamedSession(SessionName)->LocalOwnerId = LocalUserId.AsShared();
+	return true;
+}
+
+bool FFakeOnlineSession::FindFriendSession(int32 LocalUserNum, const FUniqueNetId& Friend)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::FindFriendSession(const FUniqueNetId& LocalUserId, const FUniqueNetId& Friend)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::FindFriendSession(const FUniqueNetId& LocalUserId, const TArray<FUniqueNetIdRef>& FriendList)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::SendSessionInviteToFriend(int32 LocalUserNum, FName SessionName, const FUniqueNetId& Friend)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::SendSessionInviteToFriend(const FUniqueNetId& LocalUserId, FName SessionName, const FUniqueNetId& Friend)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::SendSessionInviteToFriends(int32 LocalUserNum, FName SessionName, const TArray<FUniqueNetIdRef>& Friends)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::SendSessionInviteToFriends(const FUniqueNetId& LocalUserId, FName SessionName, const TArray<FUniqueNetIdRef>& Friends)
+{
+	return false;
+}
+
+bool FFakeOnlineSession::GetResolvedConnectString(FName SessionName, FString& ConnectInfo, FName PortType)
+{
+	const FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr || !Session->SessionInfo.IsValid()) return false;
+
+	ConnectInfo = StaticCastSharedPtr<FFakeSessionInfo>(Session->SessionInfo)->GetConnectString();
+	return true;
+}
+
+bool FFakeOnlineSession::GetResolvedConnectString(const FOnlineSessionSearchResult& SearchResult, FName PortType, FString& ConnectInfo)
+{
+	if (!SearchResult.Session.SessionInfo.IsValid()) return false;
+
+	ConnectInfo = StaticCastSharedPtr<FFakeSessionInfo>(SearchResult.Session.SessionInfo)->GetConnectString();
+	return true;
+}
+
+FOnlineSessionSettings* FFakeOnlineSession::GetSessionSettings(FName SessionName)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	return Session ? &Session->SessionSettings : nullptr;
+}
+
+FString FFakeOnlineSession::GetVoiceChatRoomName(FName SessionName)
+{
+	return FString();
+}
+
+bool FFakeOnlineSession::RegisterPlayer(FName SessionName, const FUniqueNetId& PlayerId, bool bWasInvited)
+{
+	return RegisterPlayers(SessionName, {PlayerId.AsShared()}, bWasInvited);
+}
+
+bool FFakeOnlineSession::RegisterPlayers(FName SessionName, const TArray<FUniqueNetIdRef>& Players, bool bWasInvited)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session != nullptr)
+	{
+		for (const FUniqueNetIdRef& Player : Players)
+		{
+			if (!Session->RegisteredPlayers.ContainsByPredicate(FUniqueNetIdMatcher(*Player)))
+			{
+				Session->RegisteredPlayers.Add(Player);
+				SetNumOpenPublicConnections(*Session, Session->NumOpenPublicConnections - 1);
+			}
+		}
+	}
+	TriggerOnRegisterPlayersCompleteDelegates(SessionName, Players, Session != nullptr);
+	return Session != nullptr;
+}
+
+bool FFakeOnlineSession::UnregisterPlayer(FName SessionName, const FUniqueNetId& PlayerId)
+{
+	return UnregisterPlayers(SessionName, {PlayerId.AsShared()});
+}
+
+bool FFakeOnlineSession::UnregisterPlayers(FName SessionName, const TArray<FUniqueNetIdRef>& Players)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session != nullptr)
+	{
+		for (const FUniqueNetIdRef& Player : Players)
+		{
+			if (Session->RegisteredPlayers.RemoveAll(FUniqueNetIdMatcher(*Player)) > 0)
+			{
+				SetNumOpenPublicConnections(*Session, Session->NumOpenPublicConnections + 1);
+			}
+		}
+	}
+	TriggerOnUnregisterPlayersCompleteDelegates(SessionName, Players, Session != nullptr);
+	return Session != nullptr;
+}
+
+void FFakeOnlineSession::RegisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnRegisterLocalPlayerCompleteDelegate& Delegate)
+{
+	Delegate.ExecuteIfBound(PlayerId, EOnJoinSessionCompleteResult::Success);
+}
+
+void FFakeOnlineSession::UnregisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnUnregisterLocalPlayerCompleteDelegate& Delegate)
+{
+	Delegate.ExecuteIfBound(PlayerId, true);
+}
+
+void FFakeOnlineSession::RemovePlayerFromSession(int32 LocalUserNum, FName SessionName, const FUniqueNetId& TargetPlayerId)
+{
+	UnregisterPlayer(SessionName, TargetPlayerId);
+}
+
+int32 FFakeOnlineSession::GetNumSessions()
+{
+	return Sessions.Num();
+}
+
+void FFakeOnlineSession::DumpSessionState()
+{
+	UE_LOG(LogFakeOnlineSession, Display, TEXT("%d advertised hosts, %d named sessions"), Hosts.Num(), Sessions.Num());
+	for (const FNamedOnlineSession& Session : Sessions)
+	{
+		UE_LOG(LogFakeOnlineSession, Display, TEXT("  %s: %s, %s, %d/%d open"),
+			*Session.SessionName.ToString(), *Session.GetSessionIdStr(), EOnlineSessionState::ToString(Session.SessionState),
+			Session.NumOpenPublicConnections, Session.SessionSettings.NumPublicConnections);
+	}
+}
@@ -6,6 +6,7 @@
 #include "MultiplayerSessionsSubsystem.h"
 #include "OnlineSessionSettings.h"
 #include "Components/Button.h"
+#include "ServerBrowser.h"
 
 void UMenu::MenuSetup(int32 NumberOfPublicConnections, FString TypeOfMatch, FString LobbyPath)
 {
@@ -33,12 +34,22 @@ void UMenu::MenuSetup(int32 NumberOfPublicConnections, FString TypeOfMatch, FStr
 	}
 	if (MultiplayerSessionsSubsystem)
 	{
+		// MenuSetup 可能被调用多次，先移除旧的绑定
+		UnbindSubsystemDelegates();
 		MultiplayerSessionsSubsystem->MultiplayerOnCreateSessionCompleteDelegate.AddDynamic(this, &UMenu::OnCreateSession);
-		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionsCompleteDelegate.AddUObject(this, &UMenu::OnFindSessions);
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionSummariesCompleteDelegate.AddUObject(this, &UMenu::OnFindSessions);
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionSummariesBatchDelegate.AddUObject(this, &UMenu::OnFindSessionsBatch);
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionsCancelledDelegate.AddUObject(this, &UMenu::OnFindSessionsCancelled);
+		MultiplayerSessionsSubsystem->MultiplayerOnSessionCandidatesRankedDelegate.AddUObject(this, &UMenu::OnSessionCandidatesRanked);
 		MultiplayerSessionsSubsystem->MultiplayerOnJoinSessionCompleteDelegate.AddUObject(this, &UMenu::OnJoinSession);
 		MultiplayerSessionsSubsystem->MultiplayerOnDestroySessionCompleteDelegate.AddDynamic(this, &UMenu::OnDestroySession);
 		MultiplayerSessionsSubsystem->MultiplayerOnStartSessionCompleteDelegate.AddDynamic(this, &UMenu::OnStartSession);
 	}
+	if (ServerBrowser)
+	{
+		ServerBrowser->OnRefreshComplete.RemoveAll(this);
+		ServerBrowser->OnRefreshComplete.AddUObject(this, &UMenu::OnServerBrowserRefreshed);
+	}
 }
 
 bool UMenu::Initialize()
@@ -66,12 +77,8 @@ void UMenu::NativeDestruct()
 
 void UMenu::OnCreateSession(bool bWasSuccessful)
 {
-	if (bWasSuccessful)
-	{
-		if (UWorld* World = GetWorld()) {
-			World->ServerTravel(PathToLobby);
-		}
-	} else
+	// 成功时由 HostSession 在大厅地图加载完成后 ServerTravel
+	if (!bWasSuccessful)
 	{
 		if (GEngine) {
 			GEngine->AddOnScreenDebugMessage(
@@ -86,24 +93,66 @@ void UMenu::OnCreateSession(bool bWasSuccessful)
 
 }
 
-void UMenu::OnFindSessions(const TArray<FOnlineSessionSearchResult>& SessionResults, bool bWasSuccessful)
+void UMenu::OnFindSessions(TArrayView<const FSessionSummary> Summaries, bool bWasSuccessful)
 {
-	if (MultiplayerSessionsSubsystem == nullptr) return;
-	
-	for (auto Result : SessionResults) {
-		// FString Id = Result.GetSessionIdStr();
-		// FString User = Result.Session.OwningUserName;
-		FString SettingsValue;
-		Result.Session.SessionSettings.Get(FName("MatchType"), SettingsValue);
-
-		// 如果 MatchType 是前面 CreateGameSeesion 中设置的 "FreeForAll"，则打印并添加委托，同时加入 Session
-		if (SettingsValue == MatchType) {
-			MultiplayerSessionsSubsystem->JoinSession(Result);
+	// 只处理自己发起、且没有被提前停止的搜索；其他调用者（服务器列表、蓝图节点）的搜索也会广播到这里
+	if (MultiplayerSessionsSubsystem == nullptr || !bFindingSessions) return;
+	bFindingSessions = false;
+	FindOperationId = INDEX_NONE;
+
+	// Nothing matched, or the search failed before finding anything; let the player try again
+	if (Summaries.IsEmpty())
+	{
+		JoinButton->SetIsEnabled(true);
+		return;
+	}
+	// The search ran to the end without a good-enough early candidate, rank everything that matched
+	bRankingForJoin = true;
+	MultiplayerSessionsSubsystem->RankSessionCandidates();
+}
+
+void UMenu::OnFindSessionsBatch(TArrayView<const FSessionSummary> NewSummaries)
+{
+	if (MultiplayerSessionsSubsystem == nullptr || ServerBrowser || !bFindingSessions) return;
+
+	// MatchType 已由查询过滤；出现延迟足够低的 Session 就提前停止搜索，对已有结果排序
+	for (const FSessionSummary& Summary : NewSummaries)
+	{
+		if (Summary.PingInMs <= EarlyJoinPingMs)
+		{
+			bFindingSessions = false;
+			FindOperationId = INDEX_NONE;
+			MultiplayerSessionsSubsystem->StopFindSessions();
+			bRankingForJoin = true;
+			MultiplayerSessionsSubsystem->RankSessionCandidates();
 			return;
 		}
-
 	}
-	if (!bWasSuccessful || SessionResults.Num() == 0)
+}
+
+void UMenu::OnFindSessionsCancelled(int32 OperationId)
+{
+	// 自己的搜索被其他调用者停止或取消时不会再有完成广播
+	if (!bFindingSessions || OperationId != FindOperationId) return;
+	bFindingSessions = false;
+	FindOperationId = INDEX_NONE;
+	JoinButton->SetIsEnabled(true);
+}
+
+void UMenu::OnServerBrowserRefreshed(bool bWasSuccessful)
+{
+	// 玩家在列表里选择 Session，搜索结束后就可以再次刷新
+	JoinButton->SetIsEnabled(true);
+}
+
+void UMenu::OnSessionCandidatesRanked(TArrayView<const FRankedSessionCandidate> RankedCandidates)
+{
+	// 其他调用者（FindAndJoinSession、服务器列表）的排序也会广播到这里，它们自己负责加入
+	if (!bRankingForJoin) return;
+	bRankingForJoin = false;
+
+	// 子系统按排序依次尝试，失败时换下一个候选，全部失败后退避重试
+	if (MultiplayerSessionsSubsystem == nullptr || !MultiplayerSessionsSubsystem->JoinBestCandidate())
 	{
 		JoinButton->SetIsEnabled(true);
 	}
@@ -112,22 +161,9 @@ void UMenu::OnFindSessions(const TArray<FOnlineSessionSearchResult>& SessionResu
 void UMenu::OnJoinSession(EOnJoinSessionCompleteResult::Type Result)
 {
 	if (MultiplayerSessionsSubsystem == nullptr) return;
-	if (EOnJoinSessionCompleteResult::Type::Success == Result)
-	{
-		FString Address;
-		MultiplayerSessionsSubsystem->GetResolvedConnectString(NAME_GameSession, Address);
-
-		if (APlayerController* PlayerController = GetGameInstance()->GetFirstLocalPlayerController())
-		{
-			GEngine->AddOnScreenDebugMessage(
-				-1,
-				15.f,
-				FColor::Green,
-				FString::Printf(TEXT("ClientTravel"))
-			);
-			PlayerController->ClientTravel(Address, TRAVEL_Absolute);
-		}
-	} else
+	// 成功时子系统已经用排序时解析好的地址 ClientTravel
+	// 失败时子系统已经试过所有候选（或者玩家要在列表里另选一个）
+	if (EOnJoinSessionCompleteResult::Type::Success != Result)
 	{
 		JoinButton->SetIsEnabled(true);
 	}
@@ -146,21 +182,39 @@ void UMenu::HostButtonClicked()
 	HostButton->SetIsEnabled(false);
 	if (MultiplayerSessionsSubsystem)
 	{
-		MultiplayerSessionsSubsystem->CreateSession(NumPublicConnections, MatchType);
+		MultiplayerSessionsSubsystem->HostSession(NumPublicConnections, MatchType, PathToLobby);
 	}
 }
 
 void UMenu::JoinButtonClicked()
 {
 	JoinButton->SetIsEnabled(false);
-	if (MultiplayerSessionsSubsystem)
+	const FMultiplayerSessionQuery Query = FMultiplayerSessionQuery()
+		.WithMatchType(MatchType)
+		.WithMinOpenSlots(1)
+		.WithMaxResults(10000)
+		.Streamed();
+	if (ServerBrowser)
+	{
+		// 列表由浏览器自己填充，玩家选择要加入的 Session
+		ServerBrowser->Refresh(Query);
+	}
+	else if (MultiplayerSessionsSubsystem)
 	{
-		MultiplayerSessionsSubsystem->FindSessions(10000);
+		bFindingSessions = true;
+		const int32 OperationId = MultiplayerSessionsSubsystem->FindSessions(Query);
+		// 命中缓存时搜索已经在调用里完成
+		FindOperationId = bFindingSessions ? OperationId : INDEX_NONE;
 	}
 }
 
 void UMenu::MenuTeardown()
 {
+	UnbindSubsystemDelegates();
+	if (ServerBrowser)
+	{
+		ServerBrowser->OnRefreshComplete.RemoveAll(this);
+	}
 	RemoveFromParent();
 	if (UWorld* World = GetWorld())
 	{
@@ -172,3 +226,17 @@ void UMenu::MenuTeardown()
 		}
 	}
 }
+
+void UMenu::UnbindSubsystemDelegates()
+{
+	if (MultiplayerSessionsSubsystem == nullptr) return;
+
+	MultiplayerSessionsSubsystem->MultiplayerOnCreateSessionCompleteDelegate.RemoveAll(this);
+	MultiplayerSessionsSubsystem->MultiplayerOnFindSessionSummariesCompleteDelegate.RemoveAll(this);
+	MultiplayerSessionsSubsystem->MultiplayerOnFindSessionSummariesBatchDelegate.RemoveAll(this);
+	MultiplayerSessionsSubsystem->MultiplayerOnFindSessionsCancelledDelegate.RemoveAll(this);
+	MultiplayerSessionsSubsystem->MultiplayerOnSessionCandidatesRankedDelegate.RemoveAll(this);
+	MultiplayerSessionsSubsystem->MultiplayerOnJoinSessionCompleteDelegate.RemoveAll(this);
+	MultiplayerSessionsSubsystem->MultiplayerOnDestroySessionCompleteDelegate.RemoveAll(this);
+	MultiplayerSessionsSubsystem->MultiplayerOnStartSessionCompleteDelegate.RemoveAll(this);
+}
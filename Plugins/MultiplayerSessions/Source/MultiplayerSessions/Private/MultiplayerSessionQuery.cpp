@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MultiplayerSessionQuery.h"
+
+#include "OnlineSessionSettings.h"
+#include "Online/OnlineSessionNames.h"
+
+const FName FMultiplayerSessionQuery::MatchTypeKey(TEXT("MatchType"));
+const FName FMultiplayerSessionQuery::BuildIdKey(TEXT("BUILDID"));
+const FName FMultiplayerSessionQuery::HostQualityKey(TEXT("HOSTQUALITY"));
+const FName FMultiplayerSessionQuery::MatchPhaseKey(TEXT("MATCHPHASE"));
+const FName FMultiplayerSessionQuery::JoinableKey(TEXT("JOINABLE"));
+
+FSessionFilterKey FSessionFilterKey::Extract(const FOnlineSessionSearchResult& Result)
+{
+	FSessionFilterKey Key;
+	FString MatchType;
+	if (Result.Session.SessionSettings.Get(FMultiplayerSessionQuery::MatchTypeKey, MatchType))
+	{
+		Key.MatchType = FName(*MatchType);
+	}
+	Key.NumOpenPublicConnections = Result.Session.NumOpenPublicConnections;
+	Key.NumPublicConnections = Result.Session.SessionSettings.NumPublicConnections;
+	Key.BuildId = Result.Session.SessionSettings.BuildUniqueId;
+	Key.PingInMs = Result.PingInMs;
+	Result.Session.SessionSettings.Get(FMultiplayerSessionQuery::HostQualityKey, Key.HostQuality);
+	// 与后端的 JOINABLE == 1 过滤一致：没有广播这个键的主机不算可加入
+	int32 Joinable = 0;
+	Result.Session.SessionSettings.Get(FMultiplayerSessionQuery::JoinableKey, Joinable);
+	Key.bJoinable = Joinable != 0;
+	return Key;
+}
+
+FSessionSummary FSessionSummary::Make(const FSessionFilterKey& Key, int32 ResultIndex)
+{
+	FSessionSummary Summary;
+	Summary.MatchType = Key.MatchType;
+	Summary.ResultIndex = ResultIndex;
+	Summary.BuildId = Key.BuildId;
+	Summary.PingInMs = static_cast<uint16>(FMath::Clamp(Key.PingInMs, 0, MAX_uint16));
+	Summary.NumOpenPublicConnections = static_cast<uint16>(FMath::Clamp(Key.NumOpenPublicConnections, 0, MAX_uint16));
+	Summary.NumPublicConnections = static_cast<uint16>(FMath::Clamp(Key.NumPublicConnections, 0, MAX_uint16));
+	Summary.HostQuality = static_cast<uint8>(FMath::Clamp(Key.HostQuality, 0, 100));
+	return Summary;
+}
+
+void FMultiplayerSessionQuery::ApplyTo(FOnlineSessionSearch& Search) const
+{
+	Search.MaxSearchResults = MaxSearchResults;
+	Search.QuerySettings.Set(SEARCH_LOBBIES, false, EOnlineComparisonOp::Equals); // 只查询 presence 值为 false 的
+	if (!MatchType.IsNone())
+	{
+		Search.QuerySettings.Set(MatchTypeKey, MatchType.ToString(), EOnlineComparisonOp::Equals);
+	}
+	if (MinOpenSlots > 0)
+	{
+		Search.QuerySettings.Set(SEARCH_MINSLOTSAVAILABLE, MinOpenSlots, EOnlineComparisonOp::GreaterThanEquals);
+	}
+	if (BuildId != 0)
+	{
+		Search.QuerySettings.Set(BuildIdKey, BuildId, EOnlineComparisonOp::Equals);
+	}
+	if (bOnlyJoinable)
+	{
+		Search.QuerySettings.Set(JoinableKey, 1, EOnlineComparisonOp::Equals);
+	}
+	for (const TPair<FName, FString>& CustomKey : CustomKeys)
+	{
+		Search.QuerySettings.Set(CustomKey.Key, CustomKey.Value, EOnlineComparisonOp::Equals);
+	}
+}
+
+bool FMultiplayerSessionQuery::Matches(const FSessionFilterKey& Key) const
+{
+	return (MatchType.IsNone() || Key.MatchType == MatchType)
+		&& Key.NumOpenPublicConnections >= MinOpenSlots
+		&& (BuildId == 0 || Key.BuildId == BuildId)
+		&& (!bOnlyJoinable || Key.bJoinable);
+}
+
+FString FMultiplayerSessionQuery::ToCacheKey() const
+{
+	FString CacheKey = FString::Printf(TEXT("%s|%d|%d|%d|%d"), *MatchType.ToString(), MinOpenSlots, BuildId, MaxSearchResults, bOnlyJoinable ? 1 : 0);
+	for (const TPair<FName, FString>& CustomKey : CustomKeys)
+	{
+		CacheKey += FString::Printf(TEXT("|%s=%s"), *CustomKey.Key.ToString(), *CustomKey.Value);
+	}
+	return CacheKey;
+}
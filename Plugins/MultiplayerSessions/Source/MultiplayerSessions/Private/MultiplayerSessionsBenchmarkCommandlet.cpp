@@ -0,0 +1,237 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MultiplayerSessionsBenchmarkCommandlet.h"
+
+#include "MultiplayerSessionsSubsystem.h"
+#include "MultiplayerSessionQuery.h"
+#include "SessionLatencyStats.h"
+#include "FakeOnlineSession.h"
+#include "OnlineSessionSettings.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "Containers/Ticker.h"
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMultiplayerSessionsBenchmark, Log, All);
+
+namespace MultiplayerSessionsBenchmark
+{
+	const FString MatchType(TEXT("FreeForAll"));
+	constexpr double OperationTimeout = 10.0;
+
+	/**
+	 * Tick the core ticker (which drives the subsystem and the fake backend) until IsDone or the timeout runs out.
+	 * The game instance's timers are left alone, so no background cache refresh runs between measurements.
+	 * Returns the seconds spent inside the ticks, i.e. game thread time without the sleeps in between.
+	 **/
+	double WaitFor(TFunctionRef<bool()> IsDone, double Timeout)
+	{
+		const double Deadline = FPlatformTime::Seconds() + Timeout;
+		double LastTime = FPlatformTime::Seconds();
+		double BusySeconds = 0.0;
+		while (!IsDone() && FPlatformTime::Seconds() < Deadline)
+		{
+			const double Now = FPlatformTime::Seconds();
+			FTSTicker::GetCoreTicker().Tick(static_cast<float>(Now - LastTime));
+			LastTime = Now;
+			BusySeconds += FPlatformTime::Seconds() - Now;
+			FPlatformProcess::Sleep(0.001f);
+		}
+		return BusySeconds;
+	}
+
+	// Run one subsystem call and wait until its operation has left the queue; returns the wall time it took
+	double RunOperation(UMultiplayerSessionsSubsystem& Sessions, TFunctionRef<int32()> Issue)
+	{
+		const double Start = FPlatformTime::Seconds();
+		const int32 OperationId = Issue();
+		WaitFor([&Sessions, OperationId] { return !Sessions.IsOperationQueued(OperationId); }, OperationTimeout);
+		return FPlatformTime::Seconds() - Start;
+	}
+
+	// Bytes held by the subsystem for its last search: the raw results, their filter keys and the summaries
+	SIZE_T GetSearchAllocatedSize(const UMultiplayerSessionsSubsystem& Sessions)
+	{
+		const TArray<FSessionFilterKey>& Keys = Sessions.GetSessionFilterKeys();
+		SIZE_T Size = Keys.GetAllocatedSize() + Keys.Num() * sizeof(FOnlineSessionSearchResult);
+		for (int32 ResultIndex = 0; ResultIndex < Keys.Num(); ++ResultIndex)
+		{
+			if (const FOnlineSessionSearchResult* Result = Sessions.GetSearchResult(ResultIndex))
+			{
+				Size += Result->Session.SessionSettings.Settings.GetAllocatedSize();
+			}
+		}
+		return Size + Sessions.GetSessionSummaries().Num() * sizeof(FSessionSummary);
+	}
+
+	TSharedRef<FJsonObject> HistogramToJson(const FSessionLatencyHistogram& Histogram, double TotalSeconds)
+	{
+		double P50, P95, P99;
+		Histogram.GetPercentilesMs(P50, P95, P99);
+
+		TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+		Json->SetNumberField(TEXT("Count"), Histogram.GetNumSamples());
+		Json->SetNumberField(TEXT("Failed"), Histogram.GetNumFailed());
+		Json->SetNumberField(TEXT("Cancelled"), Histogram.GetNumCancelled());
+		Json->SetNumberField(TEXT("P50Ms"), P50);
+		Json->SetNumberField(TEXT("P95Ms"), P95);
+		Json->SetNumberField(TEXT("P99Ms"), P99);
+		Json->SetNumberField(TEXT("OpsPerSecond"), TotalSeconds > 0.0 ? Histogram.GetNumSamples() / TotalSeconds : 0.0);
+		return Json;
+	}
+}
+
+UMultiplayerSessionsBenchmarkCommandlet::UMultiplayerSessionsBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMultiplayerSessionsBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 Iterations = 20;
+	FParse::Value(*Params, TEXT("Iterations="), Iterations);
+	Iterations = FMath::Max(Iterations, 1);
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks/MultiplayerSessions.json");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	// 与游戏里一样，由 GameInstance 创建并持有会话子系统
+	UGameInstance* GameInstance = NewObject<UGameInstance>(GEngine);
+	GameInstance->InitializeStandalone();
+	UWorld* World = GameInstance->GetWorld();
+	UMultiplayerSessionsSubsystem* Sessions = GameInstance->GetSubsystem<UMultiplayerSessionsSubsystem>();
+	if (Sessions == nullptr)
+	{
+		UE_LOG(LogMultiplayerSessionsBenchmark, Error, TEXT("No session subsystem on the game instance"));
+		GameInstance->Shutdown();
+		return 1;
+	}
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetStringField(TEXT("Timestamp"), FDateTime::UtcNow().ToIso8601());
+	Root->SetNumberField(TEXT("Iterations"), Iterations);
+	Root->SetObjectField(TEXT("Operations"), RunOperationBenchmarks(*Sessions, Iterations));
+	Root->SetArrayField(TEXT("ResultHandling"), RunResultHandlingBenchmarks(*Sessions, Iterations));
+
+	GameInstance->Shutdown();
+	if (World)
+	{
+		World->DestroyWorld(false);
+	}
+
+	FString Output;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Root, Writer);
+	if (!FFileHelper::SaveStringToFile(Output, *OutputPath))
+	{
+		UE_LOG(LogMultiplayerSessionsBenchmark, Error, TEXT("Could not write %s"), *OutputPath);
+		return 1;
+	}
+	UE_LOG(LogMultiplayerSessionsBenchmark, Display, TEXT("Wrote %s"), *OutputPath);
+	return 0;
+}
+
+TSharedRef<FJsonObject> UMultiplayerSessionsBenchmarkCommandlet::RunOperationBenchmarks(UMultiplayerSessionsSubsystem& Sessions, int32 Iterations)
+{
+	using namespace MultiplayerSessionsBenchmark;
+
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	// Latency and failures as configured in [MultiplayerSessions.FakeOnlineSession]
+	if (!Sessions.UseFakeOnlineSession(FFakeSessionSimulation::LoadFromConfig()))
+	{
+		Json->SetStringField(TEXT("Skipped"), TEXT("Could not switch to the fake session backend"));
+		return Json;
+	}
+	Sessions.ResetLatencyStats();
+
+	// The subsystem records every operation's latency itself; we only add up the wall time for the throughput
+	double TotalSeconds[static_cast<int32>(ESessionLatencyStat::Num)] = {};
+	const FMultiplayerSessionQuery Query = FMultiplayerSessionQuery().WithMatchType(MatchType).WithMaxResults(100);
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		// Every find goes to the backend, a cache hit would measure nothing
+		Sessions.InvalidateSearchCache();
+		TotalSeconds[static_cast<int32>(ESessionLatencyStat::Find)] += RunOperation(Sessions, [&] { return Sessions.FindSessions(Query); });
+
+		// Spread the joins over the matches so no host fills up
+		const TArrayView<const FSessionSummary> Summaries = Sessions.GetSessionSummaries();
+		const FOnlineSessionSearchResult* JoinTarget = Summaries.IsEmpty() ? nullptr : Sessions.GetSearchResult(Summaries[Iteration % Summaries.Num()].ResultIndex);
+		if (JoinTarget)
+		{
+			const FOnlineSessionSearchResult Target = *JoinTarget;
+			TotalSeconds[static_cast<int32>(ESessionLatencyStat::Join)] += RunOperation(Sessions, [&] { return Sessions.JoinSession(Target); });
+			TotalSeconds[static_cast<int32>(ESessionLatencyStat::Destroy)] += RunOperation(Sessions, [&] { return Sessions.DestroySession(); });
+		}
+
+		TotalSeconds[static_cast<int32>(ESessionLatencyStat::Create)] += RunOperation(Sessions, [&] { return Sessions.CreateSession(4, MatchType); });
+		TotalSeconds[static_cast<int32>(ESessionLatencyStat::Destroy)] += RunOperation(Sessions, [&] { return Sessions.DestroySession(); });
+	}
+
+	const FSessionLatencyStats& Stats = Sessions.GetLatencyStats();
+	for (const ESessionLatencyStat Stat : {ESessionLatencyStat::Create, ESessionLatencyStat::Find, ESessionLatencyStat::Join, ESessionLatencyStat::Destroy})
+	{
+		Json->SetObjectField(LexToString(Stat), HistogramToJson(Stats.Get(Stat), TotalSeconds[static_cast<int32>(Stat)]));
+	}
+	Stats.Dump(*GLog);
+	return Json;
+}
+
+TArray<TSharedPtr<FJsonValue>> UMultiplayerSessionsBenchmarkCommandlet::RunResultHandlingBenchmarks(UMultiplayerSessionsSubsystem& Sessions, int32 Iterations)
+{
+	using namespace MultiplayerSessionsBenchmark;
+
+	TArray<TSharedPtr<FJsonValue>> Rows;
+	for (const int32 NumResults : {10, 100, 1000, 10000})
+	{
+		// Every result arrives at once and without latency, so what is left is the subsystem's own handling
+		FFakeSessionSimulation Simulation;
+		Simulation.NumHosts = NumResults;
+		Simulation.Latency = 0.f;
+		Simulation.LatencyJitter = 0.f;
+		Simulation.NumSearchBatches = 1;
+		Simulation.RandomSeed = NumResults;
+		if (!Sessions.UseFakeOnlineSession(Simulation)) break;
+
+		const FMultiplayerSessionQuery Query = FMultiplayerSessionQuery().WithMatchType(MatchType).WithMinOpenSlots(1).WithBuildId(1).WithMaxResults(NumResults);
+		double FindSeconds = 0.0, RankSeconds = 0.0;
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			Sessions.InvalidateSearchCache();
+			// Includes the fake backend evaluating the query, which happens inside the call
+			double Start = FPlatformTime::Seconds();
+			const int32 OperationId = Sessions.FindSessions(Query);
+			FindSeconds += FPlatformTime::Seconds() - Start;
+			FindSeconds += WaitFor([&Sessions, OperationId] { return !Sessions.IsOperationQueued(OperationId); }, OperationTimeout);
+
+			bool bRanked = false;
+			const FDelegateHandle RankedHandle = Sessions.MultiplayerOnSessionCandidatesRankedDelegate.AddLambda(
+				[&bRanked](TArrayView<const FRankedSessionCandidate>) { bRanked = true; });
+			Start = FPlatformTime::Seconds();
+			Sessions.RankSessionCandidates();
+			RankSeconds += FPlatformTime::Seconds() - Start;
+			RankSeconds += WaitFor([&bRanked] { return bRanked; }, OperationTimeout);
+			Sessions.MultiplayerOnSessionCandidatesRankedDelegate.Remove(RankedHandle);
+		}
+
+		const SIZE_T SearchBytes = GetSearchAllocatedSize(Sessions);
+		TSharedRef<FJsonObject> Row = MakeShared<FJsonObject>();
+		Row->SetNumberField(TEXT("NumResults"), Sessions.GetSessionFilterKeys().Num());
+		Row->SetNumberField(TEXT("NumMatching"), Sessions.GetSessionSummaries().Num());
+		Row->SetNumberField(TEXT("FindUs"), FindSeconds * 1e6 / Iterations);
+		Row->SetNumberField(TEXT("RankUs"), RankSeconds * 1e6 / Iterations);
+		Row->SetNumberField(TEXT("BytesPerSearch"), static_cast<double>(SearchBytes));
+		Rows.Add(MakeShared<FJsonValueObject>(Row));
+
+		UE_LOG(LogMultiplayerSessionsBenchmark, Display, TEXT("%6d results: find %.1fus, rank %.1fus, %llu bytes"),
+			Sessions.GetSessionFilterKeys().Num(), FindSeconds * 1e6 / Iterations, RankSeconds * 1e6 / Iterations, static_cast<uint64>(SearchBytes));
+	}
+	return Rows;
+}
@@ -0,0 +1,251 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MultiplayerSessionsSoakAgent.h"
+
+#include "MultiplayerSessionsSubsystem.h"
+#include "MultiplayerSessionQuery.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/UObjectGlobals.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMultiplayerSessionsSoak, Log, All);
+
+const TCHAR* UMultiplayerSessionsSoakAgent::HostReadyFileName = TEXT("HostReady");
+const TCHAR* UMultiplayerSessionsSoakAgent::HostReportFileName = TEXT("Host.json");
+const TCHAR* UMultiplayerSessionsSoakAgent::StopFileName = TEXT("Stop");
+
+FString UMultiplayerSessionsSoakAgent::GetClientReportFileName(int32 InClientIndex)
+{
+	return FString::Printf(TEXT("Client_%d.json"), InClientIndex);
+}
+
+namespace MultiplayerSessionsSoak
+{
+	bool SaveJson(const TSharedRef<FJsonObject>& Json, const FString& Path)
+	{
+		FString Output;
+		const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+		FJsonSerializer::Serialize(Json, Writer);
+		// 先写临时文件再改名，进程在写的途中被结束时命令行工具也读不到半个文件
+		const FString TempPath = Path + TEXT(".tmp");
+		return FFileHelper::SaveStringToFile(Output, *TempPath) && IFileManager::Get().Move(*Path, *TempPath, true);
+	}
+}
+
+bool UMultiplayerSessionsSoakAgent::ShouldCreateSubsystem(UObject* Outer) const
+{
+	FString Role;
+	return Super::ShouldCreateSubsystem(Outer) && FParse::Value(FCommandLine::Get(), TEXT("SoakRole="), Role);
+}
+
+void UMultiplayerSessionsSoakAgent::Initialize(FSubsystemCollectionBase& Collection)
+{
+	// 按 UMenu 的方式调用会话子系统，所以要先保证它已经初始化
+	Collection.InitializeDependency<UMultiplayerSessionsSubsystem>();
+	Super::Initialize(Collection);
+
+	FString Role;
+	FParse::Value(FCommandLine::Get(), TEXT("SoakRole="), Role);
+	bHost = Role.Equals(TEXT("Host"), ESearchCase::IgnoreCase);
+	FParse::Value(FCommandLine::Get(), TEXT("SoakDir="), SoakDir);
+	FParse::Value(FCommandLine::Get(), TEXT("SoakClientIndex="), ClientIndex);
+	FParse::Value(FCommandLine::Get(), TEXT("SoakPlayers="), NumPublicConnections);
+	FParse::Value(FCommandLine::Get(), TEXT("SoakMatchType="), MatchType);
+	FParse::Value(FCommandLine::Get(), TEXT("SoakLobby="), LobbyPath);
+	StartTime = FPlatformTime::Seconds();
+
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &ThisClass::OnPostLoadMap);
+	if (bHost)
+	{
+		PostLoginHandle = FGameModeEvents::GameModePostLoginEvent.AddUObject(this, &ThisClass::OnPostLogin);
+	}
+	LastSampleTime = StartTime;
+	TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::Tick));
+	UE_LOG(LogMultiplayerSessionsSoak, Log, TEXT("Soak %s %d, writing to %s"), bHost ? TEXT("host") : TEXT("client"), ClientIndex, *SoakDir);
+}
+
+void UMultiplayerSessionsSoakAgent::Deinitialize()
+{
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+	FGameModeEvents::GameModePostLoginEvent.Remove(PostLoginHandle);
+	FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	// 没等到停止文件就退出时也留下已有的采样
+	if (bHost)
+	{
+		WriteHostReport();
+	}
+	if (UMultiplayerSessionsSubsystem* Sessions = GetGameInstance()->GetSubsystem<UMultiplayerSessionsSubsystem>())
+	{
+		Sessions->MultiplayerOnJoinSessionCompleteDelegate.RemoveAll(this);
+	}
+	Super::Deinitialize();
+}
+
+void UMultiplayerSessionsSoakAgent::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	if (LoadedWorld == nullptr || LoadedWorld->GetGameInstance() != GetGameInstance()) return;
+
+	// 第一张地图是启动地图，从这里开始走菜单的流程
+	if (!bStarted)
+	{
+		bStarted = true;
+		if (bHost)
+		{
+			StartHosting();
+		}
+		else
+		{
+			StartJoining();
+		}
+		return;
+	}
+
+	if (bHost && LoadedWorld->GetNetMode() == NM_ListenServer)
+	{
+		FFileHelper::SaveStringToFile(FString::Printf(TEXT("%.3f"), FPlatformTime::Seconds() - StartTime), *(SoakDir / HostReadyFileName));
+		UE_LOG(LogMultiplayerSessionsSoak, Log, TEXT("Lobby up after %.2fs"), FPlatformTime::Seconds() - StartTime);
+	}
+	else if (!bHost && LoadedWorld->GetNetMode() == NM_Client)
+	{
+		WriteClientReport(true, TEXT("Success"));
+	}
+}
+
+void UMultiplayerSessionsSoakAgent::StartHosting()
+{
+	// 与 UMenu::HostButtonClicked 相同
+	if (UMultiplayerSessionsSubsystem* Sessions = GetGameInstance()->GetSubsystem<UMultiplayerSessionsSubsystem>())
+	{
+		Sessions->HostSession(NumPublicConnections, MatchType, FString::Printf(TEXT("%s?listen"), *LobbyPath));
+	}
+}
+
+void UMultiplayerSessionsSoakAgent::StartJoining()
+{
+	UMultiplayerSessionsSubsystem* Sessions = GetGameInstance()->GetSubsystem<UMultiplayerSessionsSubsystem>();
+	if (Sessions == nullptr)
+	{
+		WriteClientReport(false, TEXT("NoSubsystem"));
+		return;
+	}
+
+	// 与 UMenu 的加入按钮相同：搜索、排序，再由重试引擎依次加入；成功后子系统直接 ClientTravel
+	JoinStartTime = FPlatformTime::Seconds();
+	Sessions->MultiplayerOnJoinSessionCompleteDelegate.AddUObject(this, &ThisClass::OnJoinSessionComplete);
+	Sessions->FindAndJoinSession(FMultiplayerSessionQuery().WithMatchType(MatchType));
+}
+
+void UMultiplayerSessionsSoakAgent::OnJoinSessionComplete(EOnJoinSessionCompleteResult::Type Result)
+{
+	// 成功要等到大厅加载完才算，在 OnPostLoadMap 里记录
+	if (Result != EOnJoinSessionCompleteResult::Success)
+	{
+		WriteClientReport(false, LexToString(Result));
+	}
+}
+
+void UMultiplayerSessionsSoakAgent::OnPostLogin(AGameModeBase* GameMode, APlayerController* NewPlayer)
+{
+	if (GameMode && GameMode->GetGameInstance() == GetGameInstance())
+	{
+		LoginTimes.Add(FPlatformTime::Seconds() - StartTime);
+	}
+}
+
+bool UMultiplayerSessionsSoakAgent::Tick(float DeltaTime)
+{
+	FrameSecondsSum += DeltaTime;
+	FrameSecondsMax = FMath::Max<double>(FrameSecondsMax, DeltaTime);
+	++NumFrames;
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now - LastSampleTime < 1.0) return true;
+	LastSampleTime = Now;
+
+	if (bHost)
+	{
+		SampleHost(Now);
+	}
+	if (!IFileManager::Get().FileExists(*(SoakDir / StopFileName))) return true;
+
+	UE_LOG(LogMultiplayerSessionsSoak, Log, TEXT("Stop requested after %.2fs"), Now - StartTime);
+	if (bHost)
+	{
+		WriteHostReport();
+	}
+	TickerHandle.Reset();
+	FPlatformMisc::RequestExit(false);
+	return false;
+}
+
+void UMultiplayerSessionsSoakAgent::SampleHost(double Now)
+{
+	FHostSample& Sample = HostSamples.AddDefaulted_GetRef();
+	Sample.Seconds = Now - StartTime;
+	Sample.AverageFrameMs = NumFrames > 0 ? FrameSecondsSum / NumFrames * 1000.0 : 0.0;
+	Sample.MaxFrameMs = FrameSecondsMax * 1000.0;
+	const UWorld* World = GetGameInstance()->GetWorld();
+	const AGameModeBase* GameMode = World ? World->GetAuthGameMode() : nullptr;
+	Sample.NumPlayers = GameMode ? GameMode->GetNumPlayers() : 0;
+	Sample.NumLogins = LoginTimes.Num();
+	Sample.UsedPhysicalMB = FPlatformMemory::GetStats().UsedPhysical / (1024.0 * 1024.0);
+	FrameSecondsSum = 0.0;
+	FrameSecondsMax = 0.0;
+	NumFrames = 0;
+}
+
+void UMultiplayerSessionsSoakAgent::WriteHostReport()
+{
+	if (bHostReported) return;
+	bHostReported = true;
+
+	TArray<TSharedPtr<FJsonValue>> Samples;
+	Samples.Reserve(HostSamples.Num());
+	for (const FHostSample& Sample : HostSamples)
+	{
+		TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+		Json->SetNumberField(TEXT("Seconds"), Sample.Seconds);
+		Json->SetNumberField(TEXT("AverageFrameMs"), Sample.AverageFrameMs);
+		Json->SetNumberField(TEXT("MaxFrameMs"), Sample.MaxFrameMs);
+		Json->SetNumberField(TEXT("Players"), Sample.NumPlayers);
+		Json->SetNumberField(TEXT("Logins"), Sample.NumLogins);
+		Json->SetNumberField(TEXT("UsedPhysicalMB"), Sample.UsedPhysicalMB);
+		Samples.Add(MakeShared<FJsonValueObject>(Json));
+	}
+	TArray<TSharedPtr<FJsonValue>> Logins;
+	Logins.Reserve(LoginTimes.Num());
+	for (const double LoginTime : LoginTimes)
+	{
+		Logins.Add(MakeShared<FJsonValueNumber>(LoginTime));
+	}
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetArrayField(TEXT("Samples"), Samples);
+	Root->SetArrayField(TEXT("LoginSeconds"), Logins);
+	MultiplayerSessionsSoak::SaveJson(Root, SoakDir / HostReportFileName);
+	UE_LOG(LogMultiplayerSessionsSoak, Log, TEXT("Host: %d samples, %d logins"), HostSamples.Num(), LoginTimes.Num());
+}
+
+void UMultiplayerSessionsSoakAgent::WriteClientReport(bool bJoined, const FString& Result)
+{
+	if (bClientReported) return;
+	bClientReported = true;
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetNumberField(TEXT("ClientIndex"), ClientIndex);
+	Root->SetBoolField(TEXT("Joined"), bJoined);
+	Root->SetStringField(TEXT("Result"), Result);
+	// 从开始搜索到大厅加载完成
+	Root->SetNumberField(TEXT("JoinMs"), JoinStartTime > 0.0 ? (FPlatformTime::Seconds() - JoinStartTime) * 1000.0 : 0.0);
+	Root->SetNumberField(TEXT("UsedPhysicalMB"), FPlatformMemory::GetStats().UsedPhysical / (1024.0 * 1024.0));
+	MultiplayerSessionsSoak::SaveJson(Root, SoakDir / GetClientReportFileName(ClientIndex));
+	UE_LOG(LogMultiplayerSessionsSoak, Log, TEXT("Client %d: %s"), ClientIndex, *Result);
+}
@@ -0,0 +1,272 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MultiplayerSessionsSoakCommandlet.h"
+
+#include "MultiplayerSessionsSoakAgent.h"
+#include "SessionLatencyStats.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMultiplayerSessionsSoak, Log, All);
+
+namespace MultiplayerSessionsSoak
+{
+	constexpr double HostReadyTimeout = 60.0;
+	// How long the processes get to write their reports and exit after the stop file appears
+	constexpr double StopTimeout = 30.0;
+
+	FProcHandle Launch(const FString& SoakDir, const FString& RoleParams, const FString& LogName)
+	{
+		// -nosteam 让默认子系统回落到 NULL，SteamNetDriver 起不来时用 IpNetDriver
+		const FString Params = FString::Printf(TEXT("\"%s\" -game -nullrhi -nosound -nosteam -unattended -nosplash -stdout -SoakDir=\"%s\" %s -abslog=\"%s\""),
+			*FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *SoakDir, *RoleParams, *(SoakDir / LogName));
+		return FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Params, true, true, true, nullptr, 0, nullptr, nullptr);
+	}
+
+	TSharedPtr<FJsonObject> LoadJson(const FString& Path)
+	{
+		FString Input;
+		TSharedPtr<FJsonObject> Json;
+		if (FFileHelper::LoadFileToString(Input, *Path))
+		{
+			FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Input), Json);
+		}
+		return Json;
+	}
+
+	double GetPercentile(TArray<double>& Values, double Percentile)
+	{
+		if (Values.IsEmpty()) return 0.0;
+		Values.Sort();
+		return Values[FMath::Clamp(FMath::CeilToInt(Percentile / 100.0 * Values.Num()) - 1, 0, Values.Num() - 1)];
+	}
+}
+
+UMultiplayerSessionsSoakCommandlet::UMultiplayerSessionsSoakCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMultiplayerSessionsSoakCommandlet::Main(const FString& Params)
+{
+	using namespace MultiplayerSessionsSoak;
+
+	int32 NumClients = 16;
+	FParse::Value(*Params, TEXT("Clients="), NumClients);
+	NumClients = FMath::Max(NumClients, 1);
+	double Seconds = 120.0;
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+	double Stagger = 0.25;
+	FParse::Value(*Params, TEXT("Stagger="), Stagger);
+	const FString SoakDir = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() / TEXT("Soak") / FDateTime::Now().ToString());
+	FString OutputPath = SoakDir / TEXT("Summary.json");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+	IFileManager::Get().MakeDirectory(*SoakDir, true);
+
+	TArray<FProcHandle> Processes;
+	Processes.Reserve(NumClients + 1);
+	Processes.Add(Launch(SoakDir, FString::Printf(TEXT("-SoakRole=Host -SoakPlayers=%d"), NumClients + 1), TEXT("Host.log")));
+
+	// 客户端要等大厅起来、会话开始广播之后再启动，否则第一批搜索什么都找不到
+	const FString HostReadyPath = SoakDir / UMultiplayerSessionsSoakAgent::HostReadyFileName;
+	const double HostDeadline = FPlatformTime::Seconds() + HostReadyTimeout;
+	while (!IFileManager::Get().FileExists(*HostReadyPath) && FPlatformProcess::IsProcRunning(Processes[0]) && FPlatformTime::Seconds() < HostDeadline)
+	{
+		FPlatformProcess::Sleep(0.1f);
+	}
+	const bool bHostReady = IFileManager::Get().FileExists(*HostReadyPath);
+	if (bHostReady)
+	{
+		UE_LOG(LogMultiplayerSessionsSoak, Display, TEXT("Host is up, starting %d clients"), NumClients);
+		for (int32 ClientIndex = 0; ClientIndex < NumClients; ++ClientIndex)
+		{
+			Processes.Add(Launch(SoakDir, FString::Printf(TEXT("-SoakRole=Client -SoakClientIndex=%d"), ClientIndex), FString::Printf(TEXT("Client_%d.log"), ClientIndex)));
+			FPlatformProcess::Sleep(static_cast<float>(Stagger));
+		}
+		FPlatformProcess::Sleep(static_cast<float>(Seconds));
+	}
+	else
+	{
+		UE_LOG(LogMultiplayerSessionsSoak, Error, TEXT("Host did not bring up the lobby within %.0fs, see %s"), HostReadyTimeout, *(SoakDir / TEXT("Host.log")));
+	}
+
+	// 先让每个进程自己退出，主机在退出前写 Host.json；超时仍未退出的才强制结束
+	FFileHelper::SaveStringToFile(FString(), *(SoakDir / UMultiplayerSessionsSoakAgent::StopFileName));
+	const double StopDeadline = FPlatformTime::Seconds() + StopTimeout;
+	auto IsAnyRunning = [&Processes]
+	{
+		return Processes.ContainsByPredicate([](FProcHandle& Process) { return FPlatformProcess::IsProcRunning(Process); });
+	};
+	while (IsAnyRunning() && FPlatformTime::Seconds() < StopDeadline)
+	{
+		FPlatformProcess::Sleep(0.1f);
+	}
+	for (FProcHandle& Process : Processes)
+	{
+		if (FPlatformProcess::IsProcRunning(Process))
+		{
+			UE_LOG(LogMultiplayerSessionsSoak, Warning, TEXT("A process did not exit within %.0fs of the stop request, terminating it"), StopTimeout);
+			FPlatformProcess::TerminateProc(Process, true);
+		}
+		FPlatformProcess::CloseProc(Process);
+	}
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetStringField(TEXT("Timestamp"), FDateTime::UtcNow().ToIso8601());
+	Root->SetStringField(TEXT("SoakDir"), SoakDir);
+	Root->SetNumberField(TEXT("Clients"), NumClients);
+	Root->SetNumberField(TEXT("Seconds"), Seconds);
+	Root->SetNumberField(TEXT("Stagger"), Stagger);
+	Root->SetBoolField(TEXT("HostReady"), bHostReady);
+	Root->SetObjectField(TEXT("Join"), SummarizeClients(SoakDir, NumClients));
+	Root->SetObjectField(TEXT("Host"), SummarizeHost(SoakDir));
+
+	FString Output;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Root, Writer);
+	if (!FFileHelper::SaveStringToFile(Output, *OutputPath))
+	{
+		UE_LOG(LogMultiplayerSessionsSoak, Error, TEXT("Could not write %s"), *OutputPath);
+		return 1;
+	}
+	UE_LOG(LogMultiplayerSessionsSoak, Display, TEXT("Wrote %s"), *OutputPath);
+	return bHostReady ? 0 : 1;
+}
+
+TSharedRef<FJsonObject> UMultiplayerSessionsSoakCommandlet::SummarizeClients(const FString& SoakDir, int32 NumClients) const
+{
+	using namespace MultiplayerSessionsSoak;
+
+	FSessionLatencyHistogram Histogram;
+	Histogram.SetWindowSize(NumClients);
+	int32 NumJoined = 0, NumFailed = 0, NumMissing = 0;
+	TMap<FString, int32> Failures;
+	// 每个客户端在报告结果时的内存，成功和失败都算
+	double TotalMB = 0.0, MaxMB = 0.0;
+	for (int32 ClientIndex = 0; ClientIndex < NumClients; ++ClientIndex)
+	{
+		const TSharedPtr<FJsonObject> Report = LoadJson(SoakDir / UMultiplayerSessionsSoakAgent::GetClientReportFileName(ClientIndex));
+		// 没有报告说明测试结束时还在搜索或加入
+		if (!Report.IsValid())
+		{
+			++NumMissing;
+			continue;
+		}
+		const double UsedMB = Report->GetNumberField(TEXT("UsedPhysicalMB"));
+		TotalMB += UsedMB;
+		MaxMB = FMath::Max(MaxMB, UsedMB);
+
+		// 延迟只统计成功的加入，失败按原因计数
+		if (Report->GetBoolField(TEXT("Joined")))
+		{
+			FSessionLatencySample Sample;
+			Sample.EndTime = Report->GetNumberField(TEXT("JoinMs")) / 1000.0;
+			Sample.bSucceeded = true;
+			Histogram.Add(Sample);
+			++NumJoined;
+		}
+		else
+		{
+			++NumFailed;
+			++Failures.FindOrAdd(Report->GetStringField(TEXT("Result")));
+		}
+	}
+
+	double P50, P95, P99;
+	Histogram.GetPercentilesMs(P50, P95, P99);
+	const int32 NumReported = NumJoined + NumFailed;
+	const double MeanMB = NumReported > 0 ? TotalMB / NumReported : 0.0;
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	Json->SetNumberField(TEXT("Joined"), NumJoined);
+	Json->SetNumberField(TEXT("Failed"), NumFailed);
+	Json->SetNumberField(TEXT("Missing"), NumMissing);
+	Json->SetNumberField(TEXT("P50Ms"), P50);
+	Json->SetNumberField(TEXT("P95Ms"), P95);
+	Json->SetNumberField(TEXT("P99Ms"), P99);
+	TSharedRef<FJsonObject> FailureJson = MakeShared<FJsonObject>();
+	for (const TPair<FString, int32>& Failure : Failures)
+	{
+		FailureJson->SetNumberField(Failure.Key, Failure.Value);
+	}
+	Json->SetObjectField(TEXT("FailureReasons"), FailureJson);
+	Json->SetNumberField(TEXT("MeanUsedPhysicalMB"), MeanMB);
+	Json->SetNumberField(TEXT("MaxUsedPhysicalMB"), MaxMB);
+	UE_LOG(LogMultiplayerSessionsSoak, Display, TEXT("Joins: %d joined, %d failed, %d missing, p50 %.0fms, p95 %.0fms, p99 %.0fms, client memory mean %.0fMB max %.0fMB"),
+		NumJoined, NumFailed, NumMissing, P50, P95, P99, MeanMB, MaxMB);
+	return Json;
+}
+
+TSharedRef<FJsonObject> UMultiplayerSessionsSoakCommandlet::SummarizeHost(const FString& SoakDir) const
+{
+	using namespace MultiplayerSessionsSoak;
+
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	const TSharedPtr<FJsonObject> Report = LoadJson(SoakDir / UMultiplayerSessionsSoakAgent::HostReportFileName);
+	if (!Report.IsValid())
+	{
+		Json->SetStringField(TEXT("Skipped"), TEXT("No host report"));
+		return Json;
+	}
+
+	// 登录吞吐：第一次到最后一次登录之间每秒的登录数
+	TArray<double> LoginSeconds;
+	for (const TSharedPtr<FJsonValue>& Value : Report->GetArrayField(TEXT("LoginSeconds")))
+	{
+		LoginSeconds.Add(Value->AsNumber());
+	}
+	const double LoginSpan = LoginSeconds.Num() > 1 ? LoginSeconds.Last() - LoginSeconds[0] : 0.0;
+	Json->SetNumberField(TEXT("Logins"), LoginSeconds.Num());
+	Json->SetNumberField(TEXT("LoginsPerSecond"), LoginSpan > 0.0 ? (LoginSeconds.Num() - 1) / LoginSpan : 0.0);
+
+	// 每秒一个采样：帧时间看分布，内存看从第一次登录开始的增长
+	TArray<double> AverageFrameMs;
+	double MaxFrameMs = 0.0, PeakMB = 0.0, FirstMB = 0.0, FirstSeconds = 0.0, LastMB = 0.0, LastSeconds = 0.0;
+	int32 MaxPlayers = 0;
+	TArray<TSharedPtr<FJsonValue>> Timeline;
+	for (const TSharedPtr<FJsonValue>& Value : Report->GetArrayField(TEXT("Samples")))
+	{
+		const TSharedPtr<FJsonObject>& Sample = Value->AsObject();
+		const double SampleSeconds = Sample->GetNumberField(TEXT("Seconds"));
+		const double UsedMB = Sample->GetNumberField(TEXT("UsedPhysicalMB"));
+		const int32 NumPlayers = static_cast<int32>(Sample->GetNumberField(TEXT("Players")));
+		AverageFrameMs.Add(Sample->GetNumberField(TEXT("AverageFrameMs")));
+		MaxFrameMs = FMath::Max(MaxFrameMs, Sample->GetNumberField(TEXT("MaxFrameMs")));
+		PeakMB = FMath::Max(PeakMB, UsedMB);
+		MaxPlayers = FMath::Max(MaxPlayers, NumPlayers);
+		if (FirstMB == 0.0 && (LoginSeconds.IsEmpty() || SampleSeconds >= LoginSeconds[0]))
+		{
+			FirstMB = UsedMB;
+			FirstSeconds = SampleSeconds;
+		}
+		LastMB = UsedMB;
+		LastSeconds = SampleSeconds;
+		Timeline.Add(Value);
+	}
+	const double FrameP50 = GetPercentile(AverageFrameMs, 50.0);
+	const double FrameP95 = GetPercentile(AverageFrameMs, 95.0);
+	const double FrameP99 = GetPercentile(AverageFrameMs, 99.0);
+	const double GrowthMBPerMinute = LastSeconds > FirstSeconds ? (LastMB - FirstMB) / (LastSeconds - FirstSeconds) * 60.0 : 0.0;
+
+	Json->SetNumberField(TEXT("MaxPlayers"), MaxPlayers);
+	Json->SetNumberField(TEXT("FrameP50Ms"), FrameP50);
+	Json->SetNumberField(TEXT("FrameP95Ms"), FrameP95);
+	Json->SetNumberField(TEXT("FrameP99Ms"), FrameP99);
+	Json->SetNumberField(TEXT("FrameMaxMs"), MaxFrameMs);
+	Json->SetNumberField(TEXT("FirstMB"), FirstMB);
+	Json->SetNumberField(TEXT("LastMB"), LastMB);
+	Json->SetNumberField(TEXT("PeakMB"), PeakMB);
+	Json->SetNumberField(TEXT("GrowthMBPerMinute"), GrowthMBPerMinute);
+	Json->SetArrayField(TEXT("Timeline"), Timeline);
+	UE_LOG(LogMultiplayerSessionsSoak, Display, TEXT("Host: %d logins (%.2f/s), %d players, frame p50 %.2fms p95 %.2fms max %.2fms, memory %.0f -> %.0fMB (%.2fMB/min)"),
+		LoginSeconds.Num(), LoginSpan > 0.0 ? (LoginSeconds.Num() - 1) / LoginSpan : 0.0, MaxPlayers, FrameP50, FrameP95, MaxFrameMs, FirstMB, LastMB, GrowthMBPerMinute);
+	return Json;
+}
@@ -6,119 +6,1568 @@
 #include "OnlineSessionSettings.h"
 #include "OnlineSubsystem.h"
 #include "OnlineSubsystemUtils.h"
+#include "OnlineSubsystemTypes.h"
 #include "Online/OnlineSessionNames.h"
+#include "Engine/GameInstance.h"
+#include "Engine/LocalPlayer.h"
+#include "GameFramework/PlayerController.h"
+#include "TimerManager.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+#include "ProfilingDebugging/MiscTrace.h"
+#include "Misc/CommandLine.h"
+#include "FakeOnlineSession.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMultiplayerSessions, Log, All);
+
+static const TCHAR* LexToString(EHostPipelineStage Stage)
+{
+	switch (Stage)
+	{
+	case EHostPipelineStage::SessionCreated: return TEXT("SessionCreated");
+	case EHostPipelineStage::LobbyLoaded: return TEXT("LobbyLoaded");
+	case EHostPipelineStage::TravelStarted: return TEXT("TravelStarted");
+	default: return TEXT("Failed");
+	}
+}
+
+static const TCHAR* LexToString(ESessionOperationType Type)
+{
+	switch (Type)
+	{
+	case ESessionOperationType::Create: return TEXT("Create");
+	case ESessionOperationType::Find: return TEXT("Find");
+	case ESessionOperationType::Join: return TEXT("Join");
+	case ESessionOperationType::Destroy: return TEXT("Destroy");
+	case ESessionOperationType::Start: return TEXT("Start");
+	case ESessionOperationType::End: return TEXT("End");
+	default: return TEXT("Update");
+	}
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice DumpSessionStatsCommand(
+	TEXT("MultiplayerSessions.DumpStats"),
+	TEXT("Print count, failures and p50/p95/p99 latency of every session operation and of travel"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+		if (UMultiplayerSessionsSubsystem* Subsystem = GameInstance ? GameInstance->GetSubsystem<UMultiplayerSessionsSubsystem>() : nullptr)
+		{
+			Subsystem->GetLatencyStats().Dump(Ar);
+		}
+	}));
 
 UMultiplayerSessionsSubsystem::UMultiplayerSessionsSubsystem():
 	OnCreateSessionCompleteDelegate(FOnCreateSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnCreateSessionComplete)),
 	OnFindSessionsCompleteDelegate(FOnFindSessionsCompleteDelegate::CreateUObject(this, &ThisClass::OnFindSessionsComplete)),
 	OnJoinSessionCompleteDelegate(FOnJoinSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnJoinSessionComplete)),
 	OnDestroySessionCompleteDelegate(FOnDestroySessionCompleteDelegate::CreateUObject(this, &ThisClass::OnDestroySessionComplete)),
-	OnStartSessionCompleteDelegate(FOnStartSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnStartSessionComplete))
+	OnStartSessionCompleteDelegate(FOnStartSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnStartSessionComplete)),
+	OnEndSessionCompleteDelegate(FOnEndSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnEndSessionComplete)),
+	OnUpdateSessionCompleteDelegate(FOnUpdateSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnUpdateSessionComplete))
+{
+	LatencyProbe = MakeShared<FIcmpSessionLatencyProbe>();
+}
+
+void UMultiplayerSessionsSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// 配置在构造函数里还没有加载，所以在这里选择会话后端；接口本身等第一次使用时再查找
+	bUseFakeBackend = bUseFakeOnlineSession || FParse::Param(FCommandLine::Get(), TEXT("FakeOnlineSession"));
+	if (bUseFakeBackend)
+	{
+		// 假主机没有真实地址，不做ICMP探测
+		LatencyProbe.Reset();
+		FakeSimulation = FFakeSessionSimulation::LoadFromConfig();
+	}
+	OperationTimeoutTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+		FTickerDelegate::CreateUObject(this, &ThisClass::TickOperationTimeout), 0.5f);
+	PostLoadMapDelegateHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &ThisClass::OnPostLoadMap);
+
+	LatencyStats.SetWindowSize(LatencyStatsWindow);
+	if (GEngine)
+	{
+		TravelFailureDelegateHandle = GEngine->OnTravelFailure().AddUObject(this, &ThisClass::OnTravelFailure);
+		NetworkFailureDelegateHandle = GEngine->OnNetworkFailure().AddUObject(this, &ThisClass::OnNetworkFailure);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::BindOnlineSession()
+{
+	IOnlineSessionPtr SessionInterface;
+	if (bUseFakeBackend)
+	{
+		// 假后端属于 GameInstance，换地图时不重建
+		if (OnlineSessionPtr.IsValid()) return;
+		SessionInterface = MakeShared<FFakeOnlineSession, ESPMode::ThreadSafe>(FakeSimulation);
+		UE_LOG(LogMultiplayerSessions, Log, TEXT("Using the fake online session backend"));
+	}
+	else if (const IOnlineSubsystem* OnlineSubsystem = Online::GetSubsystem(GetWorld()))
+	{
+		SessionInterface = OnlineSubsystem->GetSessionInterface();
+	}
+	if (SessionInterface == OnlineSessionPtr) return;
+
+	const bool bRebinding = OnlineSessionPtr.IsValid();
+	UnbindOnlineSession();
+	OnlineSessionPtr = SessionInterface;
+
+	// 委托只注册一次，完成回调由操作队列交给当前正在执行的操作
+	if (OnlineSessionPtr.IsValid())
+	{
+		OnCreateSessionCompleteDelegateHandle = OnlineSessionPtr->AddOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegate);
+		OnFindSessionsCompleteDelegateHandle = OnlineSessionPtr->AddOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegate);
+		OnJoinSessionCompleteDelegateHandle = OnlineSessionPtr->AddOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegate);
+		OnDestroySessionCompleteDelegateHandle = OnlineSessionPtr->AddOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegate);
+		OnStartSessionCompleteDelegateHandle = OnlineSessionPtr->AddOnStartSessionCompleteDelegate_Handle(OnStartSessionCompleteDelegate);
+		OnEndSessionCompleteDelegateHandle = OnlineSessionPtr->AddOnEndSessionCompleteDelegate_Handle(OnEndSessionCompleteDelegate);
+		OnUpdateSessionCompleteDelegateHandle = OnlineSessionPtr->AddOnUpdateSessionCompleteDelegate_Handle(OnUpdateSessionCompleteDelegate);
+	}
+
+	if (bRebinding)
+	{
+		UE_LOG(LogMultiplayerSessions, Log, TEXT("Session interface changed with the world, rebound"));
+		// 旧接口上还在执行的操作再也等不到回调
+		AwaitedReplies.Reset();
+		FailActiveOperation();
+	}
+}
+
+bool UMultiplayerSessionsSubsystem::UseFakeOnlineSession(const FFakeSessionSimulation& Simulation)
+{
+	if (IsBusy())
+	{
+		UE_LOG(LogMultiplayerSessions, Warning, TEXT("Cannot switch to the fake session backend while operations are queued"));
+		return false;
+	}
+
+	// 换成新的假后端，旧后端的缓存搜索结果一起作废
+	UnbindOnlineSession();
+	AwaitedReplies.Reset();
+	InvalidateSearchCache();
+	bUseFakeBackend = true;
+	FakeSimulation = Simulation;
+	LatencyProbe.Reset();
+	BindOnlineSession();
+	return OnlineSessionPtr.IsValid();
+}
+
+void UMultiplayerSessionsSubsystem::UnbindOnlineSession()
+{
+	if (!OnlineSessionPtr.IsValid()) return;
+
+	OnlineSessionPtr->ClearOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegateHandle);
+	OnlineSessionPtr->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
+	OnlineSessionPtr->ClearOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegateHandle);
+	OnlineSessionPtr->ClearOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegateHandle);
+	OnlineSessionPtr->ClearOnStartSessionCompleteDelegate_Handle(OnStartSessionCompleteDelegateHandle);
+	OnlineSessionPtr->ClearOnEndSessionCompleteDelegate_Handle(OnEndSessionCompleteDelegateHandle);
+	OnlineSessionPtr->ClearOnUpdateSessionCompleteDelegate_Handle(OnUpdateSessionCompleteDelegateHandle);
+	OnlineSessionPtr.Reset();
+}
+
+bool UMultiplayerSessionsSubsystem::IsLanSubsystem() const
+{
+	// 假后端没有对应的OnlineSubsystem，按局域网处理
+	const IOnlineSubsystem* OnlineSubsystem = Online::GetSubsystem(GetWorld());
+	return OnlineSubsystem == nullptr || OnlineSubsystem->GetSubsystemName() == "NULL";
+}
+
+void UMultiplayerSessionsSubsystem::Deinitialize()
+{
+	StopStreamingSearch();
+	StopResultProcessing();
+	// 关闭时不再通知等待加入的调用者
+	JoinBestWhenRankedId = INDEX_NONE;
+	StopRanking();
+	StopJoinAttempts();
+	FTSTicker::GetCoreTicker().RemoveTicker(OperationTimeoutTickerHandle);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapDelegateHandle);
+	if (GEngine)
+	{
+		GEngine->OnTravelFailure().Remove(TravelFailureDelegateHandle);
+		GEngine->OnNetworkFailure().Remove(NetworkFailureDelegateHandle);
+	}
+	HostPipeline.Reset();
+	PreloadedLobbyPackage = nullptr;
+	if (UGameInstance* GameInstance = GetGameInstance())
+	{
+		GameInstance->GetTimerManager().ClearTimer(SearchCacheRefreshTimerHandle);
+		GameInstance->GetTimerManager().ClearTimer(AdvertisedStateTimerHandle);
+	}
+	UnbindOnlineSession();
+	PendingOperations.Reset();
+	ActiveOperation.Reset();
+	AwaitedReplies.Reset();
+	Super::Deinitialize();
+}
+
+int32 UMultiplayerSessionsSubsystem::CreateSession(int32 NumPublicConnections, FString MatchType, FString MapName)
+{
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::Create;
+	Operation.CoalesceKey = FString::Printf(TEXT("%d|%s|%s"), NumPublicConnections, *MatchType, *MapName);
+	Operation.NumPublicConnections = NumPublicConnections;
+	Operation.MatchType = MatchType;
+	Operation.MapName = MapName;
+	return EnqueueOperation(MoveTemp(Operation));
+}
+
+int32 UMultiplayerSessionsSubsystem::HostSession(int32 NumPublicConnections, FString MatchType, const FString& TravelURL)
+{
+	FHostPipeline& Pipeline = HostPipeline.Emplace();
+	Pipeline.TravelURL = TravelURL;
+	Pipeline.StartTime = FPlatformTime::Seconds();
+
+	// "/Game/ThirdPerson/Maps/Lobby?listen" -> "/Game/ThirdPerson/Maps/Lobby"
+	FString LobbyPackage;
+	if (!TravelURL.Split(TEXT("?"), &LobbyPackage, nullptr))
+	{
+		LobbyPackage = TravelURL;
+	}
+	Pipeline.LobbyPackageName = FName(*LobbyPackage);
+
+	// 创建 Session 的同时在后台加载大厅地图，两者都完成后再 ServerTravel
+	if (FPackageName::IsValidLongPackageName(LobbyPackage))
+	{
+		LoadPackageAsync(LobbyPackage, FLoadPackageAsyncDelegate::CreateUObject(this, &ThisClass::OnLobbyPackageLoaded));
+	}
+	else
+	{
+		Pipeline.bLobbyLoaded = true;
+	}
+
+	const int32 OperationId = CreateSession(NumPublicConnections, MatchType, LobbyPackage);
+	// The create may already have failed synchronously and torn the pipeline down
+	if (HostPipeline.IsSet())
+	{
+		HostPipeline->CreateOperationId = OperationId;
+	}
+	return OperationId;
+}
+
+void UMultiplayerSessionsSubsystem::OnLobbyPackageLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result)
+{
+	if (!HostPipeline.IsSet() || HostPipeline->LobbyPackageName != PackageName || HostPipeline->bLobbyLoaded) return;
+
+	if (Result == EAsyncLoadingResult::Succeeded)
+	{
+		PreloadedLobbyPackage = LoadedPackage;
+	}
+	else
+	{
+		// Not fatal, ServerTravel will just load it on the critical path
+		UE_LOG(LogMultiplayerSessions, Warning, TEXT("Preloading %s failed"), *PackageName.ToString());
+	}
+	HostPipeline->bLobbyLoaded = true;
+	AdvanceHostPipeline(EHostPipelineStage::LobbyLoaded);
+}
+
+void UMultiplayerSessionsSubsystem::AdvanceHostPipeline(EHostPipelineStage Stage)
+{
+	const double SecondsSinceHost = FPlatformTime::Seconds() - HostPipeline->StartTime;
+	UE_LOG(LogMultiplayerSessions, Log, TEXT("Host pipeline: %s after %.3fs"), LexToString(Stage), SecondsSinceHost);
+	MultiplayerOnHostStageDelegate.Broadcast(Stage, SecondsSinceHost);
+
+	if (Stage == EHostPipelineStage::Failed)
+	{
+		HostPipeline.Reset();
+		PreloadedLobbyPackage = nullptr;
+		return;
+	}
+	if (!HostPipeline->bSessionCreated || !HostPipeline->bLobbyLoaded) return;
+
+	const FString TravelURL = HostPipeline->TravelURL;
+	const double StartTime = HostPipeline->StartTime;
+	HostPipeline.Reset();
+	if (UWorld* World = GetWorld())
+	{
+		BeginTravelLatency();
+		World->ServerTravel(TravelURL);
+	}
+	const double SecondsUntilTravel = FPlatformTime::Seconds() - StartTime;
+	UE_LOG(LogMultiplayerSessions, Log, TEXT("Host pipeline: %s after %.3fs"), LexToString(EHostPipelineStage::TravelStarted), SecondsUntilTravel);
+	MultiplayerOnHostStageDelegate.Broadcast(EHostPipelineStage::TravelStarted, SecondsUntilTravel);
+}
+
+void UMultiplayerSessionsSubsystem::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	EndTravelLatency(LoadedWorld != nullptr);
+	// 只在已经用过接口时重新绑定，否则继续等到第一次使用
+	if (OnlineSessionPtr.IsValid())
+	{
+		BindOnlineSession();
+	}
+
+	// The travel has picked the lobby up (or gone somewhere else), no need to pin it any longer
+	if (!HostPipeline.IsSet())
+	{
+		PreloadedLobbyPackage = nullptr;
+	}
+	PreloadedJoinPackage = nullptr;
+	PreloadingJoinPackageName = NAME_None;
+}
+
+void UMultiplayerSessionsSubsystem::PreloadCandidateMap(const FOnlineSessionSearchResult& SearchResult)
+{
+	FString MapName;
+	if (!SearchResult.Session.SessionSettings.Get(SETTING_MAPNAME, MapName) || !FPackageName::IsValidLongPackageName(MapName)) return;
+
+	const FName PackageName(*MapName);
+	if (PackageName == PreloadingJoinPackageName) return;
+
+	// 提前加载房主广播的地图，加入成功后 ClientTravel 不再需要同步加载
+	PreloadingJoinPackageName = PackageName;
+	PreloadedJoinPackage = nullptr;
+	LoadPackageAsync(MapName, FLoadPackageAsyncDelegate::CreateUObject(this, &ThisClass::OnCandidateMapLoaded));
+}
+
+void UMultiplayerSessionsSubsystem::OnCandidateMapLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result)
+{
+	if (PackageName != PreloadingJoinPackageName) return;
+
+	if (Result == EAsyncLoadingResult::Succeeded)
+	{
+		PreloadedJoinPackage = LoadedPackage;
+	}
+	else
+	{
+		UE_LOG(LogMultiplayerSessions, Warning, TEXT("Preloading %s failed"), *PackageName.ToString());
+	}
+}
+
+void UMultiplayerSessionsSubsystem::TravelToJoinedSession(const FString& PreResolvedConnectString)
+{
+	FString Address = PreResolvedConnectString;
+	if (Address.IsEmpty())
+	{
+		GetResolvedConnectString(NAME_GameSession, Address);
+	}
+
+	UGameInstance* GameInstance = GetGameInstance();
+	if (APlayerController* PlayerController = GameInstance ? GameInstance->GetFirstLocalPlayerController() : nullptr)
+	{
+		BeginTravelLatency();
+		PlayerController->ClientTravel(Address, TRAVEL_Absolute);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::BeginTravelLatency()
+{
+	TravelStartTime = FPlatformTime::Seconds();
+	TRACE_BOOKMARK(TEXT("Session Travel begin"));
+}
+
+void UMultiplayerSessionsSubsystem::EndTravelLatency(bool bSucceeded, int32 ResultCode)
+{
+	if (TravelStartTime == 0.0) return;
+
+	FSessionLatencySample Sample;
+	Sample.BeginTime = TravelStartTime;
+	Sample.EndTime = FPlatformTime::Seconds();
+	Sample.bSucceeded = bSucceeded;
+	Sample.ResultCode = ResultCode;
+	LatencyStats.Record(ESessionLatencyStat::Travel, Sample);
+	TravelStartTime = 0.0;
+	TRACE_BOOKMARK(TEXT("Session Travel end"));
+	UE_LOG(LogMultiplayerSessions, Log, TEXT("Travel %s after %.1fms"), bSucceeded ? TEXT("succeeded") : TEXT("failed"), Sample.GetDurationMs());
+}
+
+void UMultiplayerSessionsSubsystem::OnTravelFailure(UWorld* World, ETravelFailure::Type FailureType, const FString& ErrorString)
+{
+	EndTravelLatency(false, static_cast<int32>(FailureType));
+}
+
+void UMultiplayerSessionsSubsystem::OnNetworkFailure(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString)
+{
+	EndTravelLatency(false, static_cast<int32>(FailureType));
+}
+
+int32 UMultiplayerSessionsSubsystem::FindSessions(int32 MaxSearchResults, bool bStreamResults)
+{
+	return FindSessions(FMultiplayerSessionQuery().WithMaxResults(MaxSearchResults).Streamed(bStreamResults));
+}
+
+int32 UMultiplayerSessionsSubsystem::FindSessions(const FMultiplayerSessionQuery& Query)
+{
+	return EnqueueFindSessions(Query, false);
+}
+
+int32 UMultiplayerSessionsSubsystem::EnqueueFindSessions(const FMultiplayerSessionQuery& Query, bool bJoinBest)
+{
+	// A caller's search takes over from a background revalidation
+	if (ActiveOperation.IsSet() && ActiveOperation->Type == ESessionOperationType::Find && ActiveOperation->bBackground)
+	{
+		CancelOperation(ActiveOperation->Id);
+	}
+
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::Find;
+	Operation.CoalesceKey = Query.ToCacheKey() + (Query.bStreamResults ? TEXT("|Streamed") : TEXT(""));
+	Operation.Query = Query;
+	Operation.bJoinBest = bJoinBest;
+	return EnqueueOperation(MoveTemp(Operation));
+}
+
+int32 UMultiplayerSessionsSubsystem::JoinSession(const FOnlineSessionSearchResult& SessionResult)
+{
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::Join;
+	Operation.CoalesceKey = SessionResult.GetSessionIdStr();
+	Operation.JoinTarget = SessionResult;
+	return EnqueueOperation(MoveTemp(Operation));
+}
+
+int32 UMultiplayerSessionsSubsystem::DestroySession()
+{
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::Destroy;
+	return EnqueueOperation(MoveTemp(Operation));
+}
+
+int32 UMultiplayerSessionsSubsystem::StartSession()
+{
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::Start;
+	return EnqueueOperation(MoveTemp(Operation));
+}
+
+int32 UMultiplayerSessionsSubsystem::EndSession()
+{
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::End;
+	return EnqueueOperation(MoveTemp(Operation));
+}
+
+int32 UMultiplayerSessionsSubsystem::UpdateSession()
+{
+	// 设置在执行时才读取，所以同一个 Session 排队中的更新只保留一个，它会带上之前的所有变化
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::Update;
+	Operation.CoalesceKey = NAME_GameSession.ToString();
+	return EnqueueOperation(MoveTemp(Operation));
+}
+
+void UMultiplayerSessionsSubsystem::SetAdvertisedPlayerCount(int32 NumPlayers)
+{
+	if (AdvertisedNumPlayers == NumPlayers) return;
+
+	AdvertisedNumPlayers = NumPlayers;
+	bAdvertisedStateDirty = true;
+	ScheduleAdvertisedStateUpdate();
+}
+
+void UMultiplayerSessionsSubsystem::SetAdvertisedMatchPhase(EMultiplayerMatchPhase Phase)
+{
+	if (AdvertisedMatchPhase == Phase) return;
+
+	const EMultiplayerMatchPhase PreviousPhase = AdvertisedMatchPhase;
+	AdvertisedMatchPhase = Phase;
+	bAdvertisedStateDirty = true;
+	if (!LastSessionSettings.IsValid()) return;
+
+	// 比赛开始和结束不做合并，立即通知后端
+	if (Phase == EMultiplayerMatchPhase::InProgress)
+	{
+		StartSession();
+	}
+	else if (PreviousPhase == EMultiplayerMatchPhase::InProgress)
+	{
+		EndSession();
+	}
+	ScheduleAdvertisedStateUpdate();
+}
+
+void UMultiplayerSessionsSubsystem::ScheduleAdvertisedStateUpdate()
+{
+	UGameInstance* GameInstance = GetGameInstance();
+	if (!LastSessionSettings.IsValid() || GameInstance == nullptr) return;
+
+	// 只在第一次变化时计时，之后的变化在同一次更新里一起发送
+	FTimerManager& TimerManager = GameInstance->GetTimerManager();
+	if (!TimerManager.IsTimerActive(AdvertisedStateTimerHandle))
+	{
+		TimerManager.SetTimer(AdvertisedStateTimerHandle, this, &ThisClass::FlushAdvertisedState, FMath::Max(SessionUpdateDebounce, KINDA_SMALL_NUMBER), false);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::FlushAdvertisedState()
+{
+	// Session 还没建好时保留这些变化，创建完成后再推送
+	if (!bAdvertisedStateDirty || !LastSessionSettings.IsValid() || !OnlineSessionPtr.IsValid() || OnlineSessionPtr->GetNamedSession(NAME_GameSession) == nullptr) return;
+
+	// 人数变化也要推送：空位数随这次更新一起重新广播，即使可加入状态和阶段都没变
+	bAdvertisedStateDirty = false;
+	WriteAdvertisedState(*LastSessionSettings);
+	UpdateSession();
+}
+
+void UMultiplayerSessionsSubsystem::WriteAdvertisedState(FOnlineSessionSettings& Settings) const
+{
+	Settings.Set(FMultiplayerSessionQuery::MatchPhaseKey, static_cast<int32>(AdvertisedMatchPhase), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+	Settings.Set(FMultiplayerSessionQuery::JoinableKey, IsAdvertisedSessionJoinable() ? 1 : 0, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+}
+
+bool UMultiplayerSessionsSubsystem::IsAdvertisedSessionJoinable() const
+{
+	const bool bHasOpenSlot = LastSessionSettings.IsValid() && AdvertisedNumPlayers < LastSessionSettings->NumPublicConnections;
+	switch (AdvertisedMatchPhase)
+	{
+	case EMultiplayerMatchPhase::Lobby:
+		return bHasOpenSlot;
+	case EMultiplayerMatchPhase::InProgress:
+		return bHasOpenSlot && bAllowJoinInProgress;
+	default:
+		return false;
+	}
+}
+
+bool UMultiplayerSessionsSubsystem::CancelOperation(int32 OperationId)
+{
+	const int32 PendingIndex = PendingOperations.IndexOfByPredicate([OperationId](const FSessionOperation& Operation) { return Operation.Id == OperationId; });
+	if (PendingIndex != INDEX_NONE)
+	{
+		const FSessionOperation Cancelled = PendingOperations[PendingIndex];
+		PendingOperations.RemoveAt(PendingIndex);
+		if (Cancelled.Type == ESessionOperationType::Find && !Cancelled.bBackground)
+		{
+			MultiplayerOnFindSessionsCancelledDelegate.Broadcast(OperationId);
+		}
+		// FindAndJoinSession 的调用者仍在等加入的结果
+		if (Cancelled.bJoinBest)
+		{
+			BroadcastJoinBestFailure(OperationId, EOnJoinSessionCompleteResult::UnknownError);
+		}
+		return true;
+	}
+	if (!ActiveOperation.IsSet() || ActiveOperation->Id != OperationId)
+	{
+		return false;
+	}
+
+	if (ActiveOperation->Type == ESessionOperationType::Find)
+	{
+		// Searches can be cancelled on the backend, so the queue moves on right away
+		CancelSearch();
+		FSessionOperation Cancelled;
+		TakeActiveOperation(ESessionOperationType::Find, OperationId, Cancelled);
+		// 菜单提前加入时停止的搜索是最常见的搜索，单独计为取消
+		RecordOperationLatency(Cancelled, false, 0, MatchingResultIndices.Num(), true);
+		if (!Cancelled.bBackground)
+		{
+			MultiplayerOnFindSessionsCancelledDelegate.Broadcast(OperationId);
+		}
+		if (Cancelled.bJoinBest)
+		{
+			BroadcastJoinBestFailure(OperationId, EOnJoinSessionCompleteResult::UnknownError);
+		}
+		PumpOperationQueue();
+	}
+	else
+	{
+		// Create/Join/Destroy/Start can't be taken back, the result is swallowed when it arrives
+		ActiveOperation->bCancelled = true;
+	}
+	return true;
+}
+
+bool UMultiplayerSessionsSubsystem::IsOperationQueued(int32 OperationId) const
+{
+	return (ActiveOperation.IsSet() && ActiveOperation->Id == OperationId)
+		|| PendingOperations.ContainsByPredicate([OperationId](const FSessionOperation& Operation) { return Operation.Id == OperationId; });
+}
+
+int32 UMultiplayerSessionsSubsystem::EnqueueOperation(FSessionOperation&& Operation)
+{
+	// 与正在执行或排队中的相同请求合并
+	auto IsDuplicate = [&Operation](const FSessionOperation& Other)
+	{
+		return !Other.bCancelled && Other.Type == Operation.Type && Other.CoalesceKey == Operation.CoalesceKey;
+	};
+	// A running update has already sent the settings as they were, changes made since need an update of their own
+	if (ActiveOperation.IsSet() && IsDuplicate(*ActiveOperation) && ActiveOperation->Type != ESessionOperationType::Update)
+	{
+		return ActiveOperation->Id;
+	}
+	if (const FSessionOperation* Pending = PendingOperations.FindByPredicate(IsDuplicate))
+	{
+		return Pending->Id;
+	}
+
+	Operation.Id = NextOperationId++;
+	const int32 OperationId = Operation.Id;
+	PendingOperations.Add(MoveTemp(Operation));
+	PumpOperationQueue();
+	return OperationId;
+}
+
+void UMultiplayerSessionsSubsystem::PumpOperationQueue()
+{
+	// Operations that complete synchronously inside Execute* call back in here, the loop below picks up the next one
+	if (bPumpingOperationQueue) return;
+
+	TGuardValue<bool> PumpingGuard(bPumpingOperationQueue, true);
+	while (!ActiveOperation.IsSet() && !PendingOperations.IsEmpty())
+	{
+		ActiveOperation = MoveTemp(PendingOperations[0]);
+		PendingOperations.RemoveAt(0);
+		ActiveOperation->StartTime = FPlatformTime::Seconds();
+		TRACE_BOOKMARK(TEXT("Session %s begin"), LexToString(ActiveOperation->Type));
+		ExecuteActiveOperation();
+	}
+}
+
+void UMultiplayerSessionsSubsystem::ExecuteActiveOperation()
+{
+	if (!OnlineSessionPtr.IsValid())
+	{
+		BindOnlineSession();
+	}
+	if (!OnlineSessionPtr.IsValid())
+	{
+		FailActiveOperation();
+		return;
+	}
+
+	switch (ActiveOperation->Type)
+	{
+	case ESessionOperationType::Create:
+		ExecuteCreateSession();
+		break;
+	case ESessionOperationType::Find:
+		ExecuteFindSessions();
+		break;
+	case ESessionOperationType::Join:
+		ExecuteJoinSession();
+		break;
+	case ESessionOperationType::Destroy:
+		ExecuteDestroySession();
+		break;
+	case ESessionOperationType::Start:
+		ExecuteStartSession();
+		break;
+	case ESessionOperationType::End:
+		ExecuteEndSession();
+		break;
+	case ESessionOperationType::Update:
+		ExecuteUpdateSession();
+		break;
+	}
+}
+
+bool UMultiplayerSessionsSubsystem::TakeActiveOperation(ESessionOperationType Type, int32 OperationId, FSessionOperation& OutOperation)
+{
+	if (!ActiveOperation.IsSet() || ActiveOperation->Type != Type) return false;
+	if (OperationId != INDEX_NONE && ActiveOperation->Id != OperationId) return false;
+
+	OutOperation = MoveTemp(ActiveOperation.GetValue());
+	ActiveOperation.Reset();
+	return true;
+}
+
+void UMultiplayerSessionsSubsystem::FailActiveOperation()
+{
+	if (!ActiveOperation.IsSet()) return;
+
+	// 已发出的调用仍在 AwaitedReplies 中，迟到的回复会被丢弃
+	const int32 OperationId = ActiveOperation->Id;
+	switch (ActiveOperation->Type)
+	{
+	case ESessionOperationType::Create:
+		CompleteCreateSession(OperationId, false);
+		break;
+	case ESessionOperationType::Find:
+		CancelSearch();
+		CompleteFindSessions(OperationId, false);
+		break;
+	case ESessionOperationType::Join:
+		CompleteJoinSession(OperationId, EOnJoinSessionCompleteResult::UnknownError);
+		break;
+	default:
+		CompleteSessionStateChange(ActiveOperation->Type, OperationId, false);
+		break;
+	}
+}
+
+void UMultiplayerSessionsSubsystem::DispatchActiveOperation(TFunctionRef<bool()> Call)
+{
+	const int32 OperationId = ActiveOperation->Id;
+	// 先登记再调用：有的后端在调用内部就同步回复
+	AwaitedReplies.Add({ActiveOperation->Type, OperationId, FPlatformTime::Seconds()});
+	if (Call()) return;
+
+	// 调用失败。回复若已同步到达，操作已经完成；否则不会再有回复，由我们结束它
+	const int32 AwaitedIndex = AwaitedReplies.IndexOfByPredicate([OperationId](const FAwaitedReply& Reply) { return Reply.OperationId == OperationId; });
+	if (AwaitedIndex != INDEX_NONE)
+	{
+		AwaitedReplies.RemoveAt(AwaitedIndex);
+		if (ActiveOperation.IsSet() && ActiveOperation->Id == OperationId)
+		{
+			FailActiveOperation();
+		}
+	}
+}
+
+int32 UMultiplayerSessionsSubsystem::TakeAwaitedReply(ESessionOperationType Type)
+{
+	// A reply owed to a timed out operation that still hasn't shown up after another timeout is taken as lost,
+	// so one reply the backend never sends can't shift every later reply onto the wrong operation
+	const double Now = FPlatformTime::Seconds();
+	const int32 ActiveId = ActiveOperation.IsSet() ? ActiveOperation->Id : INDEX_NONE;
+	AwaitedReplies.RemoveAll([this, Now, ActiveId](const FAwaitedReply& Reply)
+	{
+		return Reply.OperationId != ActiveId && Now - Reply.DispatchTime > 2.f * GetOperationTimeout(Reply.Type);
+	});
+
+	const int32 AwaitedIndex = AwaitedReplies.IndexOfByPredicate([Type](const FAwaitedReply& Reply) { return Reply.Type == Type; });
+	if (AwaitedIndex == INDEX_NONE) return INDEX_NONE;
+
+	const int32 OperationId = AwaitedReplies[AwaitedIndex].OperationId;
+	AwaitedReplies.RemoveAt(AwaitedIndex);
+	if (OperationId != ActiveId)
+	{
+		UE_LOG(LogMultiplayerSessions, Log, TEXT("Ignoring a late %s reply for operation %d"), LexToString(Type), OperationId);
+	}
+	return OperationId;
+}
+
+bool UMultiplayerSessionsSubsystem::TickOperationTimeout(float DeltaTime)
+{
+	if (ActiveOperation.IsSet() && FPlatformTime::Seconds() - ActiveOperation->StartTime > GetOperationTimeout(ActiveOperation->Type))
+	{
+		UE_LOG(LogMultiplayerSessions, Warning, TEXT("Session operation %d timed out, completing it as failed"), ActiveOperation->Id);
+		FailActiveOperation();
+	}
+	return true;
+}
+
+float UMultiplayerSessionsSubsystem::GetOperationTimeout(ESessionOperationType Type) const
+{
+	return Type == ESessionOperationType::Find ? FindOperationTimeout : OperationTimeout;
+}
+
+void UMultiplayerSessionsSubsystem::RecordOperationLatency(const FSessionOperation& Operation, bool bSucceeded, int32 ResultCode, int32 ResultCount, bool bCancelled)
+{
+	FSessionLatencySample Sample;
+	Sample.BeginTime = Operation.StartTime;
+	Sample.EndTime = FPlatformTime::Seconds();
+	Sample.bSucceeded = bSucceeded;
+	Sample.bCancelled = bCancelled;
+	Sample.ResultCode = ResultCode;
+	Sample.ResultCount = ResultCount;
+
+	// ESessionLatencyStat starts with the operation types, in the same order
+	LatencyStats.Record(static_cast<ESessionLatencyStat>(Operation.Type), Sample);
+	TRACE_BOOKMARK(TEXT("Session %s end"), LexToString(Operation.Type));
+	UE_LOG(LogMultiplayerSessions, Verbose, TEXT("%s %d %s after %.1fms (result %d, %d found)"),
+		LexToString(Operation.Type), Operation.Id, bCancelled ? TEXT("cancelled") : bSucceeded ? TEXT("succeeded") : TEXT("failed"), Sample.GetDurationMs(), ResultCode, ResultCount);
+}
+
+void UMultiplayerSessionsSubsystem::ExecuteCreateSession()
+{
+	FNamedOnlineSession* ExistingSession = OnlineSessionPtr->GetNamedSession(NAME_GameSession);
+	if (ExistingSession != nullptr)
+	{
+		if (ActiveOperation->bDestroyedExistingSession)
+		{
+			// 已经销毁过一次仍然存在，放弃创建
+			FailActiveOperation();
+			return;
+		}
+		// 先销毁旧的 session 再重新尝试创建：创建请求放回队首，销毁请求排在它前面
+		FSessionOperation CreateOperation = MoveTemp(ActiveOperation.GetValue());
+		ActiveOperation.Reset();
+		CreateOperation.bDestroyedExistingSession = true;
+
+		FSessionOperation DestroyOperation;
+		DestroyOperation.Id = NextOperationId++;
+		DestroyOperation.Type = ESessionOperationType::Destroy;
+		// Nobody asked for this destroy, so nobody hears about it
+		DestroyOperation.bCancelled = true;
+		PendingOperations.Insert(MoveTemp(CreateOperation), 0);
+		PendingOperations.Insert(MoveTemp(DestroyOperation), 0);
+		return;
+	}
+
+	LastSessionSettings = MakeShareable(new FOnlineSessionSettings());
+	LastSessionSettings->bIsLANMatch = IsLanSubsystem(); // 使用局域网
+	LastSessionSettings->NumPublicConnections = ActiveOperation->NumPublicConnections; // 最大连接数
+	LastSessionSettings->bAllowJoinInProgress = bAllowJoinInProgress; // 是否允许中途加入
+	LastSessionSettings->bAllowJoinViaPresence = true; // 允许区域玩家加入
+	LastSessionSettings->bShouldAdvertise = true; // 是否被广播，可以让其他玩家发现并加入
+	LastSessionSettings->bUsesPresence = true; // 显示用户状态信息
+	LastSessionSettings->bUseLobbiesIfAvailable = true; // 支持 Lobbies Api，不开启可能无法找到 Session
+	LastSessionSettings->Set(FMultiplayerSessionQuery::MatchTypeKey, ActiveOperation->MatchType, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+	LastSessionSettings->BuildUniqueId = 1; // 见笔记
+	// 同时作为可查询的键广播，便于后端按 BuildId 过滤
+	LastSessionSettings->Set(FMultiplayerSessionQuery::BuildIdKey, LastSessionSettings->BuildUniqueId, EOnlineDataAdvertisementType::ViaOnlineService);
+	LastSessionSettings->Set(FMultiplayerSessionQuery::HostQualityKey, AdvertisedHostQuality, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+	if (!ActiveOperation->MapName.IsEmpty())
+	{
+		LastSessionSettings->Set(SETTING_MAPNAME, ActiveOperation->MapName, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing); // 客户端据此提前加载地图
+	}
+	// 新建的 Session 总是从大厅开始，创建时就带上了这些状态
+	AdvertisedNumPlayers = 0;
+	AdvertisedMatchPhase = EMultiplayerMatchPhase::Lobby;
+	bAdvertisedStateDirty = false;
+	WriteAdvertisedState(*LastSessionSettings);
+
+	// 专用服务器没有本地玩家，按 0 号本地用户创建
+	const FUniqueNetIdPtr HostingUserId = GetLocalUserId();
+	if (!HostingUserId.IsValid() && !IsRunningDedicatedServer())
+	{
+		UE_LOG(LogMultiplayerSessions, Warning, TEXT("Cannot create a session without a logged in local player"));
+		FailActiveOperation();
+		return;
+	}
+	DispatchActiveOperation([this, &HostingUserId]
+	{
+		return HostingUserId.IsValid()
+			? OnlineSessionPtr->CreateSession(*HostingUserId, NAME_GameSession, *LastSessionSettings)
+			: OnlineSessionPtr->CreateSession(0, NAME_GameSession, *LastSessionSettings);
+	});
+}
+
+void UMultiplayerSessionsSubsystem::ExecuteFindSessions()
+{
+	// Copied out: a backend that completes inside FindSessions also completes (and frees) the operation there
+	const int32 OperationId = ActiveOperation->Id;
+	const FMultiplayerSessionQuery Query = ActiveOperation->Query;
+	const bool bBackground = ActiveOperation->bBackground;
+
+	if (!bBackground)
+	{
+		const double Now = FPlatformTime::Seconds();
+		if (FCachedSessionSearch* Cached = SearchCache.Find(Query.ToCacheKey()))
+		{
+			// 缓存未过期（或过期但仍可用，由定时器在后台刷新）时直接返回，不再请求后端
+			if (Now - Cached->CompletedTime <= SearchCacheMaxStaleAge)
+			{
+				Cached->LastRequestTime = Now;
+				ServeCachedSearch(*Cached, Query.bStreamResults);
+				// A listener that stopped the search from the batch callback already took the operation, then this does nothing
+				CompleteFindSessions(OperationId, !LastSessionSearch->SearchResults.IsEmpty());
+				return;
+			}
+			SearchCache.Remove(Query.ToCacheKey());
+		}
+	}
+
+	const bool bStarted = StartSearch(Query);
+	// 同步完成时（例如 OnlineSessionNull 先回调失败再返回 false）队列可能已经换成了下一个操作
+	if (!ActiveOperation.IsSet() || ActiveOperation->Id != OperationId) return;
+	if (!bStarted)
+	{
+		FailActiveOperation();
+		return;
+	}
+
+	// 搜索仍在进行时轮询结果，分批广播新到达的 Session
+	if (Query.bStreamResults && !bBackground && IsFindingSessions())
+	{
+		StreamingSearchTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateUObject(this, &ThisClass::TickStreamingSearch),
+			StreamingSearchPollInterval);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::ExecuteJoinSession()
+{
+	LastJoinSessionId = ActiveOperation->JoinTarget.GetSessionIdStr();
+
+	const FUniqueNetIdPtr LocalUserId = GetLocalUserId();
+	if (!LocalUserId.IsValid())
+	{
+		UE_LOG(LogMultiplayerSessions, Warning, TEXT("Cannot join a session without a logged in local player"));
+		FailActiveOperation();
+		return;
+	}
+	// The join target is copied out: a synchronous reply completes (and frees) the operation inside the call
+	const FOnlineSessionSearchResult JoinTarget = ActiveOperation->JoinTarget;
+	DispatchActiveOperation([this, &LocalUserId, &JoinTarget] { return OnlineSessionPtr->JoinSession(*LocalUserId, NAME_GameSession, JoinTarget); });
+}
+
+void UMultiplayerSessionsSubsystem::ExecuteDestroySession()
+{
+	DispatchActiveOperation([this] { return OnlineSessionPtr->DestroySession(NAME_GameSession); });
+}
+
+void UMultiplayerSessionsSubsystem::ExecuteStartSession()
+{
+	DispatchActiveOperation([this] { return OnlineSessionPtr->StartSession(NAME_GameSession); });
+}
+
+void UMultiplayerSessionsSubsystem::ExecuteEndSession()
 {
-	if (const IOnlineSubsystem* OnlineSubsystem = Online::GetSubsystem(GetWorld()))
+	DispatchActiveOperation([this] { return OnlineSessionPtr->EndSession(NAME_GameSession); });
+}
+
+void UMultiplayerSessionsSubsystem::ExecuteUpdateSession()
+{
+	if (!LastSessionSettings.IsValid())
 	{
-		OnlineSessionPtr = OnlineSubsystem->GetSessionInterface();
+		FailActiveOperation();
+		return;
 	}
+	DispatchActiveOperation([this] { return OnlineSessionPtr->UpdateSession(NAME_GameSession, *LastSessionSettings); });
 }
 
-void UMultiplayerSessionsSubsystem::CreateSession(int32 NumPublicConnections, FString MatchType)
+bool UMultiplayerSessionsSubsystem::StartSearch(const FMultiplayerSessionQuery& Query)
 {
-	if (!OnlineSessionPtr.IsValid()) return;
+	StopStreamingSearch();
+	// A ranking, finished or not, indexes into the results we are about to drop
+	StopRanking();
+	RankedCandidates.Reset();
 
-	FNamedOnlineSession* ExistingSession = OnlineSessionPtr->GetNamedSession(NAME_GameSession);
-	if (ExistingSession != nullptr)
+	LastQuery = Query;
+	SessionFilterKeys.Reset();
+	MatchingResultIndices.Reset();
+	SessionSummaries.Reset();
+	++SessionSummariesSerial;
+	LastSessionSearch = MakeShareable(new FOnlineSessionSearch()); // 创建 SessionSearch 对象
+	LastSessionSearch->bIsLanQuery = IsLanSubsystem(); // 关闭局域网查询
+	Query.ApplyTo(*LastSessionSearch); // 最大搜索结果条数、MatchType 等过滤条件交给后端
+
+	// 获取本地玩家的网络 ID；还没有本地玩家或尚未登录时搜索直接失败
+	const FUniqueNetIdPtr LocalUserId = GetLocalUserId();
+	if (!LocalUserId.IsValid())
+	{
+		UE_LOG(LogMultiplayerSessions, Warning, TEXT("Cannot search for sessions without a logged in local player"));
+		return false;
+	}
+	// 通过 网络ID、SessionSearch 搜索参数 来查找 Session
+	// 找到 Session 后执行 OnFindSessionsCompleteDelegate 绑定的函数 OnFindSessionsComplete
+	return OnlineSessionPtr->FindSessions(*LocalUserId, LastSessionSearch.ToSharedRef());
+}
+
+FUniqueNetIdPtr UMultiplayerSessionsSubsystem::GetLocalUserId() const
+{
+	const UWorld* World = GetWorld();
+	const ULocalPlayer* LocalPlayer = World ? World->GetFirstLocalPlayerFromController() : nullptr;
+	const FUniqueNetIdRepl NetId = LocalPlayer ? LocalPlayer->GetPreferredUniqueNetId() : FUniqueNetIdRepl();
+	if (NetId.IsValid()) return NetId.GetUniqueNetId();
+
+	// 假后端不校验身份，没有本地玩家（如基准测试命令行）时用一个固定的假 ID
+	static const FUniqueNetIdRef FakeLocalUserId = FUniqueNetIdString::Create(TEXT("FakeLocalUser"), TEXT("FAKE"));
+	return bUseFakeBackend ? FUniqueNetIdPtr(FakeLocalUserId) : nullptr;
+}
+
+void UMultiplayerSessionsSubsystem::CancelSearch()
+{
+	StopStreamingSearch();
+	StopResultProcessing();
+	if (!IsFindingSessions()) return;
+
+	if (OnlineSessionPtr.IsValid())
+	{
+		OnlineSessionPtr->CancelFindSessions();
+	}
+}
+
+void UMultiplayerSessionsSubsystem::StopFindSessions()
+{
+	if (ActiveOperation.IsSet() && ActiveOperation->Type == ESessionOperationType::Find && !ActiveOperation->bBackground)
+	{
+		CancelOperation(ActiveOperation->Id);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::ServeCachedSearch(const FCachedSessionSearch& Cached, bool bStreamResults)
+{
+	// 与 StartSearch 相同：旧的排序结果指向即将被替换的搜索
+	StopRanking();
+	RankedCandidates.Reset();
+
+	LastQuery = Cached.Query;
+	LastSessionSearch = Cached.Search;
+	SessionFilterKeys = Cached.FilterKeys;
+	MatchingResultIndices = Cached.MatchingResultIndices;
+	SyncSessionSummaries(0);
+	++SessionSummariesSerial;
+
+	if (bStreamResults && !MatchingResultIndices.IsEmpty())
+	{
+		MultiplayerOnFindSessionsBatchDelegate.Broadcast(LastSessionSearch->SearchResults, MatchingResultIndices);
+		MultiplayerOnFindSessionSummariesBatchDelegate.Broadcast(SessionSummaries);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::StoreSearchInCache()
+{
+	const double Now = FPlatformTime::Seconds();
+	FCachedSessionSearch& Cached = SearchCache.FindOrAdd(LastQuery.ToCacheKey());
+	Cached.Query = LastQuery;
+	Cached.Search = LastSessionSearch;
+	Cached.FilterKeys = SessionFilterKeys;
+	Cached.MatchingResultIndices = MatchingResultIndices;
+	Cached.CompletedTime = Now;
+	if (Cached.LastRequestTime == 0.0)
+	{
+		Cached.LastRequestTime = Now;
+	}
+
+	UGameInstance* GameInstance = GetGameInstance();
+	if (GameInstance && !GameInstance->GetTimerManager().IsTimerActive(SearchCacheRefreshTimerHandle))
+	{
+		GameInstance->GetTimerManager().SetTimer(SearchCacheRefreshTimerHandle, this, &ThisClass::RefreshSearchCache, SearchCacheRefreshInterval, true);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::RefreshSearchCache()
+{
+	const double Now = FPlatformTime::Seconds();
+	FCachedSessionSearch* MostRecentStale = nullptr;
+	for (auto It = SearchCache.CreateIterator(); It; ++It)
+	{
+		FCachedSessionSearch& Cached = It.Value();
+		if (Now - Cached.CompletedTime > SearchCacheMaxStaleAge)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		// Stale but still served: revalidate the one that was asked for most recently
+		if (Now - Cached.CompletedTime > SearchCacheTTL)
+		{
+			if (MostRecentStale == nullptr || Cached.LastRequestTime > MostRecentStale->LastRequestTime)
+			{
+				MostRecentStale = &Cached;
+			}
+		}
+	}
+
+	if (SearchCache.IsEmpty())
 	{
-		bCreateSessionOnDestroy = true;
-		LastNumPublicConnections = NumPublicConnections;
-		LastMatchType = MatchType;
-		DestroySession();
+		if (UGameInstance* GameInstance = GetGameInstance())
+		{
+			GameInstance->GetTimerManager().ClearTimer(SearchCacheRefreshTimerHandle);
+		}
 		return;
 	}
 
-	// Store the delegate in a FDelegateHandle so we can later remove it from the delegate list
-	OnCreateSessionCompleteDelegateHandle = OnlineSessionPtr->AddOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegate);
-	LastSessionSettings = MakeShareable(new FOnlineSessionSettings());
-	LastSessionSettings->bIsLANMatch = Online::GetSubsystem(GetWorld())->GetSubsystemName() == "NULL"; // 使用局域网
-	LastSessionSettings->NumPublicConnections = NumPublicConnections; // 最大连接数
-	LastSessionSettings->bAllowJoinInProgress = true; // 是否允许中途加入
-	LastSessionSettings->bAllowJoinViaPresence = true; // 允许区域玩家加入
-	LastSessionSettings->bShouldAdvertise = true; // 是否被广播，可以让其他玩家发现并加入
-	LastSessionSettings->bUsesPresence = true; // 显示用户状态信息
-	LastSessionSettings->bUseLobbiesIfAvailable = true; // 支持 Lobbies Api，不开启可能无法找到 Session
-	LastSessionSettings->Set(FName("MatchType"), MatchType, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
-	LastSessionSettings->BuildUniqueId = 1; // 见笔记
-	
-	const ULocalPlayer* LocalPlayer = GetWorld()->GetFirstLocalPlayerFromController();
-	if (!OnlineSessionPtr->CreateSession(*LocalPlayer->GetPreferredUniqueNetId(), NAME_GameSession, *LastSessionSettings))
+	// Only revalidate while the queue is idle and nothing is ranking or joining the last search's results,
+	// a caller's operation always has priority
+	const bool bUsingLastSearch = RankingTickerHandle.IsValid() || NumPendingProbes > 0 || JoinBestWhenRankedId != INDEX_NONE || JoinRetry.IsSet();
+	if (MostRecentStale && !IsBusy() && !bUsingLastSearch)
+	{
+		FSessionOperation Operation;
+		Operation.Type = ESessionOperationType::Find;
+		Operation.bBackground = true;
+		Operation.Query = FMultiplayerSessionQuery(MostRecentStale->Query).Streamed(false);
+		Operation.CoalesceKey = Operation.Query.ToCacheKey() + TEXT("|Background");
+		EnqueueOperation(MoveTemp(Operation));
+	}
+}
+
+void UMultiplayerSessionsSubsystem::InvalidateCachedSession(const FString& SessionId)
+{
+	// 结果本身留在搜索对象里（删掉会让所有下标错位），只从匹配列表中去掉，之后不会再被返回或加入
+	for (TPair<FString, FCachedSessionSearch>& Pair : SearchCache)
+	{
+		FCachedSessionSearch& Cached = Pair.Value;
+		const TArray<FOnlineSessionSearchResult>& SearchResults = Cached.Search->SearchResults;
+		Cached.MatchingResultIndices.RemoveAll([&SearchResults, &SessionId](int32 Index)
+		{
+			return SearchResults[Index].GetSessionIdStr() == SessionId;
+		});
+	}
+
+	// The last search may be one of the cached ones, or the live one they were copied from
+	if (!LastSessionSearch.IsValid()) return;
+	const TArray<FOnlineSessionSearchResult>& SearchResults = LastSessionSearch->SearchResults;
+	auto IsInvalidated = [&SearchResults, &SessionId](int32 Index)
+	{
+		return SearchResults.IsValidIndex(Index) && SearchResults[Index].GetSessionIdStr() == SessionId;
+	};
+	if (MatchingResultIndices.RemoveAll(IsInvalidated) > 0)
 	{
-		OnlineSessionPtr->ClearOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegateHandle);
+		SyncSessionSummaries(0);
+		++SessionSummariesSerial;
+	}
+	RankedCandidates.RemoveAll([&IsInvalidated](const FRankedSessionCandidate& Candidate) { return IsInvalidated(Candidate.ResultIndex); });
+}
+
+bool UMultiplayerSessionsSubsystem::TickStreamingSearch(float DeltaTime)
+{
+	if (!LastSessionSearch.IsValid())
+	{
+		StreamingSearchTickerHandle.Reset();
+		return false;
+	}
+	ProcessNewSearchResults(true, ResultProcessingBudgetMs / 1000.0);
+	// Keep polling until the search finishes; OnFindSessionsComplete flushes the last batch
+	return IsFindingSessions();
+}
+
+bool UMultiplayerSessionsSubsystem::ProcessNewSearchResults(bool bBroadcastBatch, double BudgetSeconds)
+{
+	const TArray<FOnlineSessionSearchResult>& SearchResults = LastSessionSearch->SearchResults;
+	const int32 FirstNewResult = SessionFilterKeys.Num();
+	if (SearchResults.Num() <= FirstNewResult) return true;
+
+	const double Deadline = BudgetSeconds > 0.0 ? FPlatformTime::Seconds() + BudgetSeconds : 0.0;
+	const int32 FirstNewMatch = MatchingResultIndices.Num();
+	SessionFilterKeys.Reserve(SearchResults.Num());
+	int32 Index = FirstNewResult;
+	for (; Index < SearchResults.Num(); ++Index)
+	{
+		// 每处理一段才读一次时钟，超出预算的最多是一段的开销
+		if (Deadline > 0.0 && Index > FirstNewResult && (Index - FirstNewResult) % ResultsPerBudgetCheck == 0 && FPlatformTime::Seconds() >= Deadline)
+		{
+			break;
+		}
+		const FSessionFilterKey& Key = SessionFilterKeys.Add_GetRef(FSessionFilterKey::Extract(SearchResults[Index]));
+		if (LastQuery.Matches(Key))
+		{
+			MatchingResultIndices.Add(Index);
+		}
+	}
+	SyncSessionSummaries(FirstNewMatch);
+
+	if (bBroadcastBatch && MatchingResultIndices.Num() > FirstNewMatch)
+	{
+		MultiplayerOnFindSessionsBatchDelegate.Broadcast(
+			SearchResults,
+			TArrayView<const int32>(MatchingResultIndices.GetData() + FirstNewMatch, MatchingResultIndices.Num() - FirstNewMatch));
+		MultiplayerOnFindSessionSummariesBatchDelegate.Broadcast(
+			TArrayView<const FSessionSummary>(SessionSummaries.GetData() + FirstNewMatch, SessionSummaries.Num() - FirstNewMatch));
+	}
+	return Index == SearchResults.Num();
+}
+
+void UMultiplayerSessionsSubsystem::SyncSessionSummaries(int32 FirstMatch)
+{
+	// 摘要只由过滤键和匹配下标生成，不单独维护；SetNum 不释放内存，分配在多次搜索之间复用
+	SessionSummaries.SetNum(FMath::Min(FirstMatch, SessionSummaries.Num()), EAllowShrinking::No);
+	SessionSummaries.Reserve(MatchingResultIndices.Num());
+	for (int32 Match = SessionSummaries.Num(); Match < MatchingResultIndices.Num(); ++Match)
+	{
+		const int32 ResultIndex = MatchingResultIndices[Match];
+		SessionSummaries.Add(FSessionSummary::Make(SessionFilterKeys[ResultIndex], ResultIndex));
+	}
+}
+
+void UMultiplayerSessionsSubsystem::BeginResultProcessing(int32 OperationId, bool bWasSuccessful)
+{
+	StopStreamingSearch();
+	// The first slice runs right away, the ticker only picks up what didn't fit into this frame
+	if (TickResultProcessing(0.f, OperationId, bWasSuccessful))
+	{
+		ResultProcessingTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateUObject(this, &ThisClass::TickResultProcessing, OperationId, bWasSuccessful));
+	}
+}
+
+bool UMultiplayerSessionsSubsystem::TickResultProcessing(float DeltaTime, int32 OperationId, bool bWasSuccessful)
+{
+	if (!ActiveOperation.IsSet() || ActiveOperation->Id != OperationId)
+	{
+		ResultProcessingTickerHandle.Reset();
+		return false;
+	}
+
+	const bool bBroadcastBatch = ActiveOperation->Query.bStreamResults && !ActiveOperation->bBackground;
+	if (LastSessionSearch.IsValid() && !ProcessNewSearchResults(bBroadcastBatch, ResultProcessingBudgetMs / 1000.0))
+	{
+		return true;
+	}
+	ResultProcessingTickerHandle.Reset();
+	CompleteFindSessions(OperationId, bWasSuccessful);
+	return false;
+}
+
+void UMultiplayerSessionsSubsystem::StopResultProcessing()
+{
+	if (ResultProcessingTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(ResultProcessingTickerHandle);
+		ResultProcessingTickerHandle.Reset();
+	}
+}
 
-		// Broadcast our own custom delegate
-		MultiplayerOnCreateSessionCompleteDelegate.Broadcast(false);
+void UMultiplayerSessionsSubsystem::StopStreamingSearch()
+{
+	if (StreamingSearchTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(StreamingSearchTickerHandle);
+		StreamingSearchTickerHandle.Reset();
 	}
 }
 
-void UMultiplayerSessionsSubsystem::FindSessions(int32 MaxSearchResults)
+void UMultiplayerSessionsSubsystem::RankSessionCandidates()
+{
+	StartRanking(INDEX_NONE);
+}
+
+void UMultiplayerSessionsSubsystem::StartRanking(int32 JoinBestRequestId)
 {
-	if (!OnlineSessionPtr.IsValid()) {
+	StopRanking();
+	JoinBestWhenRankedId = JoinBestRequestId;
+	RankedCandidates.Reset(MatchingResultIndices.Num());
+	if (!LastSessionSearch.IsValid())
+	{
+		FinishRanking();
 		return;
 	}
 
-	// 将委托添加到 FindSessionsCompleteDelegate_Handle 委托列表
-	// 找到 Session 后执行 FindSessionCompleteDelege 绑定的函数 OnFindSessionsComplete
-	OnFindSessionsCompleteDelegateHandle = OnlineSessionPtr->AddOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegate);
+	// 打分按帧预算分摊，排序和探测在全部打分之后进行
+	if (TickRankSessionCandidates(0.f, RankingId))
+	{
+		RankingTickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateUObject(this, &ThisClass::TickRankSessionCandidates, RankingId));
+	}
+}
 
-	LastSessionSearch = MakeShareable(new FOnlineSessionSearch()); // 创建 SessionSearch 对象
-	LastSessionSearch->MaxSearchResults = MaxSearchResults; // 最大搜索结果条数
-	LastSessionSearch->bIsLanQuery = Online::GetSubsystem(GetWorld())->GetSubsystemName() == "NULL"; // 关闭局域网查询
-	LastSessionSearch->QuerySettings.Set(SEARCH_LOBBIES, false, EOnlineComparisonOp::Equals); // 只查询 presence 值为 false 的
-	
-	// 获取玩家控制器，以供后面获取网络 ID
-	const ULocalPlayer* LocalPlayer = GetWorld()->GetFirstLocalPlayerFromController();
-	// 通过 网络ID、SessionSearch 搜索参数 来查找 Session
-	if (!OnlineSessionPtr->FindSessions(*LocalPlayer->GetPreferredUniqueNetId(), LastSessionSearch.ToSharedRef()))
+void UMultiplayerSessionsSubsystem::StopRanking()
+{
+	++RankingId;
+	NumPendingProbes = 0;
+	if (RankingTickerHandle.IsValid())
 	{
-		OnlineSessionPtr->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
-		MultiplayerOnFindSessionsCompleteDelegate.Broadcast(TArray<FOnlineSessionSearchResult>(), false);
+		FTSTicker::GetCoreTicker().RemoveTicker(RankingTickerHandle);
+		RankingTickerHandle.Reset();
 	}
+	DropJoinBestWhenRanked();
 }
 
-void UMultiplayerSessionsSubsystem::JoinSession(const FOnlineSessionSearchResult& SessionResult)
+void UMultiplayerSessionsSubsystem::DropJoinBestWhenRanked()
 {
-	if (!OnlineSessionPtr.IsValid())
+	if (JoinBestWhenRankedId == INDEX_NONE) return;
+
+	// 排序被新的搜索或排序打断，候选列表已经不存在了
+	const int32 RequestId = JoinBestWhenRankedId;
+	JoinBestWhenRankedId = INDEX_NONE;
+	BroadcastJoinBestFailure(RequestId, EOnJoinSessionCompleteResult::UnknownError);
+}
+
+void UMultiplayerSessionsSubsystem::BroadcastJoinBestFailure(int32 RequestId, EOnJoinSessionCompleteResult::Type Result)
+{
+	TGuardValue<int32> BroadcastingGuard(BroadcastingOperationId, RequestId);
+	MultiplayerOnJoinSessionCompleteDelegate.Broadcast(Result);
+}
+
+bool UMultiplayerSessionsSubsystem::TickRankSessionCandidates(float DeltaTime, int32 InRankingId)
+{
+	if (InRankingId != RankingId) return false;
+
+	const FSessionRankingWeights Weights{RankingPingWeight, RankingOpenSlotsWeight, RankingHostQualityWeight};
+	const double Deadline = ResultProcessingBudgetMs > 0.f ? FPlatformTime::Seconds() + ResultProcessingBudgetMs / 1000.0 : 0.0;
+	const int32 FirstUnscored = RankedCandidates.Num();
+	for (int32 Match = FirstUnscored; Match < MatchingResultIndices.Num(); ++Match)
+	{
+		if (Deadline > 0.0 && Match > FirstUnscored && (Match - FirstUnscored) % ResultsPerBudgetCheck == 0 && FPlatformTime::Seconds() >= Deadline)
+		{
+			return true;
+		}
+		const int32 ResultIndex = MatchingResultIndices[Match];
+		const FSessionFilterKey& Key = SessionFilterKeys[ResultIndex];
+		FRankedSessionCandidate& Candidate = RankedCandidates.AddDefaulted_GetRef();
+		Candidate.ResultIndex = ResultIndex;
+		Candidate.PingInMs = Key.PingInMs;
+		Candidate.Score = FRankedSessionCandidate::ComputeScore(Key, Key.PingInMs, Weights);
+	}
+	RankingTickerHandle.Reset();
+	SortAndProbeCandidates();
+	return false;
+}
+
+void UMultiplayerSessionsSubsystem::SortAndProbeCandidates()
+{
+	RankedCandidates.Sort([](const FRankedSessionCandidate& A, const FRankedSessionCandidate& B) { return A.Score > B.Score; });
+
+	// 在加入之前为排名靠前的候选解析连接地址，并预加载最佳候选的地图
+	if (OnlineSessionPtr.IsValid())
+	{
+		const int32 NumToPreResolve = FMath::Min(NumCandidatesToPreResolve, RankedCandidates.Num());
+		for (int32 Rank = 0; Rank < NumToPreResolve; ++Rank)
+		{
+			FRankedSessionCandidate& Candidate = RankedCandidates[Rank];
+			OnlineSessionPtr->GetResolvedConnectString(LastSessionSearch->SearchResults[Candidate.ResultIndex], NAME_GamePort, Candidate.ConnectString);
+		}
+	}
+	if (!RankedCandidates.IsEmpty())
+	{
+		PreloadCandidateMap(LastSessionSearch->SearchResults[RankedCandidates[0].ResultIndex]);
+	}
+
+	// 局域网下主动探测前 N 个候选的延迟，广播的 PingInMs 不一定可靠
+	const int32 NumToProbe = LastSessionSearch->bIsLanQuery && LatencyProbe.IsValid() && OnlineSessionPtr.IsValid()
+		? FMath::Min(NumCandidatesToProbe, RankedCandidates.Num())
+		: 0;
+	if (NumToProbe <= 0)
 	{
-		MultiplayerOnJoinSessionCompleteDelegate.Broadcast(EOnJoinSessionCompleteResult::UnknownError);
+		FinishRanking();
 		return;
 	}
 
-	OnJoinSessionCompleteDelegateHandle = OnlineSessionPtr->AddOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegate);
+	// Set up front so probes that answer synchronously can't finish the ranking early
+	NumPendingProbes = NumToProbe;
+	const int32 ThisRankingId = RankingId;
+	for (int32 Rank = 0; Rank < NumToProbe; ++Rank)
+	{
+		const int32 ResultIndex = RankedCandidates[Rank].ResultIndex;
+		const FOnlineSessionSearchResult& SearchResult = LastSessionSearch->SearchResults[ResultIndex];
+		FString HostAddress = RankedCandidates[Rank].ConnectString;
+		if (HostAddress.IsEmpty())
+		{
+			OnlineSessionPtr->GetResolvedConnectString(SearchResult, NAME_GamePort, HostAddress);
+		}
+		LatencyProbe->Probe(SearchResult, HostAddress, LatencyProbeTimeout,
+			FOnSessionLatencyProbed::CreateUObject(this, &ThisClass::OnCandidateProbed, ThisRankingId, ResultIndex));
+	}
+}
+
+void UMultiplayerSessionsSubsystem::OnCandidateProbed(int32 PingInMs, int32 InRankingId, int32 ResultIndex)
+{
+	if (InRankingId != RankingId) return;
+
+	// A host that doesn't answer the probe keeps its advertised ping, firewalls often drop ICMP
+	if (PingInMs != INDEX_NONE)
+	{
+		const FSessionRankingWeights Weights{RankingPingWeight, RankingOpenSlotsWeight, RankingHostQualityWeight};
+		if (FRankedSessionCandidate* Candidate = RankedCandidates.FindByPredicate([ResultIndex](const FRankedSessionCandidate& C) { return C.ResultIndex == ResultIndex; }))
+		{
+			Candidate->PingInMs = PingInMs;
+			Candidate->Score = FRankedSessionCandidate::ComputeScore(SessionFilterKeys[ResultIndex], PingInMs, Weights);
+		}
+	}
+	if (--NumPendingProbes == 0)
+	{
+		RankedCandidates.Sort([](const FRankedSessionCandidate& A, const FRankedSessionCandidate& B) { return A.Score > B.Score; });
+		// The probes may have moved a different host to the top
+		PreloadCandidateMap(LastSessionSearch->SearchResults[RankedCandidates[0].ResultIndex]);
+		FinishRanking();
+	}
+}
+
+void UMultiplayerSessionsSubsystem::FinishRanking()
+{
+	MultiplayerOnSessionCandidatesRankedDelegate.Broadcast(RankedCandidates);
 
-	const ULocalPlayer* LocalPlayer = GetWorld()->GetFirstLocalPlayerFromController();
-	if (!OnlineSessionPtr->JoinSession(*LocalPlayer->GetPreferredUniqueNetId(), NAME_GameSession, SessionResult))
+	if (JoinBestWhenRankedId != INDEX_NONE)
 	{
-		OnlineSessionPtr->ClearOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegateHandle);
-		MultiplayerOnJoinSessionCompleteDelegate.Broadcast(EOnJoinSessionCompleteResult::UnknownError);
+		const int32 RequestId = JoinBestWhenRankedId;
+		JoinBestWhenRankedId = INDEX_NONE;
+		if (!StartJoinRetry(RequestId))
+		{
+			BroadcastJoinBestFailure(RequestId, EOnJoinSessionCompleteResult::SessionDoesNotExist);
+		}
 	}
 }
 
-void UMultiplayerSessionsSubsystem::DestroySession()
+bool UMultiplayerSessionsSubsystem::JoinRankedCandidate(int32 Rank)
 {
-	if (!OnlineSessionPtr.IsValid())
+	if (!LastSessionSearch.IsValid() || !RankedCandidates.IsValidIndex(Rank)) return false;
+
+	const FRankedSessionCandidate& Candidate = RankedCandidates[Rank];
+	if (!LastSessionSearch->SearchResults.IsValidIndex(Candidate.ResultIndex)) return false;
+	EnqueueCandidateJoin(LastSessionSearch->SearchResults[Candidate.ResultIndex], Candidate, Rank, false);
+	return true;
+}
+
+int32 UMultiplayerSessionsSubsystem::EnqueueCandidateJoin(const FOnlineSessionSearchResult& SearchResult, const FRankedSessionCandidate& Candidate, int32 Rank, bool bJoinRetry)
+{
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::Join;
+	Operation.JoinTarget = SearchResult;
+	Operation.CoalesceKey = Operation.JoinTarget.GetSessionIdStr();
+	Operation.bTravelOnJoin = true;
+	Operation.ConnectString = Candidate.ConnectString;
+	Operation.bJoinRetry = bJoinRetry;
+	Operation.CandidateRank = Rank;
+	return EnqueueOperation(MoveTemp(Operation));
+}
+
+bool UMultiplayerSessionsSubsystem::JoinBestCandidate()
+{
+	return StartJoinRetry(INDEX_NONE);
+}
+
+bool UMultiplayerSessionsSubsystem::StartJoinRetry(int32 RequestId)
+{
+	StopJoinAttempts();
+	if (!LastSessionSearch.IsValid() || RankedCandidates.IsEmpty()) return false;
+
+	FJoinRetryState& State = JoinRetry.Emplace();
+	State.RequestId = RequestId;
+	State.Search = LastSessionSearch;
+	State.Candidates = RankedCandidates;
+	State.GoneCandidates.Init(false, RankedCandidates.Num());
+	State.StartTime = FPlatformTime::Seconds();
+	TryNextJoinCandidate();
+	return true;
+}
+
+int32 UMultiplayerSessionsSubsystem::FindAndJoinSession(const FMultiplayerSessionQuery& Query)
+{
+	StopJoinAttempts();
+	DropJoinBestWhenRanked();
+
+	// 缓存命中时搜索会在入队时同步完成，所以标记要随操作一起入队
+	const int32 OperationId = EnqueueFindSessions(Query, true);
+
+	// 与已有的相同搜索合并时，让那个搜索来负责加入
+	if (ActiveOperation.IsSet() && ActiveOperation->Id == OperationId)
+	{
+		ActiveOperation->bJoinBest = true;
+	}
+	else if (FSessionOperation* Queued = PendingOperations.FindByPredicate([OperationId](const FSessionOperation& Operation) { return Operation.Id == OperationId; }))
+	{
+		Queued->bJoinBest = true;
+	}
+	return OperationId;
+}
+
+void UMultiplayerSessionsSubsystem::StopJoinAttempts()
+{
+	if (!JoinRetry.IsSet()) return;
+
+	const int32 OperationId = JoinRetry->OperationId;
+	JoinRetry.Reset();
+	if (UGameInstance* GameInstance = GetGameInstance())
+	{
+		GameInstance->GetTimerManager().ClearTimer(JoinRetryTimerHandle);
+	}
+	if (OperationId != INDEX_NONE)
+	{
+		CancelOperation(OperationId);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::TryNextJoinCandidate()
+{
+	if (!JoinRetry.IsSet()) return;
+
+	FJoinRetryState& State = JoinRetry.GetValue();
+	while (State.NextRank < State.Candidates.Num() && State.GoneCandidates[State.NextRank])
+	{
+		++State.NextRank;
+	}
+	if (State.NextRank >= State.Candidates.Num())
+	{
+		ScheduleJoinRetryRound();
+		return;
+	}
+
+	// 上一次失败可能在本地留下了 Session（例如地址解析失败），先静默销毁，否则会得到 AlreadyInSession
+	if (OnlineSessionPtr.IsValid() && OnlineSessionPtr->GetNamedSession(NAME_GameSession) != nullptr)
+	{
+		FSessionOperation DestroyOperation;
+		DestroyOperation.Type = ESessionOperationType::Destroy;
+		DestroyOperation.bCancelled = true;
+		EnqueueOperation(MoveTemp(DestroyOperation));
+	}
+
+	const int32 Rank = State.NextRank++;
+	const FRankedSessionCandidate& Candidate = State.Candidates[Rank];
+	if (!State.Search->SearchResults.IsValidIndex(Candidate.ResultIndex))
 	{
-		MultiplayerOnDestroySessionCompleteDelegate.Broadcast(false);
+		State.GoneCandidates[Rank] = true;
+		TryNextJoinCandidate();
 		return;
 	}
+	State.AttemptStartTime = FPlatformTime::Seconds();
+	State.OperationId = INDEX_NONE;
+	// 同步失败时会在这里面重入下一次尝试，只有仍在等待的加入才记录 id
+	const int32 OperationId = EnqueueCandidateJoin(State.Search->SearchResults[Candidate.ResultIndex], Candidate, Rank, true);
+	if (JoinRetry.IsSet() && IsOperationQueued(OperationId))
+	{
+		JoinRetry->OperationId = OperationId;
+	}
+}
+
+void UMultiplayerSessionsSubsystem::HandleJoinRetryResult(const FSessionOperation& Operation, EOnJoinSessionCompleteResult::Type Result)
+{
+	FJoinRetryState& State = JoinRetry.GetValue();
+	State.OperationId = INDEX_NONE;
+	State.LastResult = Result;
+
+	const double Now = FPlatformTime::Seconds();
+	FSessionJoinAttempt Attempt;
+	Attempt.SessionId = Operation.JoinTarget.GetSessionIdStr();
+	Attempt.Rank = Operation.CandidateRank;
+	Attempt.Round = State.Round;
+	Attempt.Result = Result;
+	Attempt.DurationMs = (Now - State.AttemptStartTime) * 1000.0;
+	Attempt.TotalMs = (Now - State.StartTime) * 1000.0;
+	UE_LOG(LogMultiplayerSessions, Log, TEXT("Join attempt round %d rank %d (%s): %s after %.1fms, %.1fms in total"),
+		Attempt.Round, Attempt.Rank, *Attempt.SessionId, LexToString(Result), Attempt.DurationMs, Attempt.TotalMs);
+	MultiplayerOnJoinAttemptDelegate.Broadcast(Attempt);
+	// 监听者可能在回调里停止了重试
+	if (!JoinRetry.IsSet()) return;
+
+	switch (Result)
+	{
+	case EOnJoinSessionCompleteResult::SessionDoesNotExist:
+		if (State.GoneCandidates.IsValidIndex(Operation.CandidateRank))
+		{
+			State.GoneCandidates[Operation.CandidateRank] = true;
+		}
+		[[fallthrough]];
+	case EOnJoinSessionCompleteResult::SessionIsFull:
+	case EOnJoinSessionCompleteResult::CouldNotRetrieveAddress:
+		TryNextJoinCandidate();
+		break;
+	default:
+		// 成功，或者换一个候选也不会好转的错误
+		FinishJoinRetry(Result);
+		break;
+	}
+}
 
-	OnDestroySessionCompleteDelegateHandle = OnlineSessionPtr->AddOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegate);
-	if (!OnlineSessionPtr->DestroySession(NAME_GameSession))
+void UMultiplayerSessionsSubsystem::ScheduleJoinRetryRound()
+{
+	FJoinRetryState& State = JoinRetry.GetValue();
+	UGameInstance* GameInstance = GetGameInstance();
+	const bool bAnyLeft = State.GoneCandidates.Find(false) != INDEX_NONE;
+	if (State.Round + 1 >= MaxJoinRounds || !bAnyLeft || GameInstance == nullptr)
 	{
-		OnlineSessionPtr->ClearOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegateHandle);
-		MultiplayerOnDestroySessionCompleteDelegate.Broadcast(false);
+		FinishJoinRetry(State.LastResult);
+		return;
 	}
+
+	++State.Round;
+	State.NextRank = 0;
+	const float Backoff = FMath::Min(JoinRetryBackoffMax, JoinRetryBackoffBase * FMath::Pow(2.f, State.Round - 1));
+	const float Delay = Backoff * FMath::FRandRange(0.5f, 1.f);
+	UE_LOG(LogMultiplayerSessions, Log, TEXT("Every join candidate failed, walking them again in %.2fs"), Delay);
+	GameInstance->GetTimerManager().SetTimer(JoinRetryTimerHandle, this, &ThisClass::TryNextJoinCandidate, FMath::Max(Delay, KINDA_SMALL_NUMBER), false);
+}
+
+void UMultiplayerSessionsSubsystem::FinishJoinRetry(EOnJoinSessionCompleteResult::Type Result)
+{
+	const int32 RequestId = JoinRetry->RequestId;
+	JoinRetry.Reset();
+	TGuardValue<int32> BroadcastingGuard(BroadcastingOperationId, RequestId);
+	MultiplayerOnJoinSessionCompleteDelegate.Broadcast(Result);
+}
+
+const FOnlineSessionSearchResult* UMultiplayerSessionsSubsystem::GetSearchResult(int32 ResultIndex) const
+{
+	return LastSessionSearch.IsValid() && LastSessionSearch->SearchResults.IsValidIndex(ResultIndex)
+		? &LastSessionSearch->SearchResults[ResultIndex]
+		: nullptr;
 }
 
-void UMultiplayerSessionsSubsystem::StartSession()
+int32 UMultiplayerSessionsSubsystem::JoinSearchResult(const FString& SessionId)
 {
+	if (!LastSessionSearch.IsValid()) return INDEX_NONE;
+
+	// 按 Session id 查找，后台刷新可能已经替换了搜索结果
+	const int32 ResultIndex = LastSessionSearch->SearchResults.IndexOfByPredicate(
+		[&SessionId](const FOnlineSessionSearchResult& Result) { return Result.GetSessionIdStr() == SessionId; });
+	// 已被判定为满员或不存在的结果不再加入
+	if (ResultIndex == INDEX_NONE || !MatchingResultIndices.Contains(ResultIndex)) return INDEX_NONE;
+	const FOnlineSessionSearchResult* SearchResult = &LastSessionSearch->SearchResults[ResultIndex];
+
+	FSessionOperation Operation;
+	Operation.Type = ESessionOperationType::Join;
+	Operation.JoinTarget = *SearchResult;
+	Operation.CoalesceKey = SessionId;
+	Operation.bTravelOnJoin = true;
+	return EnqueueOperation(MoveTemp(Operation));
 }
 
 void UMultiplayerSessionsSubsystem::GetResolvedConnectString(const FName& SessionName, FString& Address)
@@ -130,53 +1579,179 @@ void UMultiplayerSessionsSubsystem::GetResolvedConnectString(const FName& Sessio
 
 void UMultiplayerSessionsSubsystem::OnCreateSessionComplete(FName SessionName, bool bWasSuccessful)
 {
-	if (OnlineSessionPtr.IsValid())
+	const int32 OperationId = TakeAwaitedReply(ESessionOperationType::Create);
+	if (OperationId != INDEX_NONE)
+	{
+		CompleteCreateSession(OperationId, bWasSuccessful);
+	}
+}
+
+void UMultiplayerSessionsSubsystem::CompleteCreateSession(int32 OperationId, bool bWasSuccessful)
+{
+	FSessionOperation Operation;
+	if (!TakeActiveOperation(ESessionOperationType::Create, OperationId, Operation)) return;
+	RecordOperationLatency(Operation, bWasSuccessful);
+
+	if (!Operation.bCancelled)
+	{
+		TGuardValue<int32> BroadcastingGuard(BroadcastingOperationId, Operation.Id);
+		MultiplayerOnCreateSessionCompleteDelegate.Broadcast(bWasSuccessful);
+	}
+	// Changes made while the create was in flight couldn't be pushed yet
+	if (bWasSuccessful && bAdvertisedStateDirty)
+	{
+		ScheduleAdvertisedStateUpdate();
+	}
+	// INDEX_NONE: HostSession is still inside CreateSession, so this can only be its create
+	if (HostPipeline.IsSet() && (HostPipeline->CreateOperationId == INDEX_NONE || HostPipeline->CreateOperationId == Operation.Id))
 	{
-		OnlineSessionPtr->ClearOnCreateSessionCompleteDelegate_Handle(OnCreateSessionCompleteDelegateHandle);
+		HostPipeline->bSessionCreated = bWasSuccessful && !Operation.bCancelled;
+		AdvanceHostPipeline(HostPipeline->bSessionCreated ? EHostPipelineStage::SessionCreated : EHostPipelineStage::Failed);
 	}
-	MultiplayerOnCreateSessionCompleteDelegate.Broadcast(true);
+	PumpOperationQueue();
 }
 
 void UMultiplayerSessionsSubsystem::OnFindSessionsComplete(bool bWasSuccessful)
 {
-	if (OnlineSessionPtr.IsValid())
+	// The running search can't be the one that completed, this is a late reply for a cancelled one
+	if (IsFindingSessions()) return;
+
+	// 结果在后续几帧内按预算处理完之后才算完成
+	if (ActiveOperation.IsSet() && ActiveOperation->Type == ESessionOperationType::Find && !ResultProcessingTickerHandle.IsValid())
 	{
-		OnlineSessionPtr->ClearOnFindSessionsCompleteDelegate_Handle(OnFindSessionsCompleteDelegateHandle);
+		BeginResultProcessing(ActiveOperation->Id, bWasSuccessful);
 	}
-	if (LastSessionSearch->SearchResults.IsEmpty())
+}
+
+void UMultiplayerSessionsSubsystem::CompleteFindSessions(int32 OperationId, bool bWasSuccessful)
+{
+	FSessionOperation Operation;
+	if (!TakeActiveOperation(ESessionOperationType::Find, OperationId, Operation)) return;
+
+	StopStreamingSearch();
+	StopResultProcessing();
+	// Normally already caught up by the sliced processing; a failed or timed out search keeps what it got so far
+	if (LastSessionSearch.IsValid() && bWasSuccessful)
 	{
-		MultiplayerOnFindSessionsCompleteDelegate.Broadcast(TArray<FOnlineSessionSearchResult>(), false);
-	} else
+		ProcessNewSearchResults(Operation.Query.bStreamResults && !Operation.bBackground, 0.0);
+		StoreSearchInCache();
+	}
+	RecordOperationLatency(Operation, bWasSuccessful, 0, MatchingResultIndices.Num());
+
+	// Background revalidation only refreshes the cache entry, nobody is notified
+	if (!Operation.bBackground && !Operation.bCancelled)
 	{
-		MultiplayerOnFindSessionsCompleteDelegate.Broadcast(LastSessionSearch->SearchResults, bWasSuccessful);
+		TGuardValue<int32> BroadcastingGuard(BroadcastingOperationId, Operation.Id);
+		if (!LastSessionSearch.IsValid() || LastSessionSearch->SearchResults.IsEmpty())
+		{
+			MultiplayerOnFindSessionsCompleteDelegate.Broadcast(TArray<FOnlineSessionSearchResult>(), false);
+			MultiplayerOnFindSessionSummariesCompleteDelegate.Broadcast(TArrayView<const FSessionSummary>(), false);
+		} else
+		{
+			MultiplayerOnFindSessionsCompleteDelegate.Broadcast(LastSessionSearch->SearchResults, bWasSuccessful);
+			MultiplayerOnFindSessionSummariesCompleteDelegate.Broadcast(SessionSummaries, bWasSuccessful);
+		}
+
+		if (Operation.bJoinBest)
+		{
+			if (MatchingResultIndices.IsEmpty())
+			{
+				MultiplayerOnJoinSessionCompleteDelegate.Broadcast(EOnJoinSessionCompleteResult::SessionDoesNotExist);
+			}
+			else
+			{
+				// 排序完成后加入，最终结果仍以这次搜索的 id 广播
+				StartRanking(Operation.Id);
+			}
+		}
 	}
+	PumpOperationQueue();
 }
 
 void UMultiplayerSessionsSubsystem::OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result)
 {
-	if (OnlineSessionPtr.IsValid())
+	const int32 OperationId = TakeAwaitedReply(ESessionOperationType::Join);
+	if (OperationId != INDEX_NONE)
 	{
-		OnlineSessionPtr->ClearOnJoinSessionCompleteDelegate_Handle(OnJoinSessionCompleteDelegateHandle);
+		CompleteJoinSession(OperationId, Result);
 	}
-
-	MultiplayerOnJoinSessionCompleteDelegate.Broadcast(Result);
 }
 
-void UMultiplayerSessionsSubsystem::OnDestroySessionComplete(FName SessionName, bool bWasSuccessful)
+void UMultiplayerSessionsSubsystem::CompleteJoinSession(int32 OperationId, EOnJoinSessionCompleteResult::Type Result)
 {
-	if (OnlineSessionPtr.IsValid())
+	FSessionOperation Operation;
+	if (!TakeActiveOperation(ESessionOperationType::Join, OperationId, Operation)) return;
+	RecordOperationLatency(Operation, Result == EOnJoinSessionCompleteResult::Success, static_cast<int32>(Result));
+
+	// 房间已满或已不存在，不能再从缓存中返回它
+	if (Result == EOnJoinSessionCompleteResult::SessionIsFull || Result == EOnJoinSessionCompleteResult::SessionDoesNotExist)
 	{
-		OnlineSessionPtr->ClearOnDestroySessionCompleteDelegate_Handle(OnDestroySessionCompleteDelegateHandle);
+		InvalidateCachedSession(LastJoinSessionId);
 	}
-	if (bWasSuccessful && bCreateSessionOnDestroy)
+
+	if (!Operation.bCancelled)
 	{
-		bCreateSessionOnDestroy = false;
-		CreateSession(LastNumPublicConnections, LastMatchType); // 重新尝试创建session
+		// 加入成功后立即出发，不必等监听者处理完广播
+		if (Result == EOnJoinSessionCompleteResult::Success && Operation.bTravelOnJoin)
+		{
+			TravelToJoinedSession(Operation.ConnectString);
+		}
+		if (Operation.bJoinRetry && JoinRetry.IsSet())
+		{
+			HandleJoinRetryResult(Operation, Result);
+		}
+		else
+		{
+			TGuardValue<int32> BroadcastingGuard(BroadcastingOperationId, Operation.Id);
+			MultiplayerOnJoinSessionCompleteDelegate.Broadcast(Result);
+		}
 	}
-	MultiplayerOnDestroySessionCompleteDelegate.Broadcast(bWasSuccessful);
+	PumpOperationQueue();
+}
+
+void UMultiplayerSessionsSubsystem::OnDestroySessionComplete(FName SessionName, bool bWasSuccessful)
+{
+	CompleteSessionStateChange(ESessionOperationType::Destroy, TakeAwaitedReply(ESessionOperationType::Destroy), bWasSuccessful);
 }
 
 void UMultiplayerSessionsSubsystem::OnStartSessionComplete(FName SessionName, bool bWasSuccessful)
 {
+	CompleteSessionStateChange(ESessionOperationType::Start, TakeAwaitedReply(ESessionOperationType::Start), bWasSuccessful);
+}
+
+void UMultiplayerSessionsSubsystem::OnEndSessionComplete(FName SessionName, bool bWasSuccessful)
+{
+	CompleteSessionStateChange(ESessionOperationType::End, TakeAwaitedReply(ESessionOperationType::End), bWasSuccessful);
 }
 
+void UMultiplayerSessionsSubsystem::OnUpdateSessionComplete(FName SessionName, bool bWasSuccessful)
+{
+	CompleteSessionStateChange(ESessionOperationType::Update, TakeAwaitedReply(ESessionOperationType::Update), bWasSuccessful);
+}
+
+void UMultiplayerSessionsSubsystem::CompleteSessionStateChange(ESessionOperationType Type, int32 OperationId, bool bWasSuccessful)
+{
+	FSessionOperation Operation;
+	if (OperationId == INDEX_NONE || !TakeActiveOperation(Type, OperationId, Operation)) return;
+	RecordOperationLatency(Operation, bWasSuccessful);
+
+	if (!Operation.bCancelled)
+	{
+		switch (Type)
+		{
+		case ESessionOperationType::Destroy:
+			MultiplayerOnDestroySessionCompleteDelegate.Broadcast(bWasSuccessful);
+			break;
+		case ESessionOperationType::Start:
+			MultiplayerOnStartSessionCompleteDelegate.Broadcast(bWasSuccessful);
+			break;
+		case ESessionOperationType::End:
+			MultiplayerOnEndSessionCompleteDelegate.Broadcast(bWasSuccessful);
+			break;
+		default:
+			MultiplayerOnUpdateSessionCompleteDelegate.Broadcast(bWasSuccessful);
+			break;
+		}
+	}
+	PumpOperationQueue();
+}
@@ -0,0 +1,323 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ServerBrowser.h"
+
+#include "MultiplayerSessionsSubsystem.h"
+#include "OnlineSessionSettings.h"
+#include "Components/ListView.h"
+#include "Async/Async.h"
+#include "Algo/Sort.h"
+#include "Algo/UpperBound.h"
+#include "Tasks/Task.h"
+
+const FSessionBrowserRow* USessionBrowserItem::GetRow() const
+{
+	const UServerBrowser* Owner = Browser.Get();
+	return Owner ? Owner->GetRow(RowIndex) : nullptr;
+}
+
+FString USessionBrowserItem::GetOwningUserName() const
+{
+	const FSessionBrowserRow* Row = GetRow();
+	return Row ? Row->OwningUserName : FString();
+}
+
+int32 USessionBrowserItem::GetPingInMs() const
+{
+	const FSessionBrowserRow* Row = GetRow();
+	return Row ? Row->PingInMs : 0;
+}
+
+int32 USessionBrowserItem::GetNumPlayers() const
+{
+	const FSessionBrowserRow* Row = GetRow();
+	return Row ? Row->NumPublicConnections - Row->NumOpenPublicConnections : 0;
+}
+
+int32 USessionBrowserItem::GetMaxPlayers() const
+{
+	const FSessionBrowserRow* Row = GetRow();
+	return Row ? Row->NumPublicConnections : 0;
+}
+
+void UServerBrowser::NativeConstruct()
+{
+	Super::NativeConstruct();
+
+	if (UGameInstance* GameInstance = GetGameInstance())
+	{
+		MultiplayerSessionsSubsystem = GameInstance->GetSubsystem<UMultiplayerSessionsSubsystem>();
+	}
+	if (MultiplayerSessionsSubsystem)
+	{
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionSummariesBatchDelegate.AddUObject(this, &ThisClass::OnFindSessionsBatch);
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionSummariesCompleteDelegate.AddUObject(this, &ThisClass::OnFindSessions);
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionsCancelledDelegate.AddUObject(this, &ThisClass::OnFindSessionsCancelled);
+	}
+	if (SessionList)
+	{
+		SessionList->OnItemDoubleClicked().AddUObject(this, &ThisClass::OnItemDoubleClicked);
+	}
+}
+
+void UServerBrowser::NativeDestruct()
+{
+	if (MultiplayerSessionsSubsystem)
+	{
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionSummariesBatchDelegate.RemoveAll(this);
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionSummariesCompleteDelegate.RemoveAll(this);
+		MultiplayerSessionsSubsystem->MultiplayerOnFindSessionsCancelledDelegate.RemoveAll(this);
+	}
+	// 丢弃还在后台运行的排序结果
+	++ViewSerial;
+	Super::NativeDestruct();
+}
+
+void UServerBrowser::Refresh(const FMultiplayerSessionQuery& Query)
+{
+	ResetRows();
+
+	if (MultiplayerSessionsSubsystem)
+	{
+		bSearching = true;
+		FMultiplayerSessionQuery StreamedQuery = Query;
+		const int32 OperationId = MultiplayerSessionsSubsystem->FindSessions(StreamedQuery.Streamed());
+		// 命中缓存时搜索已经在调用里完成
+		SearchOperationId = bSearching ? OperationId : INDEX_NONE;
+	}
+	else
+	{
+		OnRefreshComplete.Broadcast(false);
+	}
+}
+
+void UServerBrowser::ResetRows()
+{
+	++ViewSerial;
+	bViewDirty = false;
+	RowBatches.Reset();
+	RowBatchStarts.Reset();
+	NumRows = 0;
+	NumIngestedMatches = 0;
+	VisibleItems.Reset();
+	if (SessionList)
+	{
+		SessionList->ClearListItems();
+	}
+}
+
+void UServerBrowser::SetView(const FSessionBrowserView& InView)
+{
+	View = InView;
+	RequestViewUpdate();
+}
+
+bool UServerBrowser::JoinSelected()
+{
+	const USessionBrowserItem* Item = SessionList ? Cast<USessionBrowserItem>(SessionList->GetSelectedItem()) : nullptr;
+	const FSessionBrowserRow* Row = Item ? Item->GetRow() : nullptr;
+	return Row && MultiplayerSessionsSubsystem && MultiplayerSessionsSubsystem->JoinSearchResult(Row->SessionId) != INDEX_NONE;
+}
+
+const FSessionBrowserRow* UServerBrowser::GetRow(int32 RowIndex) const
+{
+	if (RowIndex < 0 || RowIndex >= NumRows) return nullptr;
+
+	const int32 Batch = Algo::UpperBound(RowBatchStarts, RowIndex) - 1;
+	return &(*RowBatches[Batch])[RowIndex - RowBatchStarts[Batch]];
+}
+
+void UServerBrowser::OnFindSessionsBatch(TArrayView<const FSessionSummary> NewSummaries)
+{
+	if (!bSearching) return;
+
+	IngestNewResults();
+}
+
+void UServerBrowser::OnFindSessions(TArrayView<const FSessionSummary> Summaries, bool bWasSuccessful)
+{
+	if (!bSearching) return;
+
+	// 非流式搜索和缓存命中不会有批次，最后补齐剩下的结果
+	IngestNewResults();
+	bSearching = false;
+	SearchOperationId = INDEX_NONE;
+	OnRefreshComplete.Broadcast(bWasSuccessful);
+}
+
+void UServerBrowser::OnFindSessionsCancelled(int32 OperationId)
+{
+	if (!bSearching || OperationId != SearchOperationId) return;
+
+	// 其他调用者停止了这次搜索，保留已经收到的结果
+	bSearching = false;
+	SearchOperationId = INDEX_NONE;
+	OnRefreshComplete.Broadcast(false);
+}
+
+void UServerBrowser::OnItemDoubleClicked(UObject* Item)
+{
+	const USessionBrowserItem* BrowserItem = Cast<USessionBrowserItem>(Item);
+	const FSessionBrowserRow* Row = BrowserItem ? BrowserItem->GetRow() : nullptr;
+	if (Row && MultiplayerSessionsSubsystem)
+	{
+		MultiplayerSessionsSubsystem->JoinSearchResult(Row->SessionId);
+	}
+}
+
+void UServerBrowser::IngestNewResults()
+{
+	if (MultiplayerSessionsSubsystem == nullptr) return;
+
+	// 摘要被换成了另一次搜索的，或有 Session 被剔除，已导入的行不再对应，从头导入
+	if (MultiplayerSessionsSubsystem->GetSessionSummariesSerial() != IngestedSummariesSerial)
+	{
+		ResetRows();
+		IngestedSummariesSerial = MultiplayerSessionsSubsystem->GetSessionSummariesSerial();
+	}
+
+	const TArrayView<const FSessionSummary> Summaries = MultiplayerSessionsSubsystem->GetSessionSummaries();
+	if (Summaries.Num() <= NumIngestedMatches) return;
+
+	TSharedRef<FRowBatch, ESPMode::ThreadSafe> Batch = MakeShared<FRowBatch, ESPMode::ThreadSafe>();
+	Batch->Reserve(Summaries.Num() - NumIngestedMatches);
+	for (int32 Match = NumIngestedMatches; Match < Summaries.Num(); ++Match)
+	{
+		const FSessionSummary& Summary = Summaries[Match];
+		// 只有 id 和主机名需要回到原始结果里取
+		const FOnlineSessionSearchResult* Result = MultiplayerSessionsSubsystem->GetSearchResult(Summary.ResultIndex);
+		if (Result == nullptr) continue;
+
+		FSessionBrowserRow& Row = Batch->AddDefaulted_GetRef();
+		Row.SessionId = Result->GetSessionIdStr();
+		Row.OwningUserName = Result->Session.OwningUserName;
+		Row.MatchType = Summary.MatchType;
+		Row.PingInMs = Summary.PingInMs;
+		Row.NumOpenPublicConnections = Summary.NumOpenPublicConnections;
+		Row.NumPublicConnections = Summary.NumPublicConnections;
+		Row.HostQuality = Summary.HostQuality;
+	}
+	NumIngestedMatches = Summaries.Num();
+	if (Batch->IsEmpty()) return;
+
+	RowBatchStarts.Add(NumRows);
+	NumRows += Batch->Num();
+	RowBatches.Add(MoveTemp(Batch));
+	RequestViewUpdate();
+}
+
+void UServerBrowser::RequestViewUpdate()
+{
+	if (bViewTaskInFlight)
+	{
+		bViewDirty = true;
+		return;
+	}
+	bViewTaskInFlight = true;
+	bViewDirty = false;
+
+	UE::Tasks::Launch(UE_SOURCE_LOCATION,
+		[WeakThis = TWeakObjectPtr<UServerBrowser>(this), Batches = RowBatches, TaskView = View, Serial = ViewSerial]()
+		{
+			// 工作线程：只读取不可变的批次和 View 的拷贝
+			TArray<const FSessionBrowserRow*> Rows;
+			TArray<int32> RowOrder;
+			int32 RowIndex = 0;
+			for (const FRowBatchRef& Batch : Batches)
+			{
+				for (const FSessionBrowserRow& Row : *Batch)
+				{
+					const bool bPasses = (!TaskView.bHideFull || Row.NumOpenPublicConnections > 0)
+						&& (TaskView.MaxPingMs <= 0 || Row.PingInMs <= TaskView.MaxPingMs)
+						&& (TaskView.HostNameFilter.IsEmpty() || Row.OwningUserName.Contains(TaskView.HostNameFilter));
+					if (bPasses)
+					{
+						Rows.Add(&Row);
+						RowOrder.Add(RowIndex);
+					}
+					++RowIndex;
+				}
+			}
+
+			// 对下标排序，比较时通过指针读取行数据
+			TArray<int32> Order;
+			Order.Reserve(Rows.Num());
+			for (int32 Index = 0; Index < Rows.Num(); ++Index)
+			{
+				Order.Add(Index);
+			}
+			auto Compare = [&Rows, &TaskView](int32 A, int32 B)
+			{
+				const FSessionBrowserRow& RowA = *Rows[TaskView.bAscending ? A : B];
+				const FSessionBrowserRow& RowB = *Rows[TaskView.bAscending ? B : A];
+				switch (TaskView.SortColumn)
+				{
+				case ESessionBrowserSortColumn::Players:
+					return RowA.NumPublicConnections - RowA.NumOpenPublicConnections < RowB.NumPublicConnections - RowB.NumOpenPublicConnections;
+				case ESessionBrowserSortColumn::HostQuality:
+					return RowA.HostQuality < RowB.HostQuality;
+				case ESessionBrowserSortColumn::HostName:
+					return RowA.OwningUserName.Compare(RowB.OwningUserName, ESearchCase::IgnoreCase) < 0;
+				default:
+					return RowA.PingInMs < RowB.PingInMs;
+				}
+			};
+			Algo::StableSort(Order, Compare);
+			for (int32& Index : Order)
+			{
+				Index = RowOrder[Index];
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Serial, Order = MoveTemp(Order)]() mutable
+			{
+				if (UServerBrowser* Browser = WeakThis.Get())
+				{
+					Browser->ApplyViewUpdate(Serial, MoveTemp(Order));
+				}
+			});
+		});
+}
+
+void UServerBrowser::ApplyViewUpdate(int32 Serial, TArray<int32>&& RowOrder)
+{
+	bViewTaskInFlight = false;
+	// Sorted before a refresh, only worth a rerun if rows of the new search came in meanwhile
+	if (Serial != ViewSerial)
+	{
+		if (bViewDirty)
+		{
+			RequestViewUpdate();
+		}
+		return;
+	}
+
+	// 只有屏幕上的条目会生成 Widget，这里只交换 UObject 指针
+	VisibleItems.Reset(RowOrder.Num());
+	for (const int32 RowIndex : RowOrder)
+	{
+		VisibleItems.Add(GetOrCreateItem(RowIndex));
+	}
+	if (SessionList)
+	{
+		SessionList->SetListItems(VisibleItems);
+	}
+
+	// New rows or a new view arrived while this one was sorting
+	if (bViewDirty)
+	{
+		RequestViewUpdate();
+	}
+}
+
+USessionBrowserItem* UServerBrowser::GetOrCreateItem(int32 RowIndex)
+{
+	while (ItemPool.Num() <= RowIndex)
+	{
+		USessionBrowserItem* Item = NewObject<USessionBrowserItem>(this);
+		Item->Browser = this;
+		Item->RowIndex = ItemPool.Num();
+		ItemPool.Add(Item);
+	}
+	return ItemPool[RowIndex];
+}
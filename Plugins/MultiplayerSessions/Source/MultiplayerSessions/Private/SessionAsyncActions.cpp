@@ -0,0 +1,203 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SessionAsyncActions.h"
+
+#include "MultiplayerSessionsSubsystem.h"
+#include "OnlineSessionSettings.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+
+void USessionAsyncActionBase::Activate()
+{
+	const UWorld* World = GEngine ? GEngine->GetWorldFromContextObject(WorldContextObject.Get(), EGetWorldErrorMode::LogAndReturnNull) : nullptr;
+	const UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+	UMultiplayerSessionsSubsystem* SessionsSubsystem = GameInstance ? GameInstance->GetSubsystem<UMultiplayerSessionsSubsystem>() : nullptr;
+	Subsystem = SessionsSubsystem;
+
+	// 结果可能在 Start 里就同步返回（例如命中搜索缓存），那时 Finish 已经调用过了
+	bool bStarted = false;
+	if (SessionsSubsystem)
+	{
+		TGuardValue<bool> StartingGuard(bStarting, true);
+		bStarted = Start(*SessionsSubsystem);
+	}
+	if (!bStarted)
+	{
+		BroadcastFailure();
+		Finish();
+	}
+}
+
+void USessionAsyncActionBase::Finish()
+{
+	if (UMultiplayerSessionsSubsystem* SessionsSubsystem = Subsystem.Get())
+	{
+		Unbind(*SessionsSubsystem);
+	}
+	Subsystem.Reset();
+	SetReadyToDestroy();
+}
+
+bool USessionAsyncActionBase::IsOwnResult() const
+{
+	const UMultiplayerSessionsSubsystem* SessionsSubsystem = Subsystem.Get();
+	if (SessionsSubsystem == nullptr) return false;
+
+	// 同步完成时 Start 还没拿到 id；队列空闲才会同步执行，所以这时广播的只能是刚发起的操作
+	if (bStarting && OperationId == INDEX_NONE) return true;
+	return OperationId != INDEX_NONE && SessionsSubsystem->GetBroadcastingOperationId() == OperationId;
+}
+
+UCreateSessionAsyncAction* UCreateSessionAsyncAction::HostSession(UObject* WorldContextObject, int32 NumPublicConnections, FString MatchType, FString TravelURL)
+{
+	UCreateSessionAsyncAction* Action = NewObject<UCreateSessionAsyncAction>();
+	Action->WorldContextObject = WorldContextObject;
+	Action->NumPublicConnections = NumPublicConnections;
+	Action->MatchType = MoveTemp(MatchType);
+	Action->TravelURL = MoveTemp(TravelURL);
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+bool UCreateSessionAsyncAction::Start(UMultiplayerSessionsSubsystem& InSubsystem)
+{
+	InSubsystem.MultiplayerOnCreateSessionCompleteDelegate.AddDynamic(this, &ThisClass::OnCreateSessionComplete);
+	OperationId = InSubsystem.HostSession(NumPublicConnections, MatchType, TravelURL);
+	return OperationId != INDEX_NONE;
+}
+
+void UCreateSessionAsyncAction::Unbind(UMultiplayerSessionsSubsystem& InSubsystem)
+{
+	InSubsystem.MultiplayerOnCreateSessionCompleteDelegate.RemoveDynamic(this, &ThisClass::OnCreateSessionComplete);
+}
+
+void UCreateSessionAsyncAction::OnCreateSessionComplete(bool bWasSuccessful)
+{
+	if (!IsOwnResult()) return;
+
+	if (bWasSuccessful)
+	{
+		OnSuccess.Broadcast();
+	}
+	else
+	{
+		OnFailure.Broadcast();
+	}
+	Finish();
+}
+
+UFindSessionsAsyncAction* UFindSessionsAsyncAction::FindSessions(UObject* WorldContextObject, FString MatchType, int32 MaxResults)
+{
+	UFindSessionsAsyncAction* Action = NewObject<UFindSessionsAsyncAction>();
+	Action->WorldContextObject = WorldContextObject;
+	Action->Query.WithMaxResults(MaxResults);
+	if (!MatchType.IsEmpty())
+	{
+		Action->Query.WithMatchType(MatchType);
+	}
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+bool UFindSessionsAsyncAction::Start(UMultiplayerSessionsSubsystem& InSubsystem)
+{
+	FindCompleteHandle = InSubsystem.MultiplayerOnFindSessionSummariesCompleteDelegate.AddUObject(this, &ThisClass::OnFindSessionsComplete);
+	OperationId = InSubsystem.FindSessions(Query);
+	return OperationId != INDEX_NONE;
+}
+
+void UFindSessionsAsyncAction::Unbind(UMultiplayerSessionsSubsystem& InSubsystem)
+{
+	InSubsystem.MultiplayerOnFindSessionSummariesCompleteDelegate.Remove(FindCompleteHandle);
+	FindCompleteHandle.Reset();
+}
+
+void UFindSessionsAsyncAction::OnFindSessionsComplete(TArrayView<const FSessionSummary> Summaries, bool bWasSuccessful)
+{
+	if (!IsOwnResult()) return;
+
+	const UMultiplayerSessionsSubsystem* SessionsSubsystem = Subsystem.Get();
+	TArray<FBlueprintSessionResult> Results;
+	Results.Reserve(Summaries.Num());
+	for (const FSessionSummary& Summary : Summaries)
+	{
+		// 只有 id 和主机名需要回到原始结果里取
+		const FOnlineSessionSearchResult* SearchResult = SessionsSubsystem ? SessionsSubsystem->GetSearchResult(Summary.ResultIndex) : nullptr;
+		if (SearchResult == nullptr) continue;
+
+		FBlueprintSessionResult& Result = Results.AddDefaulted_GetRef();
+		Result.SessionId = SearchResult->GetSessionIdStr();
+		Result.OwningUserName = SearchResult->Session.OwningUserName;
+		Result.MatchType = Summary.MatchType;
+		Result.PingInMs = Summary.PingInMs;
+		Result.NumPlayers = Summary.NumPublicConnections - Summary.NumOpenPublicConnections;
+		Result.MaxPlayers = Summary.NumPublicConnections;
+	}
+
+	if (bWasSuccessful)
+	{
+		OnSuccess.Broadcast(Results);
+	}
+	else
+	{
+		OnFailure.Broadcast(Results);
+	}
+	Finish();
+}
+
+UJoinSessionAsyncAction* UJoinSessionAsyncAction::JoinSession(UObject* WorldContextObject, FString SessionId)
+{
+	UJoinSessionAsyncAction* Action = NewObject<UJoinSessionAsyncAction>();
+	Action->WorldContextObject = WorldContextObject;
+	Action->SessionId = MoveTemp(SessionId);
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+UJoinSessionAsyncAction* UJoinSessionAsyncAction::FindAndJoinSession(UObject* WorldContextObject, FString MatchType)
+{
+	UJoinSessionAsyncAction* Action = NewObject<UJoinSessionAsyncAction>();
+	Action->WorldContextObject = WorldContextObject;
+	FMultiplayerSessionQuery& Query = Action->Query.Emplace();
+	if (!MatchType.IsEmpty())
+	{
+		Query.WithMatchType(MatchType);
+	}
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+bool UJoinSessionAsyncAction::Start(UMultiplayerSessionsSubsystem& InSubsystem)
+{
+	JoinCompleteHandle = InSubsystem.MultiplayerOnJoinSessionCompleteDelegate.AddUObject(this, &ThisClass::OnJoinSessionComplete);
+	// FindAndJoinSession 的最终结果也以搜索的 id 广播
+	OperationId = Query.IsSet() ? InSubsystem.FindAndJoinSession(Query.GetValue()) : InSubsystem.JoinSearchResult(SessionId);
+	return OperationId != INDEX_NONE;
+}
+
+void UJoinSessionAsyncAction::Unbind(UMultiplayerSessionsSubsystem& InSubsystem)
+{
+	InSubsystem.MultiplayerOnJoinSessionCompleteDelegate.Remove(JoinCompleteHandle);
+	JoinCompleteHandle.Reset();
+}
+
+void UJoinSessionAsyncAction::BroadcastFailure()
+{
+	OnFailure.Broadcast(LexToString(EOnJoinSessionCompleteResult::SessionDoesNotExist));
+}
+
+void UJoinSessionAsyncAction::OnJoinSessionComplete(EOnJoinSessionCompleteResult::Type Result)
+{
+	if (!IsOwnResult()) return;
+
+	if (Result == EOnJoinSessionCompleteResult::Success)
+	{
+		OnSuccess.Broadcast(LexToString(Result));
+	}
+	else
+	{
+		OnFailure.Broadcast(LexToString(Result));
+	}
+	Finish();
+}
@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SessionBrowserEntry.h"
+
+#include "ServerBrowser.h"
+#include "Components/TextBlock.h"
+
+void USessionBrowserEntry::NativeOnListItemObjectSet(UObject* ListItemObject)
+{
+	IUserObjectListEntry::NativeOnListItemObjectSet(ListItemObject);
+
+	const USessionBrowserItem* Item = Cast<USessionBrowserItem>(ListItemObject);
+	const FSessionBrowserRow* Row = Item ? Item->GetRow() : nullptr;
+	if (Row == nullptr) return;
+
+	// 条目会被列表复用，每次绑定都要把所有文本重新设置一遍
+	HostNameText->SetText(FText::FromString(Row->OwningUserName));
+	if (MatchTypeText)
+	{
+		MatchTypeText->SetText(FText::FromName(Row->MatchType));
+	}
+	PlayersText->SetText(FText::Format(NSLOCTEXT("MultiplayerSessions", "BrowserPlayers", "{0}/{1}"),
+		Row->NumPublicConnections - Row->NumOpenPublicConnections, Row->NumPublicConnections));
+	PingText->SetText(FText::AsNumber(Row->PingInMs));
+}
@@ -0,0 +1,194 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SessionLatencyStats.h"
+
+#include "ProfilingDebugging/CountersTrace.h"
+
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Create (ms)"), STAT_SessionCreateMs, STATGROUP_MultiplayerSessions);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Find (ms)"), STAT_SessionFindMs, STATGROUP_MultiplayerSessions);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Join (ms)"), STAT_SessionJoinMs, STATGROUP_MultiplayerSessions);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Destroy (ms)"), STAT_SessionDestroyMs, STATGROUP_MultiplayerSessions);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Start (ms)"), STAT_SessionStartMs, STATGROUP_MultiplayerSessions);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("End (ms)"), STAT_SessionEndMs, STATGROUP_MultiplayerSessions);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Update (ms)"), STAT_SessionUpdateMs, STATGROUP_MultiplayerSessions);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Travel (ms)"), STAT_SessionTravelMs, STATGROUP_MultiplayerSessions);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Failed operations"), STAT_SessionFailedOperations, STATGROUP_MultiplayerSessions);
+
+TRACE_DECLARE_FLOAT_COUNTER(SessionCreateMs, TEXT("MultiplayerSessions/Create (ms)"));
+TRACE_DECLARE_FLOAT_COUNTER(SessionFindMs, TEXT("MultiplayerSessions/Find (ms)"));
+TRACE_DECLARE_FLOAT_COUNTER(SessionJoinMs, TEXT("MultiplayerSessions/Join (ms)"));
+TRACE_DECLARE_FLOAT_COUNTER(SessionDestroyMs, TEXT("MultiplayerSessions/Destroy (ms)"));
+TRACE_DECLARE_FLOAT_COUNTER(SessionStartMs, TEXT("MultiplayerSessions/Start (ms)"));
+TRACE_DECLARE_FLOAT_COUNTER(SessionEndMs, TEXT("MultiplayerSessions/End (ms)"));
+TRACE_DECLARE_FLOAT_COUNTER(SessionUpdateMs, TEXT("MultiplayerSessions/Update (ms)"));
+TRACE_DECLARE_FLOAT_COUNTER(SessionTravelMs, TEXT("MultiplayerSessions/Travel (ms)"));
+
+const TCHAR* LexToString(ESessionLatencyStat Stat)
+{
+	switch (Stat)
+	{
+	case ESessionLatencyStat::Create: return TEXT("Create");
+	case ESessionLatencyStat::Find: return TEXT("Find");
+	case ESessionLatencyStat::Join: return TEXT("Join");
+	case ESessionLatencyStat::Destroy: return TEXT("Destroy");
+	case ESessionLatencyStat::Start: return TEXT("Start");
+	case ESessionLatencyStat::End: return TEXT("End");
+	case ESessionLatencyStat::Update: return TEXT("Update");
+	case ESessionLatencyStat::Travel: return TEXT("Travel");
+	default: return TEXT("Unknown");
+	}
+}
+
+void FSessionLatencyHistogram::SetWindowSize(int32 InWindowSize)
+{
+	WindowSize = FMath::Max(InWindowSize, 1);
+	DurationsMs.Reset();
+	NextIndex = 0;
+}
+
+void FSessionLatencyHistogram::Add(const FSessionLatencySample& Sample)
+{
+	const double DurationMs = Sample.GetDurationMs();
+	if (DurationsMs.Num() < WindowSize)
+	{
+		DurationsMs.Add(DurationMs);
+	}
+	else
+	{
+		DurationsMs[NextIndex] = DurationMs;
+		NextIndex = (NextIndex + 1) % WindowSize;
+	}
+	++NumSamples;
+	if (Sample.bCancelled)
+	{
+		++NumCancelled;
+	}
+	else if (!Sample.bSucceeded)
+	{
+		++NumFailed;
+	}
+	LastSample = Sample;
+}
+
+void FSessionLatencyHistogram::Reset()
+{
+	DurationsMs.Reset();
+	NextIndex = 0;
+	NumSamples = 0;
+	NumFailed = 0;
+	NumCancelled = 0;
+	LastSample = FSessionLatencySample();
+}
+
+void FSessionLatencyHistogram::GetSortedDurations(TArray<double>& OutSorted) const
+{
+	OutSorted = DurationsMs;
+	OutSorted.Sort();
+}
+
+static double NearestRank(const TArray<double>& Sorted, double Percentile)
+{
+	if (Sorted.IsEmpty()) return 0.0;
+
+	const int32 Rank = FMath::CeilToInt32(FMath::Clamp(Percentile, 0.0, 1.0) * Sorted.Num());
+	return Sorted[FMath::Clamp(Rank - 1, 0, Sorted.Num() - 1)];
+}
+
+double FSessionLatencyHistogram::GetPercentileMs(double Percentile) const
+{
+	TArray<double> Sorted;
+	GetSortedDurations(Sorted);
+	return NearestRank(Sorted, Percentile);
+}
+
+void FSessionLatencyHistogram::GetPercentilesMs(double& OutP50, double& OutP95, double& OutP99) const
+{
+	TArray<double> Sorted;
+	GetSortedDurations(Sorted);
+	OutP50 = NearestRank(Sorted, 0.50);
+	OutP95 = NearestRank(Sorted, 0.95);
+	OutP99 = NearestRank(Sorted, 0.99);
+}
+
+void FSessionLatencyStats::SetWindowSize(int32 WindowSize)
+{
+	for (FSessionLatencyHistogram& Histogram : Histograms)
+	{
+		Histogram.SetWindowSize(WindowSize);
+	}
+}
+
+void FSessionLatencyStats::Record(ESessionLatencyStat Stat, const FSessionLatencySample& Sample)
+{
+	Histograms[static_cast<int32>(Stat)].Add(Sample);
+
+	const double DurationMs = Sample.GetDurationMs();
+	switch (Stat)
+	{
+	case ESessionLatencyStat::Create:
+		SET_FLOAT_STAT(STAT_SessionCreateMs, DurationMs);
+		TRACE_COUNTER_SET(SessionCreateMs, DurationMs);
+		break;
+	case ESessionLatencyStat::Find:
+		SET_FLOAT_STAT(STAT_SessionFindMs, DurationMs);
+		TRACE_COUNTER_SET(SessionFindMs, DurationMs);
+		break;
+	case ESessionLatencyStat::Join:
+		SET_FLOAT_STAT(STAT_SessionJoinMs, DurationMs);
+		TRACE_COUNTER_SET(SessionJoinMs, DurationMs);
+		break;
+	case ESessionLatencyStat::Destroy:
+		SET_FLOAT_STAT(STAT_SessionDestroyMs, DurationMs);
+		TRACE_COUNTER_SET(SessionDestroyMs, DurationMs);
+		break;
+	case ESessionLatencyStat::Start:
+		SET_FLOAT_STAT(STAT_SessionStartMs, DurationMs);
+		TRACE_COUNTER_SET(SessionStartMs, DurationMs);
+		break;
+	case ESessionLatencyStat::End:
+		SET_FLOAT_STAT(STAT_SessionEndMs, DurationMs);
+		TRACE_COUNTER_SET(SessionEndMs, DurationMs);
+		break;
+	case ESessionLatencyStat::Update:
+		SET_FLOAT_STAT(STAT_SessionUpdateMs, DurationMs);
+		TRACE_COUNTER_SET(SessionUpdateMs, DurationMs);
+		break;
+	case ESessionLatencyStat::Travel:
+		SET_FLOAT_STAT(STAT_SessionTravelMs, DurationMs);
+		TRACE_COUNTER_SET(SessionTravelMs, DurationMs);
+		break;
+	default:
+		break;
+	}
+	if (!Sample.bSucceeded && !Sample.bCancelled)
+	{
+		INC_DWORD_STAT(STAT_SessionFailedOperations);
+	}
+}
+
+void FSessionLatencyStats::Reset()
+{
+	for (FSessionLatencyHistogram& Histogram : Histograms)
+	{
+		Histogram.Reset();
+	}
+}
+
+void FSessionLatencyStats::Dump(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("%-8s %8s %8s %9s %10s %10s %10s %10s %6s %6s"),
+		TEXT("Op"), TEXT("Count"), TEXT("Failed"), TEXT("Cancelled"), TEXT("p50 ms"), TEXT("p95 ms"), TEXT("p99 ms"), TEXT("Last ms"), TEXT("Code"), TEXT("Found"));
+	for (int32 Index = 0; Index < static_cast<int32>(ESessionLatencyStat::Num); ++Index)
+	{
+		const FSessionLatencyHistogram& Histogram = Histograms[Index];
+		double P50, P95, P99;
+		Histogram.GetPercentilesMs(P50, P95, P99);
+		const FSessionLatencySample& Last = Histogram.GetLastSample();
+		Ar.Logf(TEXT("%-8s %8lld %8lld %9lld %10.1f %10.1f %10.1f %10.1f %6d %6d"),
+			LexToString(static_cast<ESessionLatencyStat>(Index)),
+			Histogram.GetNumSamples(), Histogram.GetNumFailed(), Histogram.GetNumCancelled(),
+			P50, P95, P99,
+			Histogram.GetNumSamples() > 0 ? Last.GetDurationMs() : 0.0, Last.ResultCode, Last.ResultCount);
+	}
+}
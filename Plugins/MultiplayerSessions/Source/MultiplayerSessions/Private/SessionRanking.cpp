@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SessionRanking.h"
+
+#include "Icmp.h"
+#include "MultiplayerSessionQuery.h"
+
+float FRankedSessionCandidate::ComputeScore(const FSessionFilterKey& Key, int32 PingInMs, const FSessionRankingWeights& Weights)
+{
+	const float OpenFraction = Key.NumPublicConnections > 0
+		? static_cast<float>(Key.NumOpenPublicConnections) / Key.NumPublicConnections
+		: 0.f;
+	return Weights.OpenSlotsWeight * OpenFraction
+		+ Weights.HostQualityWeight * Key.HostQuality
+		- Weights.PingWeight * PingInMs;
+}
+
+void FIcmpSessionLatencyProbe::Probe(const FOnlineSessionSearchResult& SearchResult, const FString& HostAddress, float Timeout, FOnSessionLatencyProbed OnProbed)
+{
+	// 连接字符串带端口，ICMP 只需要主机地址
+	FString Host = HostAddress;
+	int32 PortSeparator;
+	if (Host.FindLastChar(TEXT(':'), PortSeparator))
+	{
+		Host.LeftInline(PortSeparator);
+	}
+
+	FIcmp::IcmpEcho(Host, Timeout, [OnProbed](FIcmpEchoResult Result)
+	{
+		OnProbed.ExecuteIfBound(Result.Status == EIcmpResponseStatus::Success
+			? FMath::RoundToInt(Result.Time * 1000.f)
+			: INDEX_NONE);
+	});
+}
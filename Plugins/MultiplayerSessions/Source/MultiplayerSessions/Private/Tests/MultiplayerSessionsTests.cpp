@@ -0,0 +1,470 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "MultiplayerSessionsSubsystem.h"
+#include "MultiplayerSessionQuery.h"
+#include "SessionRanking.h"
+#include "SessionLatencyStats.h"
+#include "FakeOnlineSession.h"
+#include "OnlineSessionSettings.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "Containers/Ticker.h"
+#include "UObject/UnrealType.h"
+
+namespace MultiplayerSessionsTests
+{
+	const FString MatchType(TEXT("FreeForAll"));
+	const FString OtherMatchType(TEXT("TeamDeathMatch"));
+
+	// 固定种子、没有抖动和随机失败，搜索结果一次返回
+	FFakeSessionSimulation MakeSimulation(int32 NumHosts, float Latency)
+	{
+		FFakeSessionSimulation Simulation;
+		Simulation.NumHosts = NumHosts;
+		Simulation.Latency = Latency;
+		Simulation.LatencyJitter = 0.f;
+		Simulation.FailureRate = 0.f;
+		Simulation.JoinRaceRate = 0.f;
+		Simulation.NumSearchBatches = 1;
+		Simulation.RandomSeed = 42;
+		return Simulation;
+	}
+
+	/**
+	 * A session subsystem on a standalone game instance, switched to the fake backend, like the benchmark commandlet.
+	 * Nothing ticks it on its own: WaitFor drives the core ticker.
+	 **/
+	class FTestSessions
+	{
+	public:
+		explicit FTestSessions(const FFakeSessionSimulation& Simulation)
+		{
+			GameInstance = NewObject<UGameInstance>(GEngine);
+			GameInstance->AddToRoot();
+			GameInstance->InitializeStandalone();
+			World = GameInstance->GetWorld();
+			Sessions = GameInstance->GetSubsystem<UMultiplayerSessionsSubsystem>();
+			bUsingFakeBackend = Sessions && Sessions->UseFakeOnlineSession(Simulation);
+		}
+
+		~FTestSessions()
+		{
+			GameInstance->Shutdown();
+			if (World)
+			{
+				World->DestroyWorld(false);
+			}
+			GameInstance->RemoveFromRoot();
+		}
+
+		bool IsValid() const { return bUsingFakeBackend; }
+		UMultiplayerSessionsSubsystem& operator*() const { return *Sessions; }
+		UMultiplayerSessionsSubsystem* operator->() const { return Sessions; }
+
+		// Overrides one of the subsystem's config values for this instance only
+		bool SetConfig(const TCHAR* PropertyName, float Value) const
+		{
+			const FFloatProperty* Property = FindFProperty<FFloatProperty>(UMultiplayerSessionsSubsystem::StaticClass(), PropertyName);
+			if (Property == nullptr) return false;
+			Property->SetPropertyValue_InContainer(Sessions, Value);
+			return true;
+		}
+
+		// The game instance's timers (e.g. the search cache refresh) are only run when asked for, once per frame
+		void TickTimers(float DeltaTime) const
+		{
+			GameInstance->GetTimerManager().Tick(DeltaTime);
+		}
+
+	private:
+		UGameInstance* GameInstance{nullptr};
+		UWorld* World{nullptr};
+		UMultiplayerSessionsSubsystem* Sessions{nullptr};
+		bool bUsingFakeBackend{false};
+	};
+
+	// Tick the core ticker (the subsystem and the fake backend) until IsDone or the timeout runs out; returns IsDone()
+	bool WaitFor(TFunctionRef<bool()> IsDone, double Timeout)
+	{
+		const double Deadline = FPlatformTime::Seconds() + Timeout;
+		double LastTime = FPlatformTime::Seconds();
+		while (!IsDone() && FPlatformTime::Seconds() < Deadline)
+		{
+			const double Now = FPlatformTime::Seconds();
+			FTSTicker::GetCoreTicker().Tick(static_cast<float>(Now - LastTime));
+			LastTime = Now;
+			FPlatformProcess::Sleep(0.001f);
+		}
+		return IsDone();
+	}
+
+	// Tick for a while without waiting for anything, e.g. to let a reply that must not arrive show up
+	void Settle(double Seconds)
+	{
+		WaitFor([] { return false; }, Seconds);
+	}
+
+	// Every broadcast of a completion delegate, with the operation id it reported
+	template <typename ResultType>
+	struct TRecordedResult
+	{
+		int32 OperationId{INDEX_NONE};
+		ResultType Result;
+	};
+
+	void RecordFindResults(UMultiplayerSessionsSubsystem& Sessions, TArray<TRecordedResult<bool>>& OutResults)
+	{
+		Sessions.MultiplayerOnFindSessionsCompleteDelegate.AddLambda([&Sessions, &OutResults](const TArray<FOnlineSessionSearchResult>&, bool bWasSuccessful)
+		{
+			OutResults.Add({Sessions.GetBroadcastingOperationId(), bWasSuccessful});
+		});
+	}
+
+	void RecordJoinResults(UMultiplayerSessionsSubsystem& Sessions, TArray<TRecordedResult<EOnJoinSessionCompleteResult::Type>>& OutResults)
+	{
+		Sessions.MultiplayerOnJoinSessionCompleteDelegate.AddLambda([&Sessions, &OutResults](EOnJoinSessionCompleteResult::Type Result)
+		{
+			OutResults.Add({Sessions.GetBroadcastingOperationId(), Result});
+		});
+	}
+
+	FOnlineSessionSettings MakeHostSettings(const FString& InMatchType, int32 NumPublicConnections, TOptional<int32> Joinable)
+	{
+		FOnlineSessionSettings Settings;
+		Settings.NumPublicConnections = NumPublicConnections;
+		Settings.bShouldAdvertise = true;
+		Settings.BuildUniqueId = 1;
+		Settings.Set(FMultiplayerSessionQuery::MatchTypeKey, InMatchType, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		Settings.Set(FMultiplayerSessionQuery::BuildIdKey, Settings.BuildUniqueId, EOnlineDataAdvertisementType::ViaOnlineService);
+		if (Joinable.IsSet())
+		{
+			Settings.Set(FMultiplayerSessionQuery::JoinableKey, Joinable.GetValue(), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		}
+		return Settings;
+	}
+
+	FSessionFilterKey MakeFilterKey(const FString& InMatchType, int32 NumPublicConnections, int32 NumOpenPublicConnections, TOptional<int32> Joinable)
+	{
+		FOnlineSessionSearchResult Result;
+		Result.Session = FOnlineSession(MakeHostSettings(InMatchType, NumPublicConnections, Joinable));
+		Result.Session.NumOpenPublicConnections = NumOpenPublicConnections;
+		return FSessionFilterKey::Extract(Result);
+	}
+
+	// Session ids of what the fake backend returns for this query
+	TArray<FString> RunBackendSearch(FFakeOnlineSession& Backend, const FMultiplayerSessionQuery& Query)
+	{
+		const TSharedRef<FOnlineSessionSearch> Search = MakeShared<FOnlineSessionSearch>();
+		Query.ApplyTo(*Search);
+		TArray<FString> SessionIds;
+		if (!Backend.FindSessions(0, Search)) return SessionIds;
+
+		WaitFor([&Search] { return Search->SearchState != EOnlineAsyncTaskState::InProgress; }, 5.0);
+		for (const FOnlineSessionSearchResult& Result : Search->SearchResults)
+		{
+			SessionIds.Add(Result.GetSessionIdStr());
+		}
+		return SessionIds;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiplayerSessionsQueryFilterTest, "MultiplayerSessions.Query.Filter",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FMultiplayerSessionsQueryFilterTest::RunTest(const FString& Parameters)
+{
+	// 客户端过滤：只有广播 JOINABLE = 1 的主机算可加入，没有这个键的也不算
+	const FSessionFilterKey Open = MultiplayerSessionsTests::MakeFilterKey(MultiplayerSessionsTests::MatchType, 4, 2, 1);
+	const FSessionFilterKey Unjoinable = MultiplayerSessionsTests::MakeFilterKey(MultiplayerSessionsTests::MatchType, 4, 2, 0);
+	const FSessionFilterKey NoJoinableKey = MultiplayerSessionsTests::MakeFilterKey(MultiplayerSessionsTests::MatchType, 4, 2, TOptional<int32>());
+	TestTrue(TEXT("A joinable session matches the default query"), FMultiplayerSessionQuery().Matches(Open));
+	TestFalse(TEXT("JOINABLE = 0 is filtered out"), FMultiplayerSessionQuery().Matches(Unjoinable));
+	TestFalse(TEXT("A host without JOINABLE is filtered out"), FMultiplayerSessionQuery().Matches(NoJoinableKey));
+	TestTrue(TEXT("IncludeUnjoinable keeps JOINABLE = 0"), FMultiplayerSessionQuery().IncludeUnjoinable().Matches(Unjoinable));
+	TestTrue(TEXT("Enough open slots"), FMultiplayerSessionQuery().WithMinOpenSlots(2).Matches(Open));
+	TestFalse(TEXT("Too few open slots"), FMultiplayerSessionQuery().WithMinOpenSlots(3).Matches(Open));
+	TestTrue(TEXT("Same match type"), FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::MatchType).Matches(Open));
+	TestFalse(TEXT("Other match type"), FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::OtherMatchType).Matches(Open));
+	TestFalse(TEXT("Other build"), FMultiplayerSessionQuery().WithBuildId(2).Matches(Open));
+
+	// 后端过滤：ApplyTo 写入的 QuerySettings 与 Matches 的结论一致
+	const TSharedRef<FFakeOnlineSession, ESPMode::ThreadSafe> Backend = MakeShared<FFakeOnlineSession, ESPMode::ThreadSafe>(MultiplayerSessionsTests::MakeSimulation(0, 0.f));
+	const FString OpenId = Backend->AddHost(MultiplayerSessionsTests::MakeHostSettings(MultiplayerSessionsTests::MatchType, 4, 1), 50, 2);
+	const FString UnjoinableId = Backend->AddHost(MultiplayerSessionsTests::MakeHostSettings(MultiplayerSessionsTests::MatchType, 4, 0), 50, 2);
+	const FString FullId = Backend->AddHost(MultiplayerSessionsTests::MakeHostSettings(MultiplayerSessionsTests::MatchType, 4, 1), 50, 0);
+	const FString OtherTypeId = Backend->AddHost(MultiplayerSessionsTests::MakeHostSettings(MultiplayerSessionsTests::OtherMatchType, 4, 1), 50, 3);
+
+	const TArray<FString> Joinable = MultiplayerSessionsTests::RunBackendSearch(*Backend, FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::MatchType).WithMinOpenSlots(1));
+	TestEqual(TEXT("Backend: joinable with a slot"), Joinable, TArray<FString>{OpenId});
+
+	TArray<FString> WithUnjoinable = MultiplayerSessionsTests::RunBackendSearch(*Backend, FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::MatchType).WithMinOpenSlots(1).IncludeUnjoinable());
+	WithUnjoinable.Sort();
+	TArray<FString> ExpectedWithUnjoinable{OpenId, UnjoinableId};
+	ExpectedWithUnjoinable.Sort();
+	TestEqual(TEXT("Backend: IncludeUnjoinable"), WithUnjoinable, ExpectedWithUnjoinable);
+
+	const TArray<FString> AnyType = MultiplayerSessionsTests::RunBackendSearch(*Backend, FMultiplayerSessionQuery().WithMinOpenSlots(3));
+	TestEqual(TEXT("Backend: open slots across match types"), AnyType, TArray<FString>{OtherTypeId});
+	TestFalse(TEXT("Backend: a full session is never returned"), MultiplayerSessionsTests::RunBackendSearch(*Backend, FMultiplayerSessionQuery().WithMinOpenSlots(1).IncludeUnjoinable()).Contains(FullId));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiplayerSessionsRankingOrderTest, "MultiplayerSessions.Ranking.Order",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FMultiplayerSessionsRankingOrderTest::RunTest(const FString& Parameters)
+{
+	const FSessionRankingWeights Weights;
+	const FSessionFilterKey HalfFull = MultiplayerSessionsTests::MakeFilterKey(MultiplayerSessionsTests::MatchType, 4, 2, 1);
+	const FSessionFilterKey Empty = MultiplayerSessionsTests::MakeFilterKey(MultiplayerSessionsTests::MatchType, 4, 4, 1);
+	TestTrue(TEXT("Lower ping scores higher"),
+		FRankedSessionCandidate::ComputeScore(HalfFull, 20, Weights) > FRankedSessionCandidate::ComputeScore(HalfFull, 80, Weights));
+	TestTrue(TEXT("Emptier session scores higher"),
+		FRankedSessionCandidate::ComputeScore(Empty, 50, Weights) > FRankedSessionCandidate::ComputeScore(HalfFull, 50, Weights));
+
+	MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(50, 0.01f));
+	if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+
+	bool bRanked = false;
+	Sessions->MultiplayerOnSessionCandidatesRankedDelegate.AddLambda([&bRanked](TArrayView<const FRankedSessionCandidate>) { bRanked = true; });
+	const int32 OperationId = Sessions->FindSessions(FMultiplayerSessionQuery());
+	if (!TestTrue(TEXT("Search completes"), MultiplayerSessionsTests::WaitFor([&Sessions, OperationId] { return !Sessions->IsOperationQueued(OperationId); }, 5.0))) return false;
+	Sessions->RankSessionCandidates();
+	if (!TestTrue(TEXT("Ranking completes"), MultiplayerSessionsTests::WaitFor([&bRanked] { return bRanked; }, 5.0))) return false;
+
+	const TArray<FRankedSessionCandidate>& Candidates = Sessions->GetRankedCandidates();
+	TestEqual(TEXT("Every matching result is ranked"), Candidates.Num(), Sessions->GetMatchingResultIndices().Num());
+	TestTrue(TEXT("Something to rank"), Candidates.Num() > 1);
+	for (int32 Rank = 1; Rank < Candidates.Num(); ++Rank)
+	{
+		if (!TestTrue(FString::Printf(TEXT("Rank %d is not better than rank %d"), Rank, Rank - 1), Candidates[Rank - 1].Score >= Candidates[Rank].Score)) break;
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiplayerSessionsQueueCoalescingTest, "MultiplayerSessions.Queue.Coalescing",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FMultiplayerSessionsQueueCoalescingTest::RunTest(const FString& Parameters)
+{
+	TArray<MultiplayerSessionsTests::TRecordedResult<bool>> FindResults;
+	MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(20, 0.1f));
+	if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+	MultiplayerSessionsTests::RecordFindResults(*Sessions, FindResults);
+
+	const FMultiplayerSessionQuery Query = FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::MatchType);
+	const FMultiplayerSessionQuery OtherQuery = FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::OtherMatchType);
+	const int32 Running = Sessions->FindSessions(Query);
+	TestEqual(TEXT("Same query as the running search"), Sessions->FindSessions(Query), Running);
+	const int32 Queued = Sessions->FindSessions(OtherQuery);
+	TestNotEqual(TEXT("Other query is queued separately"), Queued, Running);
+	TestEqual(TEXT("Same query as the queued search"), Sessions->FindSessions(OtherQuery), Queued);
+	const int32 Streamed = Sessions->FindSessions(FMultiplayerSessionQuery(Query).Streamed());
+	TestTrue(TEXT("A streamed search is not merged with a plain one"), Streamed != Running && Streamed != Queued);
+
+	if (!TestTrue(TEXT("Queue drains"), MultiplayerSessionsTests::WaitFor([&Sessions] { return !Sessions->IsBusy(); }, 5.0))) return false;
+	TestEqual(TEXT("One completion per distinct search"), FindResults.Num(), 3);
+	TestTrue(TEXT("Completions in queue order"), FindResults.Num() == 3
+		&& FindResults[0].OperationId == Running && FindResults[1].OperationId == Queued && FindResults[2].OperationId == Streamed);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiplayerSessionsQueueCancelTest, "MultiplayerSessions.Queue.Cancel",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FMultiplayerSessionsQueueCancelTest::RunTest(const FString& Parameters)
+{
+	TArray<MultiplayerSessionsTests::TRecordedResult<bool>> FindResults;
+	TArray<int32> CancelledIds;
+	MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(20, 0.1f));
+	if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+	MultiplayerSessionsTests::RecordFindResults(*Sessions, FindResults);
+	Sessions->MultiplayerOnFindSessionsCancelledDelegate.AddLambda([&CancelledIds](int32 OperationId) { CancelledIds.Add(OperationId); });
+	Sessions->ResetLatencyStats();
+
+	const int32 Running = Sessions->FindSessions(FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::MatchType));
+	const int32 Queued = Sessions->FindSessions(FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::OtherMatchType));
+	const int32 Last = Sessions->FindSessions(FMultiplayerSessionQuery().WithMinOpenSlots(1));
+
+	TestTrue(TEXT("Cancel a queued search"), Sessions->CancelOperation(Queued));
+	TestFalse(TEXT("Cancelled search left the queue"), Sessions->IsOperationQueued(Queued));
+	TestTrue(TEXT("Cancel the running search"), Sessions->CancelOperation(Running));
+	TestFalse(TEXT("Nothing to cancel twice"), Sessions->CancelOperation(Running));
+	TestTrue(TEXT("The next search runs right away"), Sessions->IsOperationQueued(Last));
+	TestEqual(TEXT("Both cancellations reported, in order"), CancelledIds, TArray<int32>{Queued, Running});
+
+	if (!TestTrue(TEXT("Queue drains"), MultiplayerSessionsTests::WaitFor([&Sessions] { return !Sessions->IsBusy(); }, 5.0))) return false;
+	// 被取消的搜索即使后端迟到回复也不会完成
+	MultiplayerSessionsTests::Settle(0.3);
+	TestTrue(TEXT("Only the remaining search completes"), FindResults.Num() == 1 && FindResults[0].OperationId == Last && FindResults[0].Result);
+
+	const FSessionLatencyHistogram& FindStats = Sessions->GetLatencyStats().Get(ESessionLatencyStat::Find);
+	TestEqual(TEXT("The running search is recorded as cancelled"), FindStats.GetNumCancelled(), int64(1));
+	TestEqual(TEXT("A cancelled search is not a failure"), FindStats.GetNumFailed(), int64(0));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiplayerSessionsQueueTimeoutTest, "MultiplayerSessions.Queue.Timeout",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FMultiplayerSessionsQueueTimeoutTest::RunTest(const FString& Parameters)
+{
+	TArray<MultiplayerSessionsTests::TRecordedResult<bool>> FindResults;
+	// 后端 5 秒才回复，远超下面设置的超时
+	MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(20, 5.f));
+	if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+	if (!TestTrue(TEXT("Find timeout is configurable"), Sessions.SetConfig(TEXT("FindOperationTimeout"), 0.1f))) return false;
+	MultiplayerSessionsTests::RecordFindResults(*Sessions, FindResults);
+
+	const int32 TimedOut = Sessions->FindSessions(FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::MatchType));
+	const int32 Next = Sessions->FindSessions(FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::OtherMatchType));
+	if (!TestTrue(TEXT("The search times out before the backend replies"), MultiplayerSessionsTests::WaitFor([&Sessions, TimedOut] { return !Sessions->IsOperationQueued(TimedOut); }, 2.0))) return false;
+
+	TestTrue(TEXT("Timed out search completes as failed"), FindResults.Num() == 1 && FindResults[0].OperationId == TimedOut && !FindResults[0].Result);
+	TestTrue(TEXT("The queue moves on"), Sessions->IsOperationQueued(Next));
+	Sessions->CancelOperation(Next);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiplayerSessionsSearchCacheTest, "MultiplayerSessions.Cache.TTL",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FMultiplayerSessionsSearchCacheTest::RunTest(const FString& Parameters)
+{
+	TArray<MultiplayerSessionsTests::TRecordedResult<bool>> FindResults;
+	MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(20, 0.05f));
+	if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+	MultiplayerSessionsTests::RecordFindResults(*Sessions, FindResults);
+
+	const FMultiplayerSessionQuery Query = FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::MatchType);
+	const int32 First = Sessions->FindSessions(Query);
+	TestTrue(TEXT("The first search goes to the backend"), Sessions->IsOperationQueued(First));
+	if (!TestTrue(TEXT("First search completes"), MultiplayerSessionsTests::WaitFor([&Sessions, First] { return !Sessions->IsOperationQueued(First); }, 5.0))) return false;
+
+	// 缓存命中时在调用内部同步完成
+	const int32 Cached = Sessions->FindSessions(Query);
+	TestFalse(TEXT("A fresh entry is served without the backend"), Sessions->IsOperationQueued(Cached));
+	TestTrue(TEXT("Served search completes under its own id"), FindResults.Num() == 2 && FindResults[1].OperationId == Cached && FindResults[1].Result);
+
+	// 过期（超过 TTL）但未超过 MaxStaleAge：仍然直接返回，并由刷新定时器在后台重新搜索
+	if (!TestTrue(TEXT("TTL is configurable"), Sessions.SetConfig(TEXT("SearchCacheTTL"), 0.f))) return false;
+	MultiplayerSessionsTests::Settle(0.01);
+	const int32 Stale = Sessions->FindSessions(Query);
+	TestFalse(TEXT("A stale entry is still served"), Sessions->IsOperationQueued(Stale));
+	Sessions.TickTimers(10.f);
+	TestTrue(TEXT("The refresh timer revalidates the stale entry"), Sessions->IsBusy());
+	if (!TestTrue(TEXT("Revalidation completes"), MultiplayerSessionsTests::WaitFor([&Sessions] { return !Sessions->IsBusy(); }, 5.0))) return false;
+	TestEqual(TEXT("Revalidation is silent"), FindResults.Num(), 3);
+
+	// 超过 MaxStaleAge 的条目不再返回
+	if (!TestTrue(TEXT("Max stale age is configurable"), Sessions.SetConfig(TEXT("SearchCacheMaxStaleAge"), 0.f))) return false;
+	MultiplayerSessionsTests::Settle(0.01);
+	const int32 Evicted = Sessions->FindSessions(Query);
+	TestTrue(TEXT("An entry past the max stale age goes to the backend"), Sessions->IsOperationQueued(Evicted));
+	if (!TestTrue(TEXT("Search completes"), MultiplayerSessionsTests::WaitFor([&Sessions] { return !Sessions->IsBusy(); }, 5.0))) return false;
+
+	Sessions.SetConfig(TEXT("SearchCacheMaxStaleAge"), 60.f);
+	TestFalse(TEXT("Cached again"), Sessions->IsOperationQueued(Sessions->FindSessions(Query)));
+	Sessions->InvalidateSearchCache();
+	const int32 Invalidated = Sessions->FindSessions(Query);
+	TestTrue(TEXT("InvalidateSearchCache sends the next search to the backend"), Sessions->IsOperationQueued(Invalidated));
+	Sessions->CancelOperation(Invalidated);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMultiplayerSessionsFindAndJoinTest, "MultiplayerSessions.FindAndJoin.Completion",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FMultiplayerSessionsFindAndJoinTest::RunTest(const FString& Parameters)
+{
+	using FJoinResult = MultiplayerSessionsTests::TRecordedResult<EOnJoinSessionCompleteResult::Type>;
+	const FMultiplayerSessionQuery Query = FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::MatchType);
+	// 每种情况都必须以 FindAndJoinSession 返回的 id 恰好广播一次加入结果
+	auto TestSingleResult = [this](const TCHAR* What, const TArray<FJoinResult>& Results, int32 OperationId, EOnJoinSessionCompleteResult::Type Expected)
+	{
+		if (TestEqual(FString::Printf(TEXT("%s: one join result"), What), Results.Num(), 1))
+		{
+			TestEqual(FString::Printf(TEXT("%s: reported under the FindAndJoin id"), What), Results[0].OperationId, OperationId);
+			TestEqual(FString::Printf(TEXT("%s: result"), What), static_cast<int32>(Results[0].Result), static_cast<int32>(Expected));
+		}
+	};
+
+	{
+		TArray<FJoinResult> JoinResults;
+		MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(0, 0.01f));
+		if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+		MultiplayerSessionsTests::RecordJoinResults(*Sessions, JoinResults);
+		const int32 OperationId = Sessions->FindAndJoinSession(Query);
+		MultiplayerSessionsTests::WaitFor([&JoinResults] { return !JoinResults.IsEmpty(); }, 5.0);
+		MultiplayerSessionsTests::Settle(0.1);
+		TestSingleResult(TEXT("Nothing found"), JoinResults, OperationId, EOnJoinSessionCompleteResult::SessionDoesNotExist);
+	}
+	{
+		TArray<FJoinResult> JoinResults;
+		MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(20, 0.01f));
+		if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+		MultiplayerSessionsTests::RecordJoinResults(*Sessions, JoinResults);
+		const int32 OperationId = Sessions->FindAndJoinSession(Query);
+		MultiplayerSessionsTests::WaitFor([&JoinResults] { return !JoinResults.IsEmpty(); }, 5.0);
+		MultiplayerSessionsTests::Settle(0.1);
+		TestSingleResult(TEXT("Joined"), JoinResults, OperationId, EOnJoinSessionCompleteResult::Success);
+	}
+	{
+		TArray<FJoinResult> JoinResults;
+		MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(20, 0.1f));
+		if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+		MultiplayerSessionsTests::RecordJoinResults(*Sessions, JoinResults);
+		const int32 OperationId = Sessions->FindAndJoinSession(Query);
+		Sessions->CancelOperation(OperationId);
+		MultiplayerSessionsTests::Settle(0.3);
+		TestSingleResult(TEXT("Running search cancelled"), JoinResults, OperationId, EOnJoinSessionCompleteResult::UnknownError);
+	}
+	{
+		TArray<FJoinResult> JoinResults;
+		MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(20, 0.1f));
+		if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+		MultiplayerSessionsTests::RecordJoinResults(*Sessions, JoinResults);
+		const int32 OperationId = Sessions->FindAndJoinSession(Query);
+		Sessions->StopFindSessions();
+		MultiplayerSessionsTests::Settle(0.3);
+		TestSingleResult(TEXT("Search stopped"), JoinResults, OperationId, EOnJoinSessionCompleteResult::UnknownError);
+	}
+	{
+		TArray<FJoinResult> JoinResults;
+		MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(20, 0.1f));
+		if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+		MultiplayerSessionsTests::RecordJoinResults(*Sessions, JoinResults);
+		const int32 Running = Sessions->FindSessions(FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::OtherMatchType));
+		const int32 OperationId = Sessions->FindAndJoinSession(Query);
+		Sessions->CancelOperation(OperationId);
+		MultiplayerSessionsTests::WaitFor([&Sessions] { return !Sessions->IsBusy(); }, 5.0);
+		MultiplayerSessionsTests::Settle(0.1);
+		TestTrue(TEXT("Queued behind another search"), Running != OperationId);
+		TestSingleResult(TEXT("Queued search cancelled"), JoinResults, OperationId, EOnJoinSessionCompleteResult::UnknownError);
+	}
+	{
+		// 几乎为零的帧预算让排序分摊到很多帧，搜索完成后排序一定还在进行
+		TArray<FJoinResult> JoinResults;
+		MultiplayerSessionsTests::FTestSessions Sessions(MultiplayerSessionsTests::MakeSimulation(2000, 0.01f));
+		if (!TestTrue(TEXT("Fake backend"), Sessions.IsValid())) return false;
+		if (!TestTrue(TEXT("Processing budget is configurable"), Sessions.SetConfig(TEXT("ResultProcessingBudgetMs"), 0.000001f))) return false;
+		MultiplayerSessionsTests::RecordJoinResults(*Sessions, JoinResults);
+		const int32 OperationId = Sessions->FindAndJoinSession(Query);
+		if (!TestTrue(TEXT("Search completes"), MultiplayerSessionsTests::WaitFor([&Sessions, OperationId] { return !Sessions->IsOperationQueued(OperationId); }, 10.0))) return false;
+		TestTrue(TEXT("Still ranking"), JoinResults.IsEmpty());
+		Sessions->FindSessions(FMultiplayerSessionQuery().WithMatchType(MultiplayerSessionsTests::OtherMatchType));
+		MultiplayerSessionsTests::WaitFor([&Sessions] { return !Sessions->IsBusy(); }, 10.0);
+		MultiplayerSessionsTests::Settle(0.1);
+		TestSingleResult(TEXT("Ranking interrupted by another search"), JoinResults, OperationId, EOnJoinSessionCompleteResult::UnknownError);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Interfaces/OnlineSessionInterface.h"
+#include "OnlineSessionSettings.h"
+
+/**
+ * Knobs for FFakeOnlineSession, read from [MultiplayerSessions.FakeOnlineSession] in the game ini
+ **/
+struct MULTIPLAYERSESSIONS_API FFakeSessionSimulation
+{
+	// Simulated hosts advertised by FindSessions, on top of any added with AddHost
+	int32 NumHosts{1000};
+	// Seconds until an operation completes, plus/minus up to LatencyJitter
+	float Latency{0.15f};
+	float LatencyJitter{0.05f};
+	// 0-1, chance for any operation to complete as failed
+	float FailureRate{0.f};
+	// 0-1, chance that another client takes a slot while our join is in flight
+	float JoinRaceRate{0.f};
+	// Search results arrive in this many batches spread over the search latency
+	int32 NumSearchBatches{4};
+	int32 RandomSeed{0};
+
+	static FFakeSessionSimulation LoadFromConfig();
+};
+
+/**
+ * Deterministic in-process stand-in for a platform's session interface, for load testing offline.
+ * Completions are delayed on the core ticker, so something has to tick FTSTicker (the engine loop, or a commandlet).
+ **/
+class MULTIPLAYERSESSIONS_API FFakeOnlineSession : public IOnlineSession, public TSharedFromThis<FFakeOnlineSession, ESPMode::ThreadSafe>
+{
+public:
+	explicit FFakeOnlineSession(const FFakeSessionSimulation& InSimulation);
+
+	// Advertise a host with arbitrary settings; returns its session id
+	FString AddHost(const FOnlineSessionSettings& Settings, int32 PingInMs, int32 NumOpenPublicConnections);
+	void RemoveAllHosts();
+	int32 GetNumHosts() const { return Hosts.Num(); }
+
+	// IOnlineSession
+	virtual FUniqueNetIdPtr CreateSessionIdFromString(const FString& SessionIdStr) override;
+	virtual FNamedOnlineSession* GetNamedSession(FName SessionName) override;
+	virtual void RemoveNamedSession(FName SessionName) override;
+	virtual bool HasPresenceSession() override;
+	virtual EOnlineSessionState::Type GetSessionState(FName SessionName) const override;
+	virtual bool CreateSession(int32 HostingPlayerNum, FName SessionName, const FOnlineSessionSettings& NewSessionSettings) override;
+	virtual bool CreateSession(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& NewSessionSettings) override;
+	virtual bool StartSession(FName SessionName) override;
+	virtual bool UpdateSession(FName SessionName, FOnlineSessionSettings& UpdatedSessionSettings, bool bShouldRefreshOnlineData = true) override;
+	virtual bool EndSession(FName SessionName) override;
+	virtual bool DestroySession(FName SessionName, const FOnDestroySessionCompleteDelegate& CompletionDelegate = FOnDestroySessionCompleteDelegate()) override;
+	virtual bool IsPlayerInSession(FName SessionName, const FUniqueNetId& UniqueId) override;
+	virtual bool StartMatchmaking(const TArray<FUniqueNetIdRef>& LocalPlayers, FName SessionName, const FOnlineSessionSettings& NewSessionSettings, TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
+	virtual bool CancelMatchmaking(int32 SearchingPlayerNum, FName SessionName) override;
+	virtual bool CancelMatchmaking(const FUniqueNetId& SearchingPlayerId, FName SessionName) override;
+	virtual bool FindSessions(int32 SearchingPlayerNum, const TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
+	virtual bool FindSessions(const FUniqueNetId& SearchingPlayerId, const TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
+	virtual bool FindSessionById(const FUniqueNetId& SearchingUserId, const FUniqueNetId& SessionId, const FUniqueNetId& FriendId, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate) override;
+	virtual bool CancelFindSessions() override;
+	virtual bool PingSearchResults(const FOnlineSessionSearchResult& SearchResult) override;
+	virtual bool JoinSession(int32 LocalUserNum, FName SessionName, const FOnlineSessionSearchResult& DesiredSession) override;
+	virtual bool JoinSession(const FUniqueNetId& LocalUserId, FName SessionName, const FOnlineSessionSearchResult& DesiredSession) override;
+	virtual bool FindFriendSession(int32 LocalUserNum, const FUniqueNetId& Friend) override;
+	virtual bool FindFriendSession(const FUniqueNetId& LocalUserId, const FUniqueNetId& Friend) override;
+	virtual bool FindFriendSession(const FUniqueNetId& LocalUserId, const TArray<FUniqueNetIdRef>& FriendList) override;
+	virtual bool SendSessionInviteToFriend(int32 LocalUserNum, FName SessionName, const FUniqueNetId& Friend) override;
+	virtual bool SendSessionInviteToFriend(const FUniqueNetId& LocalUserId, FName SessionName, const FUniqueNetId& Friend) override;
+	virtual bool SendSessionInviteToFriends(int32 LocalUserNum, FName SessionName, const TArray<FUniqueNetIdRef>& Friends) override;
+	virtual bool SendSessionInviteToFriends(const FUniqueNetId& LocalUserId, FName SessionName, const TArray<FUniqueNetIdRef>& Friends) override;
+	virtual bool GetResolvedConnectString(FName SessionName, FString& ConnectInfo, FName PortType = NAME_GamePort) override;
+	virtual bool GetResolvedConnectString(const FOnlineSessionSearchResult& SearchResult, FName PortType, FString& ConnectInfo) override;
+	virtual FOnlineSessionSettings* GetSessionSettings(FName SessionName) override;
+	virtual FString GetVoiceChatRoomName(FName SessionName) override;
+	virtual bool RegisterPlayer(FName SessionName, const FUniqueNetId& PlayerId, bool bWasInvited) override;
+	virtual bool RegisterPlayers(FName SessionName, const TArray<FUniqueNetIdRef>& Players, bool bWasInvited = false) override;
+	virtual bool UnregisterPlayer(FName SessionName, const FUniqueNetId& PlayerId) override;
+	virtual bool UnregisterPlayers(FName SessionName, const TArray<FUniqueNetIdRef>& Players) override;
+	virtual void RegisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnRegisterLocalPlayerCompleteDelegate& Delegate) override;
+	virtual void UnregisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnUnregisterLocalPlayerCompleteDelegate& Delegate) override;
+	virtual void RemovePlayerFromSession(int32 LocalUserNum, FName SessionName, const FUniqueNetId& TargetPlayerId) override;
+	virtual int32 GetNumSessions() override;
+	virtual void DumpSessionState() override;
+
+protected:
+	virtual FNamedOnlineSession* AddNamedSession(FName SessionName, const FOnlineSessionSettings& SessionSettings) override;
+	virtual FNamedOnlineSession* AddNamedSession(FName SessionName, const FOnlineSession& Session) override;
+
+private:
+	struct FFakeHost
+	{
+		FOnlineSession Session;
+		int32 PingInMs{0};
+	};
+
+	// Run Completion after a simulated round trip
+	void CompleteLater(TFunction<void()> Completion, float Delay = -1.f);
+	float NextLatency();
+	bool RollFailure();
+	void SeedHosts();
+	// Every fake session gets a unique id and a 127.0.0.1 port of its own
+	TSharedRef<FOnlineSessionInfo> MakeSessionInfo();
+	bool PassesQuery(const FOnlineSessionSearch& Search, const FOnlineSession& Session) const;
+	// Sets a named session's open slots, and those of the host it advertises, so searches see the change
+	void SetNumOpenPublicConnections(FNamedOnlineSession& Session, int32 NumOpenPublicConnections);
+
+	FFakeSessionSimulation Simulation;
+	FRandomStream Random;
+	// Keyed by session id
+	TMap<FString, FFakeHost> Hosts;
+	TArray<FNamedOnlineSession> Sessions;
+	TSharedPtr<FOnlineSessionSearch> CurrentSearch;
+	// Bumped by CancelFindSessions so the batches of a cancelled search stop
+	int32 SearchSerial{0};
+	int32 NextPort{7777};
+};
@@ -5,6 +5,8 @@
 #include "CoreMinimal.h"
 #include "Blueprint/UserWidget.h"
 #include "Interfaces/OnlineSessionInterface.h"
+#include "SessionRanking.h"
+#include "MultiplayerSessionQuery.h"
 #include "Menu.generated.h"
 
 /**
@@ -27,7 +29,11 @@ protected:
 	 **/
 	UFUNCTION()
 	void OnCreateSession(bool bWasSuccessful);
-	void OnFindSessions(const TArray<FOnlineSessionSearchResult>& SessionResults, bool bWasSuccessful);
+	void OnFindSessions(TArrayView<const FSessionSummary> Summaries, bool bWasSuccessful);
+	void OnFindSessionsBatch(TArrayView<const FSessionSummary> NewSummaries);
+	void OnFindSessionsCancelled(int32 OperationId);
+	void OnServerBrowserRefreshed(bool bWasSuccessful);
+	void OnSessionCandidatesRanked(TArrayView<const FRankedSessionCandidate> RankedCandidates);
 	void OnJoinSession(EOnJoinSessionCompleteResult::Type Result);
 	UFUNCTION()
 	void OnDestroySession(bool bWasSuccessful);
@@ -39,6 +45,9 @@ private:
 	class UButton* HostButton;
 	UPROPERTY(meta = (BindWidget))
 	UButton* JoinButton;
+	// With a server browser the player picks the session; without one Join ranks the results and joins the best
+	UPROPERTY(meta = (BindWidgetOptional))
+	class UServerBrowser* ServerBrowser;
 
 	UFUNCTION()
 	void HostButtonClicked();
@@ -46,6 +55,8 @@ private:
 	void JoinButtonClicked();
 
 	void MenuTeardown();
+	// The subsystem outlives every menu, so whatever MenuSetup bound is removed again on teardown
+	void UnbindSubsystemDelegates();
 
 	// The subsystem designed to handle all online session functionality
 	class UMultiplayerSessionsSubsystem* MultiplayerSessionsSubsystem;
@@ -53,4 +64,14 @@ private:
 	int32 NumPublicConnections{4};
 	FString MatchType{TEXT("FreeForAll")};
 	FString PathToLobby{TEXT("")};
+
+	// Set by the Join button's own search, cleared once it completes, is cancelled or is stopped for an early candidate
+	bool bFindingSessions{false};
+	// Its subsystem operation, to tell when another caller cancels it
+	int32 FindOperationId{INDEX_NONE};
+	// Set when that search's results are handed to RankSessionCandidates, cleared by the ranking that follows
+	bool bRankingForJoin{false};
+
+	// A streamed result at or below this ping is good enough to stop searching and rank what we have
+	int32 EarlyJoinPingMs{60};
 };
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FOnlineSessionSearch;
+class FOnlineSessionSearchResult;
+
+/**
+ * The handful of settings we filter on, pulled out of a search result once.
+ * Kept as an array of these structs parallel to the raw results, so client-side filtering never touches
+ * FOnlineKeyValuePairs. The subsystem's FSessionSummary entries are derived from it.
+ **/
+struct MULTIPLAYERSESSIONS_API FSessionFilterKey
+{
+	FName MatchType;
+	int32 NumOpenPublicConnections{0};
+	int32 NumPublicConnections{0};
+	int32 BuildId{0};
+	int32 PingInMs{0};
+	int32 HostQuality{0};
+	// Only hosts advertising JOINABLE = 1 are, the same rule the backend applies for FMultiplayerSessionQuery::bOnlyJoinable
+	bool bJoinable{false};
+
+	static FSessionFilterKey Extract(const FOnlineSessionSearchResult& Result);
+};
+
+/**
+ * Compact copy of a matching session's FSessionFilterKey, handed to listeners instead of the raw
+ * FOnlineSessionSearchResult array: 24 bytes, or 28 in editor builds where FName also carries a display index.
+ * Only go back to the raw result (through ResultIndex) for what isn't here, e.g. to join it.
+ **/
+struct MULTIPLAYERSESSIONS_API FSessionSummary
+{
+	// Interned, comparing two of these is an integer compare
+	FName MatchType;
+	// Index into the search's SearchResults
+	int32 ResultIndex{INDEX_NONE};
+	int32 BuildId{0};
+	uint16 PingInMs{0};
+	uint16 NumOpenPublicConnections{0};
+	uint16 NumPublicConnections{0};
+	// 0-100
+	uint8 HostQuality{0};
+
+	static FSessionSummary Make(const FSessionFilterKey& Key, int32 ResultIndex);
+};
+
+/**
+ * Typed description of a session search. Everything set here is pushed into FOnlineSessionSearch::QuerySettings
+ * so the backend can filter; Matches() covers backends that ignore query settings (e.g. NULL/LAN).
+ **/
+struct MULTIPLAYERSESSIONS_API FMultiplayerSessionQuery
+{
+	// Session setting keys written by CreateSession and read back by the query
+	static const FName MatchTypeKey;
+	static const FName BuildIdKey;
+	static const FName HostQualityKey;
+	// Written by the host whenever its advertised state changes, see UMultiplayerSessionsSubsystem::SetAdvertisedMatchPhase
+	static const FName MatchPhaseKey;
+	static const FName JoinableKey;
+
+	FMultiplayerSessionQuery& WithMatchType(const FString& InMatchType) { MatchType = FName(*InMatchType); return *this; }
+	FMultiplayerSessionQuery& WithMinOpenSlots(int32 InMinOpenSlots) { MinOpenSlots = InMinOpenSlots; return *this; }
+	FMultiplayerSessionQuery& WithBuildId(int32 InBuildId) { BuildId = InBuildId; return *this; }
+	FMultiplayerSessionQuery& IncludeUnjoinable(bool bInclude = true) { bOnlyJoinable = !bInclude; return *this; }
+	FMultiplayerSessionQuery& WithKey(FName Key, const FString& Value) { CustomKeys.Emplace(Key, Value); return *this; }
+	FMultiplayerSessionQuery& WithMaxResults(int32 InMaxSearchResults) { MaxSearchResults = InMaxSearchResults; return *this; }
+	FMultiplayerSessionQuery& Streamed(bool bInStreamResults = true) { bStreamResults = bInStreamResults; return *this; }
+
+	// Push every constraint into the search's QuerySettings
+	void ApplyTo(FOnlineSessionSearch& Search) const;
+	// Client-side leftover filtering over an extracted key
+	bool Matches(const FSessionFilterKey& Key) const;
+	// Identifies queries that would return the same results; bStreamResults is not part of it
+	FString ToCacheKey() const;
+
+	// NAME_None / 0 mean "don't care"
+	FName MatchType;
+	int32 MinOpenSlots{0};
+	int32 BuildId{0};
+	// Skip sessions whose host says they are full or running a match that can't be joined
+	bool bOnlyJoinable{true};
+	// Only filtered server-side
+	TArray<TPair<FName, FString>> CustomKeys;
+
+	int32 MaxSearchResults{10000};
+	bool bStreamResults{false};
+};
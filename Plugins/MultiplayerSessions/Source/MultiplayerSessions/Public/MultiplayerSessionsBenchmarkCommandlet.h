@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MultiplayerSessionsBenchmarkCommandlet.generated.h"
+
+class FJsonObject;
+class FJsonValue;
+class UMultiplayerSessionsSubsystem;
+
+/**
+ * Headless benchmark for the session code, writes its results as JSON:
+ * UnrealEditor-Cmd MenuSystem -run=MultiplayerSessionsBenchmark -nullrhi [-Iterations=20] [-Output=<path>]
+ *
+ * Everything goes through UMultiplayerSessionsSubsystem on a standalone game instance, against FFakeOnlineSession:
+ * - Create/Find/Join/Destroy latency (as the subsystem records it) and throughput, with the configured fake latency
+ * - Search result handling cost (the subsystem's find and ranking, with a zero latency backend) and memory per search,
+ *   for 10 to 10000 results
+ **/
+UCLASS()
+class MULTIPLAYERSESSIONS_API UMultiplayerSessionsBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UMultiplayerSessionsBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	TSharedRef<FJsonObject> RunOperationBenchmarks(UMultiplayerSessionsSubsystem& Sessions, int32 Iterations);
+	TArray<TSharedPtr<FJsonValue>> RunResultHandlingBenchmarks(UMultiplayerSessionsSubsystem& Sessions, int32 Iterations);
+};
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/OnlineSessionInterface.h"
+#include "MultiplayerSessionsSoakAgent.generated.h"
+
+class AGameModeBase;
+class APlayerController;
+
+/**
+ * Runs inside every process UMultiplayerSessionsSoakCommandlet starts, and only there (-SoakRole=Host|Client).
+ * Drives the subsystem the way UMenu does and writes what it saw into -SoakDir:
+ * - Host: HostSession like the host button, then once a second frame time, players, logins and memory,
+ *   kept in memory and written once when the process exits (Host.json)
+ * - Client: find, rank and join the best candidate like the join button, then the time until the lobby
+ *   has loaded, or the failure (Client_<SoakClientIndex>.json)
+ * Every process exits on its own once the commandlet creates the stop file.
+ **/
+UCLASS()
+class MULTIPLAYERSESSIONS_API UMultiplayerSessionsSoakAgent : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Written by the host once its lobby is up; the commandlet starts the clients after it appears
+	static const TCHAR* HostReadyFileName;
+	static const TCHAR* HostReportFileName;
+	// Created by the commandlet when the soak is over; checked once a second
+	static const TCHAR* StopFileName;
+	static FString GetClientReportFileName(int32 ClientIndex);
+
+private:
+	void OnPostLoadMap(UWorld* LoadedWorld);
+	void StartHosting();
+	void StartJoining();
+	void OnJoinSessionComplete(EOnJoinSessionCompleteResult::Type Result);
+	void OnPostLogin(AGameModeBase* GameMode, APlayerController* NewPlayer);
+	bool Tick(float DeltaTime);
+	void SampleHost(double Now);
+	void WriteHostReport();
+	void WriteClientReport(bool bJoined, const FString& Result);
+
+	bool bHost{false};
+	bool bStarted{false};
+	bool bClientReported{false};
+	bool bHostReported{false};
+	FString SoakDir;
+	int32 ClientIndex{0};
+	int32 NumPublicConnections{100};
+	FString MatchType{TEXT("FreeForAll")};
+	FString LobbyPath{TEXT("/Game/ThirdPerson/Maps/Lobby")};
+
+	double StartTime{0.0};
+	double JoinStartTime{0.0};
+
+	FTSTicker::FDelegateHandle TickerHandle;
+	FDelegateHandle PostLoginHandle;
+
+	struct FHostSample
+	{
+		double Seconds{0.0};
+		double AverageFrameMs{0.0};
+		double MaxFrameMs{0.0};
+		int32 NumPlayers{0};
+		int32 NumLogins{0};
+		double UsedPhysicalMB{0.0};
+	};
+	TArray<FHostSample> HostSamples;
+	// Seconds since StartTime of every login
+	TArray<double> LoginTimes;
+	// Frames since the last sample
+	double FrameSecondsSum{0.0};
+	double FrameSecondsMax{0.0};
+	int32 NumFrames{0};
+	// Host samples and both roles look for the stop file this often
+	double LastSampleTime{0.0};
+};
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MultiplayerSessionsSoakCommandlet.generated.h"
+
+class FJsonObject;
+
+/**
+ * Soak test of the host/join flow, one listen server host and N headless clients on this machine:
+ * UnrealEditor-Cmd MenuSystem -run=MultiplayerSessionsSoak [-Clients=16] [-Seconds=120] [-Stagger=0.25] [-Output=<path>]
+ *
+ * Every process is a -game -nullrhi -nosteam instance (NULL subsystem, IpNetDriver) running UMultiplayerSessionsSoakAgent.
+ * Per-process logs and reports go to Saved/Soak/<timestamp>, the summary (join latency, client memory, login throughput,
+ * server frame time, memory growth) to Summary.json there or to -Output. When the time is up a stop file asks every
+ * process to write its report and exit; only those still running after a timeout are terminated.
+ **/
+UCLASS()
+class MULTIPLAYERSESSIONS_API UMultiplayerSessionsSoakCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UMultiplayerSessionsSoakCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	TSharedRef<FJsonObject> SummarizeClients(const FString& SoakDir, int32 NumClients) const;
+	TSharedRef<FJsonObject> SummarizeHost(const FString& SoakDir) const;
+};
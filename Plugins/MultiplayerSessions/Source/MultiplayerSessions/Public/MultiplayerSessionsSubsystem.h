@@ -5,61 +5,575 @@
 #include "CoreMinimal.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "Interfaces\OnlineSessionInterface.h"
+#include "OnlineSessionSettings.h"
+#include "Containers/Ticker.h"
+#include "Engine/EngineBaseTypes.h"
+#include "MultiplayerSessionQuery.h"
+#include "SessionRanking.h"
+#include "SessionLatencyStats.h"
+#include "FakeOnlineSession.h"
 #include "MultiplayerSessionsSubsystem.generated.h"
 
+class UNetDriver;
+
 /**
- * Declaring our own custom delegates for the Menu class to bind callbacks to 
+ * Declaring our own custom delegates for the Menu class to bind callbacks to
  **/
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMultiplayerOnSessionStateChangeComplete, bool, bWasSuccessful);
 DECLARE_MULTICAST_DELEGATE_TwoParams(FMultiplayerOnFindSessionsComplete, const TArray<FOnlineSessionSearchResult>& SessionResults, bool bWasSuccessful);
 DECLARE_MULTICAST_DELEGATE_OneParam(FMultiplayerOnJoinSessionComplete, EOnJoinSessionCompleteResult::Type Result);
+DECLARE_MULTICAST_DELEGATE_OneParam(FMultiplayerOnSessionCandidatesRanked, TArrayView<const FRankedSessionCandidate> RankedCandidates);
 
 /**
- * 
+ * One join made by JoinBestCandidate, reported whether it worked or not
+ **/
+struct FSessionJoinAttempt
+{
+	FString SessionId;
+	// Position in the ranked list, and how many times the list had been walked before
+	int32 Rank{0};
+	int32 Round{0};
+	EOnJoinSessionCompleteResult::Type Result{EOnJoinSessionCompleteResult::UnknownError};
+	double DurationMs{0.0};
+	// Since JoinBestCandidate was called, including backoff
+	double TotalMs{0.0};
+};
+DECLARE_MULTICAST_DELEGATE_OneParam(FMultiplayerOnJoinAttempt, const FSessionJoinAttempt& Attempt);
+// Broadcast while a streaming search is still running, with the indices of the newly arrived results that passed the query
+DECLARE_MULTICAST_DELEGATE_TwoParams(FMultiplayerOnFindSessionsBatch, const TArray<FOnlineSessionSearchResult>& SearchResults, TArrayView<const int32> MatchingResultIndices);
+// Compact variants of the two above: one FSessionSummary per matching result, viewing an array the subsystem owns
+DECLARE_MULTICAST_DELEGATE_TwoParams(FMultiplayerOnFindSessionSummariesComplete, TArrayView<const FSessionSummary> Summaries, bool bWasSuccessful);
+DECLARE_MULTICAST_DELEGATE_OneParam(FMultiplayerOnFindSessionSummariesBatch, TArrayView<const FSessionSummary> NewSummaries);
+// A caller's search that was stopped or cancelled, queued or running; it gets no completion broadcast
+DECLARE_MULTICAST_DELEGATE_OneParam(FMultiplayerOnFindSessionsCancelled, int32 OperationId);
+
+enum class EHostPipelineStage : uint8
+{
+	// CreateSession completed on the backend
+	SessionCreated,
+	// The lobby map finished loading in the background
+	LobbyLoaded,
+	// Both of the above are done and ServerTravel was issued
+	TravelStarted,
+	Failed
+};
+// Fired as each stage of HostSession completes, with the time since HostSession was called
+DECLARE_MULTICAST_DELEGATE_TwoParams(FMultiplayerOnHostStage, EHostPipelineStage Stage, double SecondsSinceHost);
+
+enum class ESessionOperationType : uint8
+{
+	Create,
+	Find,
+	Join,
+	Destroy,
+	Start,
+	End,
+	Update
+};
+
+// Advertised in the session settings so searches can skip matches that can't be joined
+enum class EMultiplayerMatchPhase : uint8
+{
+	Lobby,
+	InProgress,
+	Ended
+};
+
+/**
+ *
  */
-UCLASS()
+UCLASS(config=Game)
 class MULTIPLAYERSESSIONS_API UMultiplayerSessionsSubsystem : public UGameInstanceSubsystem
 {
 	GENERATED_BODY()
 public:
 	UMultiplayerSessionsSubsystem();
 
-	// To handle session functionality. The Menu class will call these
-	void CreateSession(int32 NumPublicConnections, FString MatchType);
-	void FindSessions(int32 MaxSearchResults);
-	void JoinSession(const FOnlineSessionSearchResult& SessionResult);
-	void DestroySession();
-	void StartSession();
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/**
+	 * To handle session functionality. The Menu class will call these.
+	 * Every call is queued and runs once the operations before it have completed; the returned id can be
+	 * passed to CancelOperation. A call identical to one that is still queued or running returns that one's id.
+	 **/
+	// MapName is advertised so joining clients can start loading it before the join completes
+	int32 CreateSession(int32 NumPublicConnections, FString MatchType, FString MapName = FString());
+	/**
+	 * Creates the session and loads the lobby map at the same time, then ServerTravels to TravelURL
+	 * as soon as both are done. MultiplayerOnCreateSessionCompleteDelegate still fires for the create.
+	 **/
+	int32 HostSession(int32 NumPublicConnections, FString MatchType, const FString& TravelURL);
+	/**
+	 * With Query.bStreamResults, the in-flight search is polled and new matching results are sent out through
+	 * MultiplayerOnFindSessionsBatchDelegate before the whole search has finished.
+	 **/
+	int32 FindSessions(const FMultiplayerSessionQuery& Query);
+	int32 FindSessions(int32 MaxSearchResults, bool bStreamResults = false);
+	// Drop every cached search so the next FindSessions goes to the backend
+	void InvalidateSearchCache() { SearchCache.Reset(); }
+	/**
+	 * Stops the in-flight search early, e.g. once a streamed batch contained a usable result.
+	 * MultiplayerOnFindSessionsCompleteDelegate is not broadcast for a stopped search, MultiplayerOnFindSessionsCancelledDelegate is.
+	 **/
+	void StopFindSessions();
+	bool IsFindingSessions() const { return LastSessionSearch.IsValid() && LastSessionSearch->SearchState == EOnlineAsyncTaskState::InProgress; }
+	// Indices into the last search's results that passed the client-side leftover filter
+	const TArray<int32>& GetMatchingResultIndices() const { return MatchingResultIndices; }
+	// Parallel to the last search's results
+	const TArray<FSessionFilterKey>& GetSessionFilterKeys() const { return SessionFilterKeys; }
+	// One per matching result of the last search, in the same order as GetMatchingResultIndices()
+	TArrayView<const FSessionSummary> GetSessionSummaries() const { return SessionSummaries; }
+	/**
+	 * Changes whenever the summaries stop being the previous ones plus newly appended entries: a new or cached
+	 * search replaced them, or a session was pruned. Listeners that copy them incrementally start over then.
+	 **/
+	int32 GetSessionSummariesSerial() const { return SessionSummariesSerial; }
+	// The raw result behind a summary, nullptr once that search has been replaced
+	const FOnlineSessionSearchResult* GetSearchResult(int32 ResultIndex) const;
+	/**
+	 * Order the last search's matching results by ping, open slots and host quality.
+	 * On LAN the top candidates are probed first; MultiplayerOnSessionCandidatesRankedDelegate fires when done.
+	 * The top candidates' connect strings are resolved and the best one's advertised map is preloaded here,
+	 * ahead of the join.
+	 **/
+	void RankSessionCandidates();
+	const TArray<FRankedSessionCandidate>& GetRankedCandidates() const { return RankedCandidates; }
+	/**
+	 * Joins and, on success, ClientTravels straight away using the connect string resolved during ranking,
+	 * before MultiplayerOnJoinSessionCompleteDelegate is broadcast.
+	 * Returns false once Rank runs past the end of the ranked list.
+	 **/
+	bool JoinRankedCandidate(int32 Rank);
+	/**
+	 * Joins the ranked candidates of the last ranking in order until one works, travelling like JoinRankedCandidate.
+	 * A full, vanished or unresolvable session moves on to the next candidate right away; once the list runs out
+	 * it is walked again after a jittered exponential backoff, up to MaxJoinRounds times.
+	 * MultiplayerOnJoinSessionCompleteDelegate fires once, with the final result; MultiplayerOnJoinAttemptDelegate for every try.
+	 * Works on a copy of the candidates, so a search started meanwhile doesn't disturb it.
+	 **/
+	bool JoinBestCandidate();
+	/**
+	 * FindSessions, RankSessionCandidates and JoinBestCandidate in one go, for callers that don't drive the steps.
+	 * A search that finds nothing reports SessionDoesNotExist through MultiplayerOnJoinSessionCompleteDelegate.
+	 * A search that is cancelled, or whose ranking is cut short by another search or ranking, reports UnknownError,
+	 * so the caller always gets exactly one join result.
+	 **/
+	int32 FindAndJoinSession(const FMultiplayerSessionQuery& Query);
+	void StopJoinAttempts();
+	bool IsJoiningCandidates() const { return JoinRetry.IsSet(); }
+	// Joins the last search's result with this session id and travels like JoinRankedCandidate; the operation id, INDEX_NONE if it is gone
+	int32 JoinSearchResult(const FString& SessionId);
+	// Replace the latency probe, e.g. with one reporting fake latencies in tests
+	void SetLatencyProbe(TSharedPtr<ISessionLatencyProbe> InLatencyProbe) { LatencyProbe = InLatencyProbe; }
+	/**
+	 * Switch to a fresh FFakeOnlineSession with these knobs whatever the config says, e.g. for the benchmark commandlet.
+	 * Only while no operation is queued or running; returns false otherwise.
+	 **/
+	bool UseFakeOnlineSession(const FFakeSessionSimulation& Simulation);
+	int32 JoinSession(const FOnlineSessionSearchResult& SessionResult);
+	int32 DestroySession();
+	int32 StartSession();
+	int32 EndSession();
+	// Push LastSessionSettings to the backend; an update still queued picks up every change made before it runs
+	int32 UpdateSession();
+
+	/**
+	 * Host side: what the advertised session says about the match. Changes are folded together and pushed with
+	 * one UpdateSession SessionUpdateDebounce seconds after the first of them, so a burst of logins costs one update.
+	 * Changes made before the session exists are pushed once its create completes.
+	 * Entering InProgress starts the session, leaving it ends it.
+	 **/
+	void SetAdvertisedPlayerCount(int32 NumPlayers);
+	void SetAdvertisedMatchPhase(EMultiplayerMatchPhase Phase);
+	EMultiplayerMatchPhase GetAdvertisedMatchPhase() const { return AdvertisedMatchPhase; }
 
 	/**
-	 * Our own custom delegates for the Menu class to bind callbacks to 
+	 * A queued operation is dropped. A running one completes silently: its delegate is not broadcast,
+	 * and a running search is cancelled on the backend.
+	 **/
+	bool CancelOperation(int32 OperationId);
+	bool IsOperationQueued(int32 OperationId) const;
+	/**
+	 * While a completion delegate is broadcast: the id of the operation it reports, as returned when it was started.
+	 * For FindAndJoinSession that is the search's id, also for the join it ends with. INDEX_NONE otherwise,
+	 * e.g. for a JoinBestCandidate called directly.
+	 **/
+	int32 GetBroadcastingOperationId() const { return BroadcastingOperationId; }
+	bool IsBusy() const { return ActiveOperation.IsSet() || !PendingOperations.IsEmpty(); }
+
+	// Rolling latency of every operation and of travel; "MultiplayerSessions.DumpStats" prints it
+	const FSessionLatencyStats& GetLatencyStats() const { return LatencyStats; }
+	void ResetLatencyStats() { LatencyStats.Reset(); }
+
+	/**
+	 * Our own custom delegates for the Menu class to bind callbacks to
 	 **/
 	FMultiplayerOnSessionStateChangeComplete MultiplayerOnCreateSessionCompleteDelegate;
+	FMultiplayerOnHostStage MultiplayerOnHostStageDelegate;
 	FMultiplayerOnFindSessionsComplete MultiplayerOnFindSessionsCompleteDelegate;
+	FMultiplayerOnFindSessionsBatch MultiplayerOnFindSessionsBatchDelegate;
+	FMultiplayerOnFindSessionSummariesComplete MultiplayerOnFindSessionSummariesCompleteDelegate;
+	FMultiplayerOnFindSessionSummariesBatch MultiplayerOnFindSessionSummariesBatchDelegate;
+	FMultiplayerOnFindSessionsCancelled MultiplayerOnFindSessionsCancelledDelegate;
+	FMultiplayerOnSessionCandidatesRanked MultiplayerOnSessionCandidatesRankedDelegate;
 	FMultiplayerOnJoinSessionComplete MultiplayerOnJoinSessionCompleteDelegate;
+	FMultiplayerOnJoinAttempt MultiplayerOnJoinAttemptDelegate;
 	FMultiplayerOnSessionStateChangeComplete MultiplayerOnDestroySessionCompleteDelegate;
 	FMultiplayerOnSessionStateChangeComplete MultiplayerOnStartSessionCompleteDelegate;
+	FMultiplayerOnSessionStateChangeComplete MultiplayerOnEndSessionCompleteDelegate;
+	FMultiplayerOnSessionStateChangeComplete MultiplayerOnUpdateSessionCompleteDelegate;
 
 	void GetResolvedConnectString(const FName& SessionName, FString& Address);
 protected:
 	/**
 	 * Internal callbacks for the delegates we'll add to the Online Session Interface delegate list.
-	 * These don't need to be called outside this class.
+	 * These don't need to be called outside this class; they find out which operation the reply belongs to
+	 * and hand it to the matching Complete* below.
 	 **/
 	void OnCreateSessionComplete(FName SessionName, bool bWasSuccessful);
 	void OnFindSessionsComplete(bool bWasSuccessful);
 	void OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result);
 	void OnDestroySessionComplete(FName SessionName, bool bWasSuccessful);
 	void OnStartSessionComplete(FName SessionName, bool bWasSuccessful);
-	
+	void OnEndSessionComplete(FName SessionName, bool bWasSuccessful);
+	void OnUpdateSessionComplete(FName SessionName, bool bWasSuccessful);
+
 private:
+	// Complete the operation with this id if it is still the running one
+	void CompleteCreateSession(int32 OperationId, bool bWasSuccessful);
+	void CompleteJoinSession(int32 OperationId, EOnJoinSessionCompleteResult::Type Result);
+	void CompleteSessionStateChange(ESessionOperationType Type, int32 OperationId, bool bWasSuccessful);
+
+	/**
+	 * One queued call against the Online Session Interface
+	 **/
+	struct FSessionOperation
+	{
+		int32 Id{INDEX_NONE};
+		ESessionOperationType Type{ESessionOperationType::Find};
+		// Operations of the same type with the same key are coalesced
+		FString CoalesceKey;
+		double StartTime{0.0};
+		// Still running on the backend, but nobody wants the result anymore
+		bool bCancelled{false};
+		// Find only: silent cache revalidation
+		bool bBackground{false};
+		// Find only: started by FindAndJoinSession, ranks and joins the best result when done
+		bool bJoinBest{false};
+		// Create only: an existing session was already destroyed once for this create
+		bool bDestroyedExistingSession{false};
+
+		int32 NumPublicConnections{0};
+		FString MatchType;
+		FString MapName;
+		FMultiplayerSessionQuery Query;
+		FOnlineSessionSearchResult JoinTarget;
+		// Join only: ClientTravel as soon as the join succeeds, to ConnectString if it was resolved ahead
+		bool bTravelOnJoin{false};
+		FString ConnectString;
+		// Join only: started by JoinBestCandidate, which decides what to do with the result
+		bool bJoinRetry{false};
+		int32 CandidateRank{INDEX_NONE};
+	};
+	int32 EnqueueOperation(FSessionOperation&& Operation);
+	int32 EnqueueFindSessions(const FMultiplayerSessionQuery& Query, bool bJoinBest);
+	// Start queued operations until one of them is left running on the backend
+	void PumpOperationQueue();
+	void ExecuteActiveOperation();
+	void ExecuteCreateSession();
+	void ExecuteFindSessions();
+	void ExecuteJoinSession();
+	void ExecuteDestroySession();
+	void ExecuteStartSession();
+	void ExecuteEndSession();
+	void ExecuteUpdateSession();
+	/**
+	 * Removes the running operation if it has this type (and this id, unless INDEX_NONE).
+	 * Completion callbacks use it to find out whether the result is still wanted.
+	 **/
+	bool TakeActiveOperation(ESessionOperationType Type, int32 OperationId, FSessionOperation& OutOperation);
+	/**
+	 * Session interface replies carry no request id, so every call we make records whose reply the next one of
+	 * its type is. A reply for an operation that already timed out is then swallowed instead of completing
+	 * whatever operation of the same type runs by the time it arrives.
+	 **/
+	struct FAwaitedReply
+	{
+		ESessionOperationType Type{ESessionOperationType::Find};
+		int32 OperationId{INDEX_NONE};
+		double DispatchTime{0.0};
+	};
+	// Make the active operation's call; fails the operation if the call did not go through and nothing replied
+	void DispatchActiveOperation(TFunctionRef<bool()> Call);
+	// Id of the operation the oldest outstanding reply of this type belongs to, INDEX_NONE if none is expected
+	int32 TakeAwaitedReply(ESessionOperationType Type);
+	// Completes the running operation with a failure result
+	void FailActiveOperation();
+	bool TickOperationTimeout(float DeltaTime);
+	float GetOperationTimeout(ESessionOperationType Type) const;
+	// Called by every completion, and by CancelOperation for a running search, with the operation it took off the queue
+	void RecordOperationLatency(const FSessionOperation& Operation, bool bSucceeded, int32 ResultCode = 0, int32 ResultCount = 0, bool bCancelled = false);
+	void BeginTravelLatency();
+	void EndTravelLatency(bool bSucceeded, int32 ResultCode = 0);
+	void OnTravelFailure(UWorld* World, ETravelFailure::Type FailureType, const FString& ErrorString);
+	void OnNetworkFailure(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString);
+	// NULL subsystem, or no subsystem at all (fake backend)
+	bool IsLanSubsystem() const;
+	// The first local player's net id; null on a dedicated server or before that player has logged in,
+	// except on the fake backend, which doesn't check identities and gets a stand-in id instead
+	FUniqueNetIdPtr GetLocalUserId() const;
+	/**
+	 * The session interface is looked up the first time an operation needs it, not in Initialize, and looked up
+	 * again after every map load in case the world now resolves to another online subsystem instance (e.g. PIE).
+	 * Our completion delegates move along with it.
+	 **/
+	void BindOnlineSession();
+	void UnbindOnlineSession();
+
+	/**
+	 * Advertised host state, written into LastSessionSettings when the debounce timer fires
+	 **/
+	void ScheduleAdvertisedStateUpdate();
+	void FlushAdvertisedState();
+	void WriteAdvertisedState(FOnlineSessionSettings& Settings) const;
+	bool IsAdvertisedSessionJoinable() const;
+
+	/**
+	 * Streaming search: poll LastSessionSearch and broadcast whatever arrived since the last poll
+	 **/
+	bool TickStreamingSearch(float DeltaTime);
+	void StopStreamingSearch();
+	/**
+	 * Extract filter keys for results that arrived since the last call and filter them against LastQuery.
+	 * Stops once BudgetSeconds (0 for no limit) is used up; returns whether every result has been processed.
+	 **/
+	bool ProcessNewSearchResults(bool bBroadcastBatch, double BudgetSeconds);
+	// Rebuild SessionSummaries from MatchingResultIndices and SessionFilterKeys, keeping the first FirstMatch
+	void SyncSessionSummaries(int32 FirstMatch);
+	/**
+	 * Once the backend is done, the remaining results are processed a frame budget at a time;
+	 * the find operation completes (and is broadcast) after the last slice
+	 **/
+	void BeginResultProcessing(int32 OperationId, bool bWasSuccessful);
+	bool TickResultProcessing(float DeltaTime, int32 OperationId, bool bWasSuccessful);
+	void StopResultProcessing();
+	// Start the online search for Query, filling LastSessionSearch
+	bool StartSearch(const FMultiplayerSessionQuery& Query);
+	void CancelSearch();
+	void CompleteFindSessions(int32 OperationId, bool bWasSuccessful);
+
+	/**
+	 * Search result cache, keyed by FMultiplayerSessionQuery::ToCacheKey()
+	 **/
+	struct FCachedSessionSearch
+	{
+		FMultiplayerSessionQuery Query;
+		TSharedPtr<FOnlineSessionSearch> Search;
+		TArray<FSessionFilterKey> FilterKeys;
+		TArray<int32> MatchingResultIndices;
+		double CompletedTime{0.0};
+		double LastRequestTime{0.0};
+	};
+	void ServeCachedSearch(const FCachedSessionSearch& Cached, bool bStreamResults);
+	void StoreSearchInCache();
+	// Timer callback: evict expired entries and revalidate the most recently requested stale one
+	void RefreshSearchCache();
+	// Remove a session that turned out to be full or gone from every cached search
+	void InvalidateCachedSession(const FString& SessionId);
+
+	// Candidates are scored a frame budget at a time, then sorted and probed in one go
+	bool TickRankSessionCandidates(float DeltaTime, int32 InRankingId);
+	void SortAndProbeCandidates();
+	// RankSessionCandidates, then JoinBestCandidate for the FindAndJoinSession JoinBestRequestId unless it is INDEX_NONE
+	void StartRanking(int32 JoinBestRequestId);
+	// Drops a ranking in progress, including its outstanding probes; a FindAndJoinSession waiting for it fails
+	void StopRanking();
+	void OnCandidateProbed(int32 PingInMs, int32 RankingId, int32 ResultIndex);
+	void FinishRanking();
+
+	/**
+	 * Host pipeline: CreateSession and the lobby map load run side by side
+	 **/
+	struct FHostPipeline
+	{
+		// INDEX_NONE while CreateSession is still being queued
+		int32 CreateOperationId{INDEX_NONE};
+		FString TravelURL;
+		FName LobbyPackageName;
+		double StartTime{0.0};
+		bool bSessionCreated{false};
+		bool bLobbyLoaded{false};
+	};
+	void OnLobbyPackageLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result);
+	// Report Stage and travel once both halves are done
+	void AdvanceHostPipeline(EHostPipelineStage Stage);
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	// Join fast path: start loading the map a candidate's host advertises
+	void PreloadCandidateMap(const FOnlineSessionSearchResult& SearchResult);
+	void OnCandidateMapLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result);
+	void TravelToJoinedSession(const FString& PreResolvedConnectString);
+
+	/**
+	 * Join retry engine, see JoinBestCandidate
+	 **/
+	struct FJoinRetryState
+	{
+		// Copies, so a new search doesn't pull them out from under us
+		TSharedPtr<FOnlineSessionSearch> Search;
+		TArray<FRankedSessionCandidate> Candidates;
+		// Candidates that reported SessionDoesNotExist are not tried again in later rounds
+		TBitArray<> GoneCandidates;
+		int32 NextRank{0};
+		int32 Round{0};
+		// The join in flight, INDEX_NONE while backing off
+		int32 OperationId{INDEX_NONE};
+		double StartTime{0.0};
+		double AttemptStartTime{0.0};
+		EOnJoinSessionCompleteResult::Type LastResult{EOnJoinSessionCompleteResult::UnknownError};
+		// Reported as the broadcasting operation with the final result
+		int32 RequestId{INDEX_NONE};
+	};
+	bool StartJoinRetry(int32 RequestId);
+	int32 EnqueueCandidateJoin(const FOnlineSessionSearchResult& SearchResult, const FRankedSessionCandidate& Candidate, int32 Rank, bool bJoinRetry);
+	void TryNextJoinCandidate();
+	void HandleJoinRetryResult(const FSessionOperation& Operation, EOnJoinSessionCompleteResult::Type Result);
+	// Back off and walk the list again, or give up once MaxJoinRounds is reached
+	void ScheduleJoinRetryRound();
+	void FinishJoinRetry(EOnJoinSessionCompleteResult::Type Result);
+
 	IOnlineSessionPtr OnlineSessionPtr;
+	// Resolved once in Initialize from bUseFakeOnlineSession and -FakeOnlineSession
+	bool bUseFakeBackend{false};
+	// What the fake backend is created with: the config, unless UseFakeOnlineSession said otherwise
+	FFakeSessionSimulation FakeSimulation;
 	TSharedPtr<FOnlineSessionSettings> LastSessionSettings;
 	TSharedPtr<FOnlineSessionSearch> LastSessionSearch;
+	FMultiplayerSessionQuery LastQuery;
+	// Parallel to LastSessionSearch->SearchResults
+	TArray<FSessionFilterKey> SessionFilterKeys;
+	TArray<int32> MatchingResultIndices;
+	// Derived from the two above by SyncSessionSummaries, parallel to MatchingResultIndices;
+	// Reset, not freed, between searches so the allocation is reused
+	TArray<FSessionSummary> SessionSummaries;
+	int32 SessionSummariesSerial{0};
+
+	TMap<FString, FCachedSessionSearch> SearchCache;
+	FTimerHandle SearchCacheRefreshTimerHandle;
+	FString LastJoinSessionId;
+
+	TArray<FRankedSessionCandidate> RankedCandidates;
+	TSharedPtr<ISessionLatencyProbe> LatencyProbe;
+	// Bumped for every ranking so late probe replies for an older ranking are ignored
+	int32 RankingId{0};
+	int32 NumPendingProbes{0};
+	FTSTicker::FDelegateHandle RankingTickerHandle;
+	// The FindAndJoinSession whose search started the running ranking, INDEX_NONE if none did
+	int32 JoinBestWhenRankedId{INDEX_NONE};
+	// Fails the FindAndJoinSession waiting for the running ranking, if any, with a join result under its id
+	void DropJoinBestWhenRanked();
+	void BroadcastJoinBestFailure(int32 RequestId, EOnJoinSessionCompleteResult::Type Result);
+
+	TOptional<FJoinRetryState> JoinRetry;
+	FTimerHandle JoinRetryTimerHandle;
+
+	TOptional<FHostPipeline> HostPipeline;
+	// Keeps the preloaded lobby from being garbage collected before ServerTravel picks it up
+	UPROPERTY()
+	TObjectPtr<UPackage> PreloadedLobbyPackage;
+	// Same for the map of the session we are most likely about to join
+	UPROPERTY()
+	TObjectPtr<UPackage> PreloadedJoinPackage;
+	FName PreloadingJoinPackageName;
+	FDelegateHandle PostLoadMapDelegateHandle;
+
+	TOptional<FSessionOperation> ActiveOperation;
+	TArray<FSessionOperation> PendingOperations;
+	// Oldest first
+	TArray<FAwaitedReply> AwaitedReplies;
+	int32 NextOperationId{1};
+	bool bPumpingOperationQueue{false};
+	int32 BroadcastingOperationId{INDEX_NONE};
+	FTSTicker::FDelegateHandle OperationTimeoutTickerHandle;
+
+	FSessionLatencyStats LatencyStats;
+	// 0 while no travel is in flight
+	double TravelStartTime{0.0};
+	FDelegateHandle TravelFailureDelegateHandle;
+	FDelegateHandle NetworkFailureDelegateHandle;
+
+	int32 AdvertisedNumPlayers{0};
+	EMultiplayerMatchPhase AdvertisedMatchPhase{EMultiplayerMatchPhase::Lobby};
+	// Changed since the last push; stays set while there is no session to push it to
+	bool bAdvertisedStateDirty{false};
+	FTimerHandle AdvertisedStateTimerHandle;
+
+	// Cached results younger than this are served without asking the backend
+	UPROPERTY(Config)
+	float SearchCacheTTL{10.f};
+	// Stale results are still served (and revalidated in the background) up to this age, then evicted
+	UPROPERTY(Config)
+	float SearchCacheMaxStaleAge{60.f};
+	UPROPERTY(Config)
+	float SearchCacheRefreshInterval{5.f};
+
+	/**
+	 * Join candidate ranking, see FSessionRankingWeights
+	 **/
+	UPROPERTY(Config)
+	float RankingPingWeight{1.f};
+	UPROPERTY(Config)
+	float RankingOpenSlotsWeight{50.f};
+	UPROPERTY(Config)
+	float RankingHostQualityWeight{0.5f};
+	// How many of the best candidates get an active latency probe on LAN
+	UPROPERTY(Config)
+	int32 NumCandidatesToProbe{4};
+	UPROPERTY(Config)
+	float LatencyProbeTimeout{1.f};
+	// How many of the best candidates get their connect string resolved during ranking
+	UPROPERTY(Config)
+	int32 NumCandidatesToPreResolve{4};
+	/**
+	 * JoinBestCandidate: how many times the candidate list is walked, and the backoff between two walks,
+	 * doubled every round and jittered down by up to half so clients that failed together don't retry together
+	 **/
+	UPROPERTY(Config)
+	int32 MaxJoinRounds{3};
+	UPROPERTY(Config)
+	float JoinRetryBackoffBase{0.5f};
+	UPROPERTY(Config)
+	float JoinRetryBackoffMax{8.f};
+	// Advertised to clients when hosting, 0-100
+	UPROPERTY(Config)
+	int32 AdvertisedHostQuality{50};
+	// Whether clients may still find and join a session once its match has started
+	UPROPERTY(Config)
+	bool bAllowJoinInProgress{false};
+	// Seconds advertised state changes are collected for before they are pushed with one UpdateSession
+	UPROPERTY(Config)
+	float SessionUpdateDebounce{1.f};
+
+	// Seconds before a running operation is given up on and completed as failed
+	UPROPERTY(Config)
+	float OperationTimeout{20.f};
+	UPROPERTY(Config)
+	float FindOperationTimeout{60.f};
+	// How many of the most recent samples per operation the percentiles are computed over
+	UPROPERTY(Config)
+	int32 LatencyStatsWindow{256};
+	// Milliseconds per frame spent extracting, filtering and scoring search results, 0 for no limit
+	UPROPERTY(Config)
+	float ResultProcessingBudgetMs{2.f};
+	// Use FFakeOnlineSession instead of the platform's session interface, also enabled by -FakeOnlineSession
+	UPROPERTY(Config)
+	bool bUseFakeOnlineSession{false};
 
 	/**
 	 * To add to the Online Session Interface delegate list.
-	 * We'll bind our MultiplayerSessionsSubsystem internal callbacks to these.
+	 * We'll bind our MultiplayerSessionsSubsystem internal callbacks to these once, in Initialize;
+	 * the operation queue decides which call a completion belongs to.
 	 **/
 	FOnCreateSessionCompleteDelegate OnCreateSessionCompleteDelegate;
 	FDelegateHandle OnCreateSessionCompleteDelegateHandle;
@@ -71,8 +585,15 @@ private:
 	FDelegateHandle OnDestroySessionCompleteDelegateHandle;
 	FOnStartSessionCompleteDelegate OnStartSessionCompleteDelegate;
 	FDelegateHandle OnStartSessionCompleteDelegateHandle;
+	FOnEndSessionCompleteDelegate OnEndSessionCompleteDelegate;
+	FDelegateHandle OnEndSessionCompleteDelegateHandle;
+	FOnUpdateSessionCompleteDelegate OnUpdateSessionCompleteDelegate;
+	FDelegateHandle OnUpdateSessionCompleteDelegateHandle;
 
-	bool bCreateSessionOnDestroy{false};
-	int32 LastNumPublicConnections;
-	FString LastMatchType;
+	FTSTicker::FDelegateHandle StreamingSearchTickerHandle;
+	// Seconds between two polls of an in-flight streaming search
+	float StreamingSearchPollInterval{0.05f};
+	FTSTicker::FDelegateHandle ResultProcessingTickerHandle;
+	// How many results are processed between two looks at the clock
+	static constexpr int32 ResultsPerBudgetCheck{32};
 };
@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blueprint/UserWidget.h"
+#include "MultiplayerSessionQuery.h"
+#include "ServerBrowser.generated.h"
+
+class UListView;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnServerBrowserRefreshComplete, bool bWasSuccessful);
+
+UENUM(BlueprintType)
+enum class ESessionBrowserSortColumn : uint8
+{
+	Ping,
+	Players,
+	HostQuality,
+	HostName
+};
+
+/**
+ * What the browser keeps per session, copied out of the search result once when it streams in
+ **/
+struct MULTIPLAYERSESSIONS_API FSessionBrowserRow
+{
+	FString SessionId;
+	FString OwningUserName;
+	FName MatchType;
+	int32 PingInMs{0};
+	int32 NumOpenPublicConnections{0};
+	int32 NumPublicConnections{0};
+	int32 HostQuality{0};
+};
+
+/**
+ * Filter and sort settings, copied into the background task that orders the rows
+ **/
+USTRUCT(BlueprintType)
+struct MULTIPLAYERSESSIONS_API FSessionBrowserView
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ESessionBrowserSortColumn SortColumn{ESessionBrowserSortColumn::Ping};
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bAscending{true};
+	// Case-insensitive substring of the host name, empty for all
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString HostNameFilter;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bHideFull{false};
+	// 0 for no limit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 MaxPingMs{0};
+};
+
+/**
+ * List item for one row. Items are pooled by row index and reused across searches, so the list view
+ * never sees more UObjects than the largest search had rows.
+ **/
+UCLASS(BlueprintType)
+class MULTIPLAYERSESSIONS_API USessionBrowserItem : public UObject
+{
+	GENERATED_BODY()
+public:
+	// Valid while the browser holds the search this item was bound to
+	const FSessionBrowserRow* GetRow() const;
+
+	UFUNCTION(BlueprintPure)
+	FString GetOwningUserName() const;
+	UFUNCTION(BlueprintPure)
+	int32 GetPingInMs() const;
+	UFUNCTION(BlueprintPure)
+	int32 GetNumPlayers() const;
+	UFUNCTION(BlueprintPure)
+	int32 GetMaxPlayers() const;
+
+private:
+	friend class UServerBrowser;
+
+	TWeakObjectPtr<UServerBrowser> Browser;
+	int32 RowIndex{INDEX_NONE};
+};
+
+/**
+ * Server list over a virtualized UListView: only the entries on screen get a widget (see USessionBrowserEntry),
+ * the rows themselves live in immutable batches appended as the subsystem streams results in,
+ * and filtering/sorting runs on a worker thread over those batches.
+ **/
+UCLASS()
+class MULTIPLAYERSESSIONS_API UServerBrowser : public UUserWidget
+{
+	GENERATED_BODY()
+public:
+	// Clear the list and start a streamed search with Query
+	void Refresh(const FMultiplayerSessionQuery& Query);
+	bool IsRefreshing() const { return bSearching; }
+	// Once the search Refresh started has completed, failed or was cancelled
+	FOnServerBrowserRefreshComplete OnRefreshComplete;
+	UFUNCTION(BlueprintCallable)
+	void SetView(const FSessionBrowserView& InView);
+	UFUNCTION(BlueprintPure)
+	const FSessionBrowserView& GetView() const { return View; }
+	// Join the selected row, travelling on success
+	UFUNCTION(BlueprintCallable)
+	bool JoinSelected();
+
+	int32 GetNumRows() const { return NumRows; }
+	int32 GetNumVisibleRows() const { return VisibleItems.Num(); }
+	const FSessionBrowserRow* GetRow(int32 RowIndex) const;
+
+protected:
+	virtual void NativeConstruct() override;
+	virtual void NativeDestruct() override;
+
+	void OnFindSessionsBatch(TArrayView<const FSessionSummary> NewSummaries);
+	void OnFindSessions(TArrayView<const FSessionSummary> Summaries, bool bWasSuccessful);
+	void OnFindSessionsCancelled(int32 OperationId);
+	void OnItemDoubleClicked(UObject* Item);
+
+private:
+	using FRowBatch = TArray<FSessionBrowserRow>;
+	using FRowBatchRef = TSharedRef<const FRowBatch, ESPMode::ThreadSafe>;
+
+	UPROPERTY(meta = (BindWidget))
+	UListView* SessionList;
+
+	// Copy the subsystem's matching results we haven't seen yet into a new batch
+	void IngestNewResults();
+	// Drop every row and what the list view shows
+	void ResetRows();
+	// Filter and sort on a worker; at most one task in flight, later requests are folded into a rerun
+	void RequestViewUpdate();
+	void ApplyViewUpdate(int32 Serial, TArray<int32>&& RowOrder);
+	USessionBrowserItem* GetOrCreateItem(int32 RowIndex);
+
+	class UMultiplayerSessionsSubsystem* MultiplayerSessionsSubsystem;
+
+	FSessionBrowserView View;
+	// Rows are never modified after ingest, so the sort task can read them while new batches are appended
+	TArray<FRowBatchRef> RowBatches;
+	// Index of the first row of each batch
+	TArray<int32> RowBatchStarts;
+	int32 NumRows{0};
+	// Matching results of the current search already ingested
+	int32 NumIngestedMatches{0};
+	// The subsystem's summaries serial they were ingested from; once it moves on the rows are rebuilt from scratch
+	int32 IngestedSummariesSerial{INDEX_NONE};
+	bool bSearching{false};
+	// The subsystem operation behind bSearching, INDEX_NONE while it completed synchronously
+	int32 SearchOperationId{INDEX_NONE};
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<USessionBrowserItem>> ItemPool;
+	// What the list view currently shows, in order
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UObject>> VisibleItems;
+
+	// Bumped by Refresh so a sort of the previous search is dropped
+	int32 ViewSerial{0};
+	bool bViewTaskInFlight{false};
+	bool bViewDirty{false};
+};
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "Interfaces/OnlineSessionInterface.h"
+#include "MultiplayerSessionQuery.h"
+#include "SessionAsyncActions.generated.h"
+
+class UMultiplayerSessionsSubsystem;
+
+/**
+ * What Blueprint gets per search result, copied out of FSessionSummary
+ **/
+USTRUCT(BlueprintType)
+struct MULTIPLAYERSESSIONS_API FBlueprintSessionResult
+{
+	GENERATED_BODY()
+
+	// Pass to Join Session
+	UPROPERTY(BlueprintReadOnly)
+	FString SessionId;
+	UPROPERTY(BlueprintReadOnly)
+	FString OwningUserName;
+	UPROPERTY(BlueprintReadOnly)
+	FName MatchType;
+	UPROPERTY(BlueprintReadOnly)
+	int32 PingInMs{0};
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumPlayers{0};
+	UPROPERTY(BlueprintReadOnly)
+	int32 MaxPlayers{0};
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FSessionActionComplete);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FFindSessionsActionComplete, const TArray<FBlueprintSessionResult>&, Results);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FJoinSessionActionComplete, const FString&, Result);
+
+/**
+ * Base of the session nodes: finds the subsystem, and keeps it bound only between Activate and the one result,
+ * so nodes that are fired over and over never pile up listeners on the subsystem. The subsystem's delegates report
+ * every caller's operations, a node only takes the result of the operation it started.
+ **/
+UCLASS(Abstract)
+class MULTIPLAYERSESSIONS_API USessionAsyncActionBase : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+public:
+	virtual void Activate() override;
+
+protected:
+	// Bind to the subsystem and start the operation, keeping its id in OperationId; false if it could not be started
+	virtual bool Start(UMultiplayerSessionsSubsystem& InSubsystem) PURE_VIRTUAL(USessionAsyncActionBase::Start, return false;);
+	// Remove whatever Start bound
+	virtual void Unbind(UMultiplayerSessionsSubsystem& InSubsystem) {}
+	// Fire the failure pin when there is no subsystem or Start returned false
+	virtual void BroadcastFailure() {}
+	// Unbind and let the action be garbage collected; call once the result pin has fired
+	void Finish();
+	// Whether the completion being broadcast is the one of the operation Start started
+	bool IsOwnResult() const;
+
+	TWeakObjectPtr<UObject> WorldContextObject;
+	TWeakObjectPtr<UMultiplayerSessionsSubsystem> Subsystem;
+	int32 OperationId{INDEX_NONE};
+
+private:
+	bool bStarting{false};
+};
+
+UCLASS()
+class MULTIPLAYERSESSIONS_API UCreateSessionAsyncAction : public USessionAsyncActionBase
+{
+	GENERATED_BODY()
+public:
+	// Creates the session, loads TravelURL's map meanwhile and ServerTravels there once both are done
+	UFUNCTION(BlueprintCallable, Category = "Multiplayer Sessions", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UCreateSessionAsyncAction* HostSession(UObject* WorldContextObject, int32 NumPublicConnections = 4, FString MatchType = TEXT("FreeForAll"), FString TravelURL = TEXT("/Game/ThirdPerson/Maps/Lobby?listen"));
+
+	UPROPERTY(BlueprintAssignable)
+	FSessionActionComplete OnSuccess;
+	UPROPERTY(BlueprintAssignable)
+	FSessionActionComplete OnFailure;
+
+protected:
+	virtual bool Start(UMultiplayerSessionsSubsystem& InSubsystem) override;
+	virtual void Unbind(UMultiplayerSessionsSubsystem& InSubsystem) override;
+	virtual void BroadcastFailure() override { OnFailure.Broadcast(); }
+
+private:
+	UFUNCTION()
+	void OnCreateSessionComplete(bool bWasSuccessful);
+
+	int32 NumPublicConnections{4};
+	FString MatchType;
+	FString TravelURL;
+};
+
+UCLASS()
+class MULTIPLAYERSESSIONS_API UFindSessionsAsyncAction : public USessionAsyncActionBase
+{
+	GENERATED_BODY()
+public:
+	// Empty MatchType for any; full or in-progress sessions are left out
+	UFUNCTION(BlueprintCallable, Category = "Multiplayer Sessions", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UFindSessionsAsyncAction* FindSessions(UObject* WorldContextObject, FString MatchType, int32 MaxResults = 100);
+
+	UPROPERTY(BlueprintAssignable)
+	FFindSessionsActionComplete OnSuccess;
+	UPROPERTY(BlueprintAssignable)
+	FFindSessionsActionComplete OnFailure;
+
+protected:
+	virtual bool Start(UMultiplayerSessionsSubsystem& InSubsystem) override;
+	virtual void Unbind(UMultiplayerSessionsSubsystem& InSubsystem) override;
+	virtual void BroadcastFailure() override { OnFailure.Broadcast(TArray<FBlueprintSessionResult>()); }
+
+private:
+	void OnFindSessionsComplete(TArrayView<const FSessionSummary> Summaries, bool bWasSuccessful);
+
+	FMultiplayerSessionQuery Query;
+	FDelegateHandle FindCompleteHandle;
+};
+
+UCLASS()
+class MULTIPLAYERSESSIONS_API UJoinSessionAsyncAction : public USessionAsyncActionBase
+{
+	GENERATED_BODY()
+public:
+	// Joins a result of the last Find Sessions and travels there
+	UFUNCTION(BlueprintCallable, Category = "Multiplayer Sessions", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UJoinSessionAsyncAction* JoinSession(UObject* WorldContextObject, FString SessionId);
+	// Searches, then joins the best ranked session, moving down the list while joins fail
+	UFUNCTION(BlueprintCallable, Category = "Multiplayer Sessions", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UJoinSessionAsyncAction* FindAndJoinSession(UObject* WorldContextObject, FString MatchType = TEXT("FreeForAll"));
+
+	// Result is "Success" or the failure reason
+	UPROPERTY(BlueprintAssignable)
+	FJoinSessionActionComplete OnSuccess;
+	UPROPERTY(BlueprintAssignable)
+	FJoinSessionActionComplete OnFailure;
+
+protected:
+	virtual bool Start(UMultiplayerSessionsSubsystem& InSubsystem) override;
+	virtual void Unbind(UMultiplayerSessionsSubsystem& InSubsystem) override;
+	virtual void BroadcastFailure() override;
+
+private:
+	void OnJoinSessionComplete(EOnJoinSessionCompleteResult::Type Result);
+
+	FString SessionId;
+	// Set for FindAndJoinSession
+	TOptional<FMultiplayerSessionQuery> Query;
+	FDelegateHandle JoinCompleteHandle;
+};
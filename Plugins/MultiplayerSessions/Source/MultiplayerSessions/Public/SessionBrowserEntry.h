@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blueprint/UserWidget.h"
+#include "Blueprint/IUserObjectListEntry.h"
+#include "SessionBrowserEntry.generated.h"
+
+class UTextBlock;
+
+/**
+ * Row widget for UServerBrowser's list view. The list view recycles these as rows scroll in and out,
+ * so all the state comes from the USessionBrowserItem handed to NativeOnListItemObjectSet.
+ **/
+UCLASS()
+class MULTIPLAYERSESSIONS_API USessionBrowserEntry : public UUserWidget, public IUserObjectListEntry
+{
+	GENERATED_BODY()
+protected:
+	virtual void NativeOnListItemObjectSet(UObject* ListItemObject) override;
+
+private:
+	UPROPERTY(meta = (BindWidget))
+	UTextBlock* HostNameText;
+	UPROPERTY(meta = (BindWidgetOptional))
+	UTextBlock* MatchTypeText;
+	UPROPERTY(meta = (BindWidget))
+	UTextBlock* PlayersText;
+	UPROPERTY(meta = (BindWidget))
+	UTextBlock* PingText;
+};
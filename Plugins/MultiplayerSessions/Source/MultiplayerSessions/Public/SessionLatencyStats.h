@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("MultiplayerSessions"), STATGROUP_MultiplayerSessions, STATCAT_Advanced);
+
+enum class ESessionLatencyStat : uint8
+{
+	Create,
+	Find,
+	Join,
+	Destroy,
+	Start,
+	End,
+	Update,
+	// From ServerTravel/ClientTravel until the new map is loaded
+	Travel,
+	Num
+};
+
+MULTIPLAYERSESSIONS_API const TCHAR* LexToString(ESessionLatencyStat Stat);
+
+struct MULTIPLAYERSESSIONS_API FSessionLatencySample
+{
+	// FPlatformTime::Seconds()
+	double BeginTime{0.0};
+	double EndTime{0.0};
+	bool bSucceeded{false};
+	// Stopped by a caller before it completed, e.g. a search stopped at an early candidate; not counted as failed
+	bool bCancelled{false};
+	// Operation specific, e.g. EOnJoinSessionCompleteResult for joins
+	int32 ResultCode{0};
+	// Search results for finds, 0 otherwise
+	int32 ResultCount{0};
+
+	double GetDurationMs() const { return (EndTime - BeginTime) * 1000.0; }
+};
+
+/**
+ * Rolling window over the most recent durations of one operation type
+ **/
+class MULTIPLAYERSESSIONS_API FSessionLatencyHistogram
+{
+public:
+	void SetWindowSize(int32 InWindowSize);
+	void Add(const FSessionLatencySample& Sample);
+	void Reset();
+
+	// Nearest-rank percentile (0-1) of the durations in the window, in milliseconds; 0 while empty
+	double GetPercentileMs(double Percentile) const;
+	// Sorts the window once for all three
+	void GetPercentilesMs(double& OutP50, double& OutP95, double& OutP99) const;
+
+	int32 GetNumInWindow() const { return DurationsMs.Num(); }
+	int64 GetNumSamples() const { return NumSamples; }
+	int64 GetNumFailed() const { return NumFailed; }
+	int64 GetNumCancelled() const { return NumCancelled; }
+	const FSessionLatencySample& GetLastSample() const { return LastSample; }
+
+private:
+	void GetSortedDurations(TArray<double>& OutSorted) const;
+
+	// Ring buffer, NextIndex is the oldest entry once it is full
+	TArray<double> DurationsMs;
+	int32 NextIndex{0};
+	int32 WindowSize{256};
+	int64 NumSamples{0};
+	int64 NumFailed{0};
+	int64 NumCancelled{0};
+	FSessionLatencySample LastSample;
+};
+
+/**
+ * Per-operation latency for the session subsystem. Every sample also updates the STATGROUP_MultiplayerSessions
+ * stats and the MultiplayerSessions trace counters, so it shows up in "stat MultiplayerSessions" and Insights.
+ **/
+class MULTIPLAYERSESSIONS_API FSessionLatencyStats
+{
+public:
+	void SetWindowSize(int32 WindowSize);
+	void Record(ESessionLatencyStat Stat, const FSessionLatencySample& Sample);
+	void Reset();
+
+	const FSessionLatencyHistogram& Get(ESessionLatencyStat Stat) const { return Histograms[static_cast<int32>(Stat)]; }
+	// One line per operation type: count, failures, cancellations, p50/p95/p99 and the last sample
+	void Dump(FOutputDevice& Ar) const;
+
+private:
+	FSessionLatencyHistogram Histograms[static_cast<int32>(ESessionLatencyStat::Num)];
+};
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FOnlineSessionSearchResult;
+struct FSessionFilterKey;
+
+/**
+ * How much each signal counts when ordering join candidates
+ **/
+struct MULTIPLAYERSESSIONS_API FSessionRankingWeights
+{
+	// Score lost per millisecond of ping
+	float PingWeight{1.f};
+	// Score gained for a completely empty session, scaled down as it fills up
+	float OpenSlotsWeight{50.f};
+	// Score gained per point of advertised host quality (0-100)
+	float HostQualityWeight{0.5f};
+};
+
+struct MULTIPLAYERSESSIONS_API FRankedSessionCandidate
+{
+	// Index into the search's SearchResults
+	int32 ResultIndex{INDEX_NONE};
+	int32 PingInMs{0};
+	float Score{0.f};
+	// Resolved during ranking for the top candidates so a successful join can travel right away, empty otherwise
+	FString ConnectString;
+
+	static float ComputeScore(const FSessionFilterKey& Key, int32 PingInMs, const FSessionRankingWeights& Weights);
+};
+
+DECLARE_DELEGATE_OneParam(FOnSessionLatencyProbed, int32 /* PingInMs, INDEX_NONE on failure */);
+
+/**
+ * Measures the latency to a session's host before we commit to joining it.
+ * The subsystem uses FIcmpSessionLatencyProbe on LAN; tests can swap in one that reports fake latencies.
+ **/
+class MULTIPLAYERSESSIONS_API ISessionLatencyProbe
+{
+public:
+	virtual ~ISessionLatencyProbe() = default;
+
+	// Must call OnProbed exactly once, on the game thread
+	virtual void Probe(const FOnlineSessionSearchResult& SearchResult, const FString& HostAddress, float Timeout, FOnSessionLatencyProbed OnProbed) = 0;
+};
+
+class MULTIPLAYERSESSIONS_API FIcmpSessionLatencyProbe : public ISessionLatencyProbe
+{
+public:
+	virtual void Probe(const FOnlineSessionSearchResult& SearchResult, const FString& HostAddress, float Timeout, FOnSessionLatencyProbed OnProbed) override;
+};
@@ -2,6 +2,29 @@
 
 #include "MenuSystem.h"
 #include "Modules/ModuleManager.h"
+#include "Engine/NetDriver.h"
+#include "Engine/ReplicationDriver.h"
+#include "Engine/World.h"
+#include "Net/MenuSystemReplicationGraph.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, MenuSystem, "MenuSystem" );
- 
\ No newline at end of file
+class FMenuSystemModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		// 只替换游戏网络驱动；-NoReplicationGraph 时退回引擎默认的逐 Actor 相关性检查，用于对比
+		UReplicationDriver::CreateReplicationDriverDelegate().BindLambda([](UNetDriver* ForNetDriver, const FURL& URL, UWorld* World) -> UReplicationDriver*
+		{
+			if (ForNetDriver == nullptr || ForNetDriver->NetDriverName != NAME_GameNetDriver) return nullptr;
+			if (FParse::Param(FCommandLine::Get(), TEXT("NoReplicationGraph"))) return nullptr;
+			return NewObject<UMenuSystemReplicationGraph>(GetTransientPackage());
+		});
+	}
+
+	virtual void ShutdownModule() override
+	{
+		UReplicationDriver::CreateReplicationDriverDelegate().Unbind();
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FMenuSystemModule, MenuSystem, "MenuSystem" );
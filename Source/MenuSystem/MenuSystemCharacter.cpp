@@ -2,6 +2,7 @@
 
 #include "MenuSystemCharacter.h"
 #include "Engine/LocalPlayer.h"
+#include "Engine/GameInstance.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
@@ -10,21 +11,20 @@
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "InputActionValue.h"
-#include "OnlineSubsystem.h"
-#include "OnlineSubsystemUtils.h"
-
-#include "OnlineSessionSettings.h"
-#include "Online/OnlineSessionNames.h"
+#include "MultiplayerSessionsSubsystem.h"
+#include "SkeletalMeshComponentBudgeted.h"
+#include "Anim/AnimationBudgetSubsystem.h"
+#include "Net/MenuSystemCharacterMovementComponent.h"
 
 DEFINE_LOG_CATEGORY(LogTemplateCharacter);
 
 //////////////////////////////////////////////////////////////////////////
 // AMenuSystemCharacter
 
-AMenuSystemCharacter::AMenuSystemCharacter():
-	CreateSessionCompleteDelegate(FOnCreateSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnCreatesessionComplete)),
-	FindSessionsCompleteDelegate(FOnFindSessionsCompleteDelegate::CreateUObject(this, &ThisClass::OnFindSessionsComplete)),
-	JoinSessionCompleteDelegate(FOnJoinSessionCompleteDelegate::CreateUObject(this, &ThisClass::OnJoinSessionComplete))
+AMenuSystemCharacter::AMenuSystemCharacter(const FObjectInitializer& ObjectInitializer):
+	Super(ObjectInitializer
+		.SetDefaultSubobjectClass<USkeletalMeshComponentBudgeted>(ACharacter::MeshComponentName)
+		.SetDefaultSubobjectClass<UMenuSystemCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
@@ -60,18 +60,25 @@ AMenuSystemCharacter::AMenuSystemCharacter():
 
 	// Note: The skeletal mesh and anim blueprint references on the Mesh component (inherited from Character) 
 	// are set in the derived blueprint asset named ThirdPersonCharacter (to avoid direct content references in C++)
-	if (const IOnlineSubsystem* OnlineSubsystem = Online::GetSubsystem(GetWorld()))
+}
+
+void AMenuSystemCharacter::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UAnimationBudgetSubsystem* AnimationBudget = GetWorld()->GetSubsystem<UAnimationBudgetSubsystem>())
+	{
+		AnimationBudget->RegisterMesh(Cast<USkeletalMeshComponentBudgeted>(GetMesh()));
+	}
+}
+
+void AMenuSystemCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UAnimationBudgetSubsystem* AnimationBudget = GetWorld()->GetSubsystem<UAnimationBudgetSubsystem>())
 	{
-		OnlineSessionPtr = OnlineSubsystem->GetSessionInterface();
-		// if (GEngine)
-		// {
-		// 	GEngine->AddOnScreenDebugMessage(
-		// 		-1,
-		// 		3.f,
-		// 		FColor::Red,
-		// 		FString::Printf(TEXT("Found:%s"), *OnlineSubsystem->GetSubsystemName().ToString()));
-		// }
+		AnimationBudget->UnregisterMesh(Cast<USkeletalMeshComponentBudgeted>(GetMesh()));
 	}
+	Super::EndPlay(EndPlayReason);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -112,159 +119,27 @@ void AMenuSystemCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInpu
 	}
 }
 
-void AMenuSystemCharacter::CreateGameSession()
+UMultiplayerSessionsSubsystem* AMenuSystemCharacter::GetMultiplayerSessionsSubsystem() const
 {
-	if (!OnlineSessionPtr.IsValid()) return;
-
-	auto ExistingSession = OnlineSessionPtr->GetNamedSession(NAME_GameSession);
-	if (ExistingSession != nullptr)
-	{
-		OnlineSessionPtr->DestroySession(NAME_GameSession);
-	}
-	
-	OnlineSessionPtr->AddOnCreateSessionCompleteDelegate_Handle(CreateSessionCompleteDelegate);
-
-	TSharedPtr<FOnlineSessionSettings> SessionSettings = MakeShareable(new FOnlineSessionSettings());
-	SessionSettings->bIsLANMatch = false; // 使用局域网
-	SessionSettings->NumPublicConnections = 4; // 最大连接数
-	SessionSettings->bAllowJoinInProgress = true; // 是否允许中途加入
-	SessionSettings->bAllowJoinViaPresence = true; // 允许区域玩家加入
-	SessionSettings->bShouldAdvertise = true; // 是否被广播，可以让其他玩家发现并加入
-	SessionSettings->bUsesPresence = true; // 显示用户状态信息
-	SessionSettings->bUseLobbiesIfAvailable = true; // 支持 Lobbies Api，不开启可能无法找到 Session
-	// 设置 MatchType 为 "FreeForAll"
-	SessionSettings->Set(FName("MatchType"), FString("FreeForAll"), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
-	
-	const ULocalPlayer* LocalPlayer = GetWorld()->GetFirstLocalPlayerFromController();
-	OnlineSessionPtr->CreateSession(*LocalPlayer->GetPreferredUniqueNetId(), NAME_GameSession, *SessionSettings);
-	
+	const UGameInstance* GameInstance = GetGameInstance();
+	return GameInstance ? GameInstance->GetSubsystem<UMultiplayerSessionsSubsystem>() : nullptr;
 }
 
-void AMenuSystemCharacter::JoinGameSession()
-{
-	// Find game sessions
-	if (!OnlineSessionPtr.IsValid()) {
-		return;
-	}
-
-	// 将委托添加到 FindSessionsCompleteDelegate_Handle 委托列表
-	// 找到 Session 后执行 FindSessionCompleteDelege 绑定的函数 OnFindSessionsComplete
-	OnlineSessionPtr->AddOnFindSessionsCompleteDelegate_Handle(FindSessionsCompleteDelegate);
-
-	SessionSearch = MakeShareable(new FOnlineSessionSearch()); // 创建 SessionSearch 对象
-	SessionSearch->MaxSearchResults = 10000; // 最大搜索结果为 10000 条
-	SessionSearch->bIsLanQuery = false; // 关闭局域网查询
-	SessionSearch->QuerySettings.Set(SEARCH_LOBBIES, false, EOnlineComparisonOp::Equals); // 只查询 presence 值为 false 的
-
-	// 获取玩家控制器，以供后面获取网络 ID
-	const ULocalPlayer* LocalPlayer = GetWorld()->GetFirstLocalPlayerFromController();
-	// 通过 网络ID、SessionSearch 搜索参数 来查找 Session
-	OnlineSessionPtr->FindSessions(*LocalPlayer->GetPreferredUniqueNetId(), SessionSearch.ToSharedRef());
-
-}
-
-void AMenuSystemCharacter::OnFindSessionsComplete(bool bWasSuccessful)
-{
-	if (!OnlineSessionPtr.IsValid()) {
-		return;
-	}
-	if (bWasSuccessful)
-	{
-		// 打印搜索结果数量
-		GEngine->AddOnScreenDebugMessage(
-			-1,
-			15.f,
-			FColor::Cyan,
-			FString::Printf(TEXT("Found SearchResults %d"), SessionSearch->SearchResults.Num())
-		);
-		// 遍历结果，取出每条结果的 Id、User，打印它们
-		for (auto Result : SessionSearch->SearchResults) {
-			FString Id = Result.GetSessionIdStr();
-			FString User = Result.Session.OwningUserName;
-
-			// 获取 MatchType
-			FString MatchType;
-			Result.Session.SessionSettings.Get(FName("MatchType"), MatchType);
-
-			
-			if (GEngine) {
-				GEngine->AddOnScreenDebugMessage(
-					-1,
-					15.f,
-					FColor::Cyan,
-					FString::Printf(TEXT("Id: %s, User: %s"), *Id, *User)
-				);
-			}
-
-			// 如果 MatchType 是前面 CreateGameSeesion 中设置的 "FreeForAll"，则打印并添加委托，同时加入 Session
-			if (MatchType == FString("FreeForAll")) {
-				if (GEngine) {
-					GEngine->AddOnScreenDebugMessage(
-						-1,
-						15.f,
-						FColor::Cyan,
-						FString::Printf(TEXT("Joining Match Type %s"), *MatchType)
-					);
-				}
-
-				OnlineSessionPtr->AddOnJoinSessionCompleteDelegate_Handle(JoinSessionCompleteDelegate);
-
-				const ULocalPlayer* LocalPlayer = GetWorld()->GetFirstLocalPlayerFromController();
-				OnlineSessionPtr->JoinSession(*LocalPlayer->GetPreferredUniqueNetId(), NAME_GameSession, Result);
-			}
-
-		}
-	}
-}
-
-void AMenuSystemCharacter::OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result)
+void AMenuSystemCharacter::CreateGameSession()
 {
-	if (!OnlineSessionPtr.IsValid()) {
-		return;
-	}
-	if (EOnJoinSessionCompleteResult::Success == Result)
+	// 创建完成后子系统会自己 ServerTravel 到 Lobby
+	if (UMultiplayerSessionsSubsystem* MultiplayerSessionsSubsystem = GetMultiplayerSessionsSubsystem())
 	{
-		FString Address;
-		if (OnlineSessionPtr->GetResolvedConnectString(NAME_GameSession, Address))
-		{
-			if (GEngine) {
-				GEngine->AddOnScreenDebugMessage(
-					-1,
-					15.f,
-					FColor::Yellow,
-					FString::Printf(TEXT("Connect string:%s"), *Address)
-				);
-			}
-			APlayerController* PlayerController = GetGameInstance()->GetFirstLocalPlayerController();
-			if (PlayerController)
-			{
-				PlayerController->ClientTravel(Address, TRAVEL_Absolute);
-			}
-		}
+		MultiplayerSessionsSubsystem->HostSession(4, TEXT("FreeForAll"), TEXT("/Game/ThirdPerson/Maps/Lobby?listen"));
 	}
 }
 
-void AMenuSystemCharacter::OnCreatesessionComplete(FName SessionName, bool bWasSuccessful)
+void AMenuSystemCharacter::JoinGameSession()
 {
-	if (bWasSuccessful)
+	// 搜索、排序、依次尝试加入，成功后子系统直接 ClientTravel
+	if (UMultiplayerSessionsSubsystem* MultiplayerSessionsSubsystem = GetMultiplayerSessionsSubsystem())
 	{
-		GEngine->AddOnScreenDebugMessage(
-				-1,
-				3.f,
-				FColor::Blue,
-				FString::Printf(TEXT("OnCreatesessionComplete:%s"), *SessionName.ToString()));
-		// 切换到名为 Lobby 的关卡
-		UWorld* World = GetWorld();
-		if (World) {
-			World->ServerTravel(FString("/Game/ThirdPerson/Maps/Lobby?listen"));
-		}
-	} else
-	{
-		GEngine->AddOnScreenDebugMessage(
-				-1,
-				3.f,
-				FColor::Green,
-				FString::Printf(TEXT("OnCreatesessionComplete-failed")));
+		MultiplayerSessionsSubsystem->FindAndJoinSession(FMultiplayerSessionQuery().WithMatchType(TEXT("FreeForAll")));
 	}
 }
 
@@ -275,19 +150,12 @@ void AMenuSystemCharacter::Move(const FInputActionValue& Value)
 
 	if (Controller != nullptr)
 	{
-		// find out which way is forward
-		const FRotator Rotation = Controller->GetControlRotation();
-		const FRotator YawRotation(0, Rotation.Yaw, 0);
-
-		// get forward vector
-		const FVector ForwardDirection = FRotationMatrix(YawRotation).GetUnitAxis(EAxis::X);
-	
-		// get right vector 
-		const FVector RightDirection = FRotationMatrix(YawRotation).GetUnitAxis(EAxis::Y);
+		// 只需要 Yaw 的正余弦：前方 (C, S, 0)，右方 (-S, C, 0)
+		float SinYaw, CosYaw;
+		FMath::SinCos(&SinYaw, &CosYaw, FMath::DegreesToRadians(Controller->GetControlRotation().Yaw));
 
-		// add movement 
-		AddMovementInput(ForwardDirection, MovementVector.Y);
-		AddMovementInput(RightDirection, MovementVector.X);
+		// add movement; the movement component sums this frame's calls itself
+		AddMovementInput(FVector(CosYaw * MovementVector.Y - SinYaw * MovementVector.X, SinYaw * MovementVector.Y + CosYaw * MovementVector.X, 0.f));
 	}
 }
 
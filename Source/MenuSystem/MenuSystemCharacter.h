@@ -4,9 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
-#include "Interfaces/OnlineSessionDelegates.h"
 #include "Logging/LogMacros.h"
-#include "Interfaces\OnlineSessionInterface.h"
 #include "MenuSystemCharacter.generated.h"
 
 class USpringArmComponent;
@@ -47,7 +45,9 @@ class AMenuSystemCharacter : public ACharacter
 	UInputAction* LookAction;
 
 public:
-	AMenuSystemCharacter();
+	// The mesh is a USkeletalMeshComponentBudgeted, so UAnimationBudgetSubsystem can throttle it;
+	// movement is a UMenuSystemCharacterMovementComponent with this character's own move send rates
+	AMenuSystemCharacter(const FObjectInitializer& ObjectInitializer);
 	
 
 protected:
@@ -61,6 +61,9 @@ protected:
 
 protected:
 
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	virtual void NotifyControllerChanged() override;
 
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
@@ -71,24 +74,14 @@ public:
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
 
-public:
-	IOnlineSessionPtr OnlineSessionPtr;
-
 protected:
+	// 会话由 GameInstance 上的 UMultiplayerSessionsSubsystem 负责，角色本身不保存任何会话状态
 	UFUNCTION(BlueprintCallable)
 	void CreateGameSession();
 	
 	UFUNCTION(BlueprintCallable)
 	void JoinGameSession();
-	
-	void OnCreatesessionComplete(FName SessionName, bool bWasSuccessful);
-	void OnFindSessionsComplete(bool bWasSuccessful);
-	void OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result);
+
 private:
-	FOnCreateSessionCompleteDelegate CreateSessionCompleteDelegate;
-	FOnFindSessionsCompleteDelegate FindSessionsCompleteDelegate;
-	FOnJoinSessionCompleteDelegate JoinSessionCompleteDelegate;
-	
-	// 存放搜索对象
-	TSharedPtr<FOnlineSessionSearch> SessionSearch;
+	class UMultiplayerSessionsSubsystem* GetMultiplayerSessionsSubsystem() const;
 };
@@ -0,0 +1,162 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Anim/AnimationBudgetSubsystem.h"
+
+#include "IAnimationBudgetAllocator.h"
+#include "AnimationBudgetAllocatorParameters.h"
+#include "SkeletalMeshComponentBudgeted.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "ProfilingDebugging/CountersTrace.h"
+
+TRACE_DECLARE_INT_COUNTER(AnimBudgetMeshes, TEXT("AnimationBudget/Meshes"));
+TRACE_DECLARE_INT_COUNTER(AnimBudgetVisible, TEXT("AnimationBudget/Visible"));
+TRACE_DECLARE_INT_COUNTER(AnimBudgetThrottled, TEXT("AnimationBudget/Throttled"));
+TRACE_DECLARE_INT_COUNTER(AnimBudgetSkipped, TEXT("AnimationBudget/Skipped evaluation"));
+TRACE_DECLARE_INT_COUNTER(AnimBudgetInterpolated, TEXT("AnimationBudget/Interpolated"));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice DumpAnimBudgetCommand(
+	TEXT("MenuSystem.DumpAnimBudget"),
+	TEXT("Print how many budgeted character meshes were visible, throttled, skipped and interpolated last frame"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		const UAnimationBudgetSubsystem* Subsystem = World ? World->GetSubsystem<UAnimationBudgetSubsystem>() : nullptr;
+		if (Subsystem == nullptr) return;
+
+		const FAnimationBudgetFrameStats& Stats = Subsystem->GetFrameStats();
+		Ar.Logf(TEXT("Animation budget %s: %d meshes, %d visible, %d throttled, %d skipped evaluation, %d interpolated"),
+			Subsystem->IsBudgetEnabled() ? TEXT("on") : TEXT("off"),
+			Stats.NumMeshes, Stats.NumVisible, Stats.NumThrottled, Stats.NumSkippedEvaluation, Stats.NumInterpolated);
+	}));
+
+static float CalculateBudgetedMeshSignificance(USkeletalMeshComponentBudgeted* Mesh)
+{
+	const UWorld* World = Mesh ? Mesh->GetWorld() : nullptr;
+	const UAnimationBudgetSubsystem* Subsystem = World ? World->GetSubsystem<UAnimationBudgetSubsystem>() : nullptr;
+	return Subsystem ? Subsystem->CalculateSignificance(*Mesh) : 1.f;
+}
+
+bool UAnimationBudgetSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UAnimationBudgetSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// 专用服务器不渲染，骨骼动画本来就不更新
+	if (!bEnableAnimationBudget || InWorld.GetNetMode() == NM_DedicatedServer) return;
+
+	IAnimationBudgetAllocator* Allocator = IAnimationBudgetAllocator::Get(&InWorld);
+	if (Allocator == nullptr) return;
+
+	FAnimationBudgetAllocatorParameters Parameters;
+	Parameters.BudgetInMs = BudgetInMs;
+	Parameters.MinQuality = MinQuality;
+	Parameters.MaxTickRate = MaxTickRate;
+	Parameters.MaxInterpolatedComponents = MaxInterpolatedComponents;
+	Allocator->SetParameters(Parameters);
+	Allocator->SetEnabled(true);
+
+	// 全局委托，同一个静态函数重复绑定没有影响
+	USkeletalMeshComponentBudgeted::OnCalculateSignificance().BindStatic(&CalculateBudgetedMeshSignificance);
+	bBudgetEnabled = true;
+}
+
+void UAnimationBudgetSubsystem::RegisterMesh(USkeletalMeshComponentBudgeted* Mesh)
+{
+	if (Mesh == nullptr) return;
+
+	Mesh->SetAutoCalculateSignificance(true);
+	Meshes.AddUnique(Mesh);
+}
+
+void UAnimationBudgetSubsystem::UnregisterMesh(USkeletalMeshComponentBudgeted* Mesh)
+{
+	Meshes.RemoveSingleSwap(Mesh);
+}
+
+void UAnimationBudgetSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// 视点每帧只取一次，分配器计算每个网格的重要度时直接复用
+	UpdateViewLocations();
+	UpdateFrameStats();
+}
+
+TStatId UAnimationBudgetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAnimationBudgetSubsystem, STATGROUP_Tickables);
+}
+
+float UAnimationBudgetSubsystem::CalculateSignificance(const USkeletalMeshComponentBudgeted& Mesh) const
+{
+	// 自己控制的角色始终满帧更新
+	const APawn* Pawn = Cast<APawn>(Mesh.GetOwner());
+	if (Pawn && Pawn->IsLocallyControlled()) return 1.f;
+	if (ViewLocations.IsEmpty()) return 1.f;
+
+	const FVector Location = Mesh.GetComponentLocation();
+	float ClosestDistanceSquared = TNumericLimits<float>::Max();
+	for (const FVector& ViewLocation : ViewLocations)
+	{
+		ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, static_cast<float>(FVector::DistSquared(ViewLocation, Location)));
+	}
+
+	const float ReferenceDistanceSquared = FMath::Max(FMath::Square(SignificanceReferenceDistance), 1.f);
+	float Significance = 1.f / (1.f + ClosestDistanceSquared / ReferenceDistanceSquared);
+	if (!Mesh.WasRecentlyRendered(0.2f))
+	{
+		Significance *= OffscreenSignificanceScale;
+	}
+	return Significance;
+}
+
+void UAnimationBudgetSubsystem::UpdateViewLocations()
+{
+	ViewLocations.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController == nullptr || !PlayerController->IsLocalController()) continue;
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		ViewLocations.Add(ViewLocation);
+	}
+}
+
+void UAnimationBudgetSubsystem::UpdateFrameStats()
+{
+	FrameStats = FAnimationBudgetFrameStats();
+	for (int32 Index = Meshes.Num() - 1; Index >= 0; --Index)
+	{
+		const USkeletalMeshComponentBudgeted* Mesh = Meshes[Index].Get();
+		if (Mesh == nullptr)
+		{
+			Meshes.RemoveAtSwap(Index);
+			continue;
+		}
+
+		++FrameStats.NumMeshes;
+		FrameStats.NumVisible += Mesh->WasRecentlyRendered(0.2f) ? 1 : 0;
+		if (const FAnimUpdateRateParameters* UpdateRate = Mesh->AnimUpdateRateParams)
+		{
+			FrameStats.NumThrottled += UpdateRate->UpdateRate > 1 ? 1 : 0;
+			FrameStats.NumSkippedEvaluation += UpdateRate->ShouldSkipEvaluation() ? 1 : 0;
+			FrameStats.NumInterpolated += UpdateRate->ShouldInterpolateSkippedFrames() ? 1 : 0;
+		}
+	}
+
+	TRACE_COUNTER_SET(AnimBudgetMeshes, FrameStats.NumMeshes);
+	TRACE_COUNTER_SET(AnimBudgetVisible, FrameStats.NumVisible);
+	TRACE_COUNTER_SET(AnimBudgetThrottled, FrameStats.NumThrottled);
+	TRACE_COUNTER_SET(AnimBudgetSkipped, FrameStats.NumSkippedEvaluation);
+	TRACE_COUNTER_SET(AnimBudgetInterpolated, FrameStats.NumInterpolated);
+}
@@ -9,15 +9,46 @@
 void UBlasterAnimInstance::NativeInitializeAnimation()
 {
 	Super::NativeInitializeAnimation();
-	APawn* GetPawnOwner = TryGetPawnOwner();
-	ACharacter* Character = Cast<ACharacter>(GetPawnOwner);
-	if (Character->GetCharacterMovement()->GetCurrentAcceleration().Size() > 0.f)
-	{
-		// Accelerating
-	}
+	CacheOwner();
+}
+
+bool UBlasterAnimInstance::CacheOwner()
+{
+	if (CharacterMovement) return true;
+
+	Character = Cast<ACharacter>(TryGetPawnOwner());
+	CharacterMovement = Character ? Character->GetCharacterMovement() : nullptr;
+	return CharacterMovement != nullptr;
 }
 
 void UBlasterAnimInstance::NativeUpdateAnimation(float DeltaSeconds)
 {
 	Super::NativeUpdateAnimation(DeltaSeconds);
+	if (!CacheOwner()) return;
+
+	// 游戏线程上只拷贝原始数据，其余计算放到工作线程
+	Velocity = CharacterMovement->Velocity;
+	bFalling = CharacterMovement->IsFalling();
+	bHasAcceleration = !CharacterMovement->GetCurrentAcceleration().IsNearlyZero();
+	Yaw = Character->GetActorRotation().Yaw;
+}
+
+void UBlasterAnimInstance::NativeThreadSafeUpdateAnimation(float DeltaSeconds)
+{
+	Super::NativeThreadSafeUpdateAnimation(DeltaSeconds);
+
+	Movement.Speed = Velocity.Size2D();
+	Movement.bIsInAir = bFalling;
+	Movement.bIsAccelerating = bHasAcceleration;
+
+	// 按转身速度倾斜，插值避免抖动
+	float TargetLean = 0.f;
+	if (bHasLastYaw && DeltaSeconds > 0.f && FullLeanYawRate > 0.f)
+	{
+		const float YawRate = FMath::FindDeltaAngleDegrees(LastYaw, Yaw) / DeltaSeconds;
+		TargetLean = FMath::Clamp(YawRate / FullLeanYawRate, -1.f, 1.f);
+	}
+	LastYaw = Yaw;
+	bHasLastYaw = CharacterMovement != nullptr;
+	Movement.Lean = FMath::FInterpTo(Movement.Lean, TargetLean, DeltaSeconds, LeanInterpSpeed);
 }
@@ -3,56 +3,186 @@
 
 #include "Game/LobbyGameMode.h"
 
-#include "GameFramework/GameStateBase.h"
+#include "Game/LobbyGameState.h"
+#include "Game/LobbyPlayerState.h"
+#include "Game/LobbyRosterSubsystem.h"
 #include "GameFramework/PlayerState.h"
+#include "MultiplayerSessionsSubsystem.h"
+
+ALobbyGameMode::ALobbyGameMode()
+{
+	GameStateClass = ALobbyGameState::StaticClass();
+	PlayerStateClass = ALobbyPlayerState::StaticClass();
+	// 进入比赛时保留连接，客户端不需要重新连接和阻塞加载
+	bUseSeamlessTravel = true;
+}
+
+void ALobbyGameMode::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (ULobbyRosterSubsystem* RosterSubsystem = GetWorld()->GetSubsystem<ULobbyRosterSubsystem>())
+	{
+		RosterChangedDelegateHandle = RosterSubsystem->OnRosterChanged.AddUObject(this, &ThisClass::OnRosterChanged);
+	}
+	// 从比赛回到大厅时重新开放加入
+	if (UMultiplayerSessionsSubsystem* MultiplayerSessionsSubsystem = GetMultiplayerSessionsSubsystem())
+	{
+		MultiplayerSessionsSubsystem->SetAdvertisedMatchPhase(EMultiplayerMatchPhase::Lobby);
+	}
+}
+
+void ALobbyGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (ULobbyRosterSubsystem* RosterSubsystem = GetWorld()->GetSubsystem<ULobbyRosterSubsystem>())
+	{
+		RosterSubsystem->OnRosterChanged.Remove(RosterChangedDelegateHandle);
+	}
+	GetWorldTimerManager().ClearTimer(MatchStartTimerHandle);
+	Super::EndPlay(EndPlayReason);
+}
 
 void ALobbyGameMode::PostLogin(APlayerController* NewPlayer)
 {
 	Super::PostLogin(NewPlayer);
 
-	if (GameState)
+	AddToRoster(*NewPlayer);
+}
+
+void ALobbyGameMode::HandleSeamlessTravelPlayer(AController*& C)
+{
+	// 父类可能为旧控制器换上新的 PlayerState，之后再登记
+	Super::HandleSeamlessTravelPlayer(C);
+
+	if (C)
 	{
-		int32 NumberOfPlayers = GameState.Get()->PlayerArray.Num();
-		if (GEngine)
-		{
-			GEngine->AddOnScreenDebugMessage(
-				1,
-				3.f,
-				FColor::Yellow,
-				FString::Printf(TEXT("Players in game:%d"), NumberOfPlayers));
-		}
-		APlayerState* PlayerState = NewPlayer->GetPlayerState<APlayerState>();
-		if (PlayerState)
-		{
-			FString PlayerName = PlayerState->GetPlayerName();
-			GEngine->AddOnScreenDebugMessage(
-				1,
-				3.f,
-				FColor::Yellow,
-				FString::Printf(TEXT("%s has joined in"), *PlayerName));
-		}
+		AddToRoster(*C);
+	}
+}
+
+void ALobbyGameMode::AddToRoster(const AController& Controller)
+{
+	const APlayerState* PlayerState = Controller.GetPlayerState<APlayerState>();
+	ULobbyRosterSubsystem* RosterSubsystem = GetWorld()->GetSubsystem<ULobbyRosterSubsystem>();
+	if (PlayerState && RosterSubsystem)
+	{
+		RosterSubsystem->AddMember(*PlayerState);
 	}
 }
 
 void ALobbyGameMode::Logout(AController* Exiting)
 {
+	const APlayerState* PlayerState = Exiting->GetPlayerState<APlayerState>();
+	ULobbyRosterSubsystem* RosterSubsystem = GetWorld()->GetSubsystem<ULobbyRosterSubsystem>();
+	if (PlayerState && RosterSubsystem)
+	{
+		RosterSubsystem->RemoveMember(*PlayerState);
+	}
+
 	Super::Logout(Exiting);
+}
+
+void ALobbyGameMode::OnRosterChanged(TArrayView<const int32> JoinedPlayerIds, TArrayView<const int32> LeftPlayerIds, TArrayView<const int32> ChangedPlayerIds)
+{
+	const ULobbyRosterSubsystem* RosterSubsystem = GetWorld()->GetSubsystem<ULobbyRosterSubsystem>();
+	if (RosterSubsystem == nullptr) return;
+
+	UpdateMatchStart(*RosterSubsystem);
+	// 准备、队伍和延迟的变化不需要提示
+	if (JoinedPlayerIds.IsEmpty() && LeftPlayerIds.IsEmpty()) return;
 
-	APlayerState* PlayerState = Exiting->GetPlayerState<APlayerState>();
-	if (PlayerState)
+	// 名单按帧合并，Session 更新再由子系统合并，一批玩家进出只更新一次
+	if (UMultiplayerSessionsSubsystem* MultiplayerSessionsSubsystem = GetMultiplayerSessionsSubsystem())
 	{
-		int32 NumberOfPlayers = GameState.Get()->PlayerArray.Num();
-		GEngine->AddOnScreenDebugMessage(
-				1,
+		MultiplayerSessionsSubsystem->SetAdvertisedPlayerCount(RosterSubsystem->GetNumMembers());
+	}
+	if (GEngine == nullptr) return;
+
+	GEngine->AddOnScreenDebugMessage(
+		1,
+		3.f,
+		FColor::Yellow,
+		FString::Printf(TEXT("Players in game:%d"), RosterSubsystem->GetNumMembers()));
+
+	// 单个玩家进出时显示名字，批量时只显示人数
+	if (JoinedPlayerIds.Num() == 1 && LeftPlayerIds.IsEmpty())
+	{
+		if (const FLobbyMember* Member = RosterSubsystem->FindMember(JoinedPlayerIds[0]))
+		{
+			GEngine->AddOnScreenDebugMessage(
+				2,
 				3.f,
 				FColor::Yellow,
-				FString::Printf(TEXT("Players in game:%d"), NumberOfPlayers - 1));
-
-		FString PlayerName = PlayerState->GetPlayerName();
+				FString::Printf(TEXT("%s has joined in"), *Member->PlayerName));
+		}
+	}
+	else
+	{
 		GEngine->AddOnScreenDebugMessage(
-			1,
+			2,
 			3.f,
 			FColor::Yellow,
-			FString::Printf(TEXT("%s has exited the game"), *PlayerName));
+			FString::Printf(TEXT("%d joined, %d exited the game"), JoinedPlayerIds.Num(), LeftPlayerIds.Num()));
+	}
+}
+
+bool ALobbyGameMode::CanStartMatch(const ULobbyRosterSubsystem& RosterSubsystem) const
+{
+	const int32 NumMembers = RosterSubsystem.GetNumMembers();
+	if (NumMembers < MinPlayersToStart) return false;
+	if (NumPlayersToStartImmediately > 0 && NumMembers >= NumPlayersToStartImmediately) return true;
+
+	const int32 NumReady = RosterSubsystem.GetNumMembersInState(ELobbyMemberState::Ready);
+	return NumReady >= FMath::CeilToInt(NumMembers * RequiredReadyFraction);
+}
+
+void ALobbyGameMode::UpdateMatchStart(const ULobbyRosterSubsystem& RosterSubsystem)
+{
+	if (bMatchStarting) return;
+
+	FTimerManager& TimerManager = GetWorldTimerManager();
+	const bool bCountingDown = TimerManager.IsTimerActive(MatchStartTimerHandle);
+	if (CanStartMatch(RosterSubsystem))
+	{
+		if (bCountingDown) return;
+
+		TimerManager.SetTimer(MatchStartTimerHandle, this, &ThisClass::StartMatch, FMath::Max(MatchStartCountdown, KINDA_SMALL_NUMBER), false);
+		if (GEngine)
+		{
+			GEngine->AddOnScreenDebugMessage(3, MatchStartCountdown, FColor::Green, FString::Printf(TEXT("Match starting in %.0fs"), MatchStartCountdown));
+		}
 	}
-}
\ No newline at end of file
+	else if (bCountingDown)
+	{
+		TimerManager.ClearTimer(MatchStartTimerHandle);
+		if (GEngine)
+		{
+			GEngine->AddOnScreenDebugMessage(3, 3.f, FColor::Yellow, TEXT("Match start cancelled"));
+		}
+	}
+}
+
+void ALobbyGameMode::StartMatch()
+{
+	const ULobbyRosterSubsystem* RosterSubsystem = GetWorld()->GetSubsystem<ULobbyRosterSubsystem>();
+	if (RosterSubsystem == nullptr || !CanStartMatch(*RosterSubsystem)) return;
+
+	// 无缝旅行先进入 TransitionMap，比赛地图在后台异步加载
+	bMatchStarting = true;
+	if (!GetWorld()->ServerTravel(FString::Printf(TEXT("%s?listen"), *MatchMapPath)))
+	{
+		bMatchStarting = false;
+		return;
+	}
+	// 比赛开始后不再作为可加入的房间出现在搜索结果中
+	if (UMultiplayerSessionsSubsystem* MultiplayerSessionsSubsystem = GetMultiplayerSessionsSubsystem())
+	{
+		MultiplayerSessionsSubsystem->SetAdvertisedMatchPhase(EMultiplayerMatchPhase::InProgress);
+	}
+}
+
+UMultiplayerSessionsSubsystem* ALobbyGameMode::GetMultiplayerSessionsSubsystem() const
+{
+	const UGameInstance* GameInstance = GetGameInstance();
+	return GameInstance ? GameInstance->GetSubsystem<UMultiplayerSessionsSubsystem>() : nullptr;
+}
@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/LobbyGameState.h"
+
+#include "Net/UnrealNetwork.h"
+#include "Net/Core/PushModel/PushModel.h"
+
+void FLobbyRosterEntry::PostReplicatedAdd(const FLobbyRoster& InArraySerializer)
+{
+	if (ULobbyRosterSubsystem* RosterSubsystem = InArraySerializer.GetRosterSubsystem())
+	{
+		RosterSubsystem->HandleReplicatedAdd(Member);
+	}
+}
+
+void FLobbyRosterEntry::PostReplicatedChange(const FLobbyRoster& InArraySerializer)
+{
+	if (ULobbyRosterSubsystem* RosterSubsystem = InArraySerializer.GetRosterSubsystem())
+	{
+		RosterSubsystem->HandleReplicatedChange(Member);
+	}
+}
+
+void FLobbyRosterEntry::PreReplicatedRemove(const FLobbyRoster& InArraySerializer)
+{
+	if (ULobbyRosterSubsystem* RosterSubsystem = InArraySerializer.GetRosterSubsystem())
+	{
+		RosterSubsystem->HandleReplicatedRemove(Member);
+	}
+}
+
+void FLobbyRoster::AddOrUpdate(const FLobbyMember& Member)
+{
+	if (const int32* EntryIndex = EntryIndexByPlayerId.Find(Member.PlayerId))
+	{
+		FLobbyRosterEntry& Entry = Entries[*EntryIndex];
+		Entry.Member = Member;
+		MarkItemDirty(Entry);
+		return;
+	}
+	EntryIndexByPlayerId.Add(Member.PlayerId, Entries.Num());
+	FLobbyRosterEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Member = Member;
+	MarkItemDirty(Entry);
+}
+
+void FLobbyRoster::Remove(int32 PlayerId)
+{
+	int32 EntryIndex;
+	if (!EntryIndexByPlayerId.RemoveAndCopyValue(PlayerId, EntryIndex)) return;
+
+	Entries.RemoveAtSwap(EntryIndex);
+	if (Entries.IsValidIndex(EntryIndex))
+	{
+		EntryIndexByPlayerId[Entries[EntryIndex].Member.PlayerId] = EntryIndex;
+	}
+	MarkArrayDirty();
+}
+
+ULobbyRosterSubsystem* FLobbyRoster::GetRosterSubsystem() const
+{
+	const UWorld* World = Owner ? Owner->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<ULobbyRosterSubsystem>() : nullptr;
+}
+
+ALobbyGameState::ALobbyGameState()
+{
+	Roster.Owner = this;
+	NetDormancy = DORM_DormantAll;
+	// 大厅不需要精确的服务器时间，每次同步都要唤醒一次
+	ServerWorldTimeSecondsUpdateFrequency = 5.f;
+}
+
+void ALobbyGameState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	FDoRepLifetimeParams Params;
+	Params.bIsPushBased = true;
+	DOREPLIFETIME_WITH_PARAMS_FAST(ALobbyGameState, Roster, Params);
+	DOREPLIFETIME_WITH_PARAMS_FAST(ALobbyGameState, NaiveRoster, Params);
+}
+
+void ALobbyGameState::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	if (HasAuthority())
+	{
+		bNaiveRosterReplication = FParse::Param(FCommandLine::Get(), TEXT("NaiveLobbyReplication"));
+	}
+}
+
+void ALobbyGameState::WriteRosterMember(const FLobbyMember& Member)
+{
+	if (bNaiveRosterReplication)
+	{
+		FLobbyMember* Existing = NaiveRoster.FindByPredicate([&Member](const FLobbyMember& Other) { return Other.PlayerId == Member.PlayerId; });
+		if (Existing)
+		{
+			*Existing = Member;
+		}
+		else
+		{
+			NaiveRoster.Add(Member);
+		}
+	}
+	else
+	{
+		Roster.AddOrUpdate(Member);
+	}
+	MarkRosterDirty();
+}
+
+void ALobbyGameState::RemoveRosterMember(int32 PlayerId)
+{
+	if (bNaiveRosterReplication)
+	{
+		NaiveRoster.RemoveAll([PlayerId](const FLobbyMember& Member) { return Member.PlayerId == PlayerId; });
+	}
+	else
+	{
+		Roster.Remove(PlayerId);
+	}
+	MarkRosterDirty();
+}
+
+void ALobbyGameState::MarkRosterDirty()
+{
+	if (bNaiveRosterReplication)
+	{
+		MARK_PROPERTY_DIRTY_FROM_NAME(ALobbyGameState, NaiveRoster, this);
+	}
+	else
+	{
+		MARK_PROPERTY_DIRTY_FROM_NAME(ALobbyGameState, Roster, this);
+	}
+	FlushNetDormancy();
+}
+
+void ALobbyGameState::UpdateServerTimeSeconds()
+{
+	FlushNetDormancy();
+	Super::UpdateServerTimeSeconds();
+}
+
+void ALobbyGameState::OnRep_NaiveRoster()
+{
+	if (ULobbyRosterSubsystem* RosterSubsystem = GetWorld()->GetSubsystem<ULobbyRosterSubsystem>())
+	{
+		RosterSubsystem->HandleReplicatedRoster(NaiveRoster);
+	}
+}
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/LobbyPlayerState.h"
+
+#include "Game/LobbyRosterSubsystem.h"
+
+void ALobbyPlayerState::ServerSetReady_Implementation(bool bReady)
+{
+	if (ULobbyRosterSubsystem* RosterSubsystem = GetRosterSubsystem())
+	{
+		RosterSubsystem->SetMemberState(GetPlayerId(), bReady ? ELobbyMemberState::Ready : ELobbyMemberState::Connected);
+	}
+}
+
+void ALobbyPlayerState::ServerSetTeam_Implementation(uint8 Team)
+{
+	if (ULobbyRosterSubsystem* RosterSubsystem = GetRosterSubsystem())
+	{
+		RosterSubsystem->SetMemberTeam(GetPlayerId(), Team);
+	}
+}
+
+void ALobbyPlayerState::ServerSetLoadout_Implementation(int32 LoadoutId)
+{
+	if (ULobbyRosterSubsystem* RosterSubsystem = GetRosterSubsystem())
+	{
+		RosterSubsystem->SetMemberLoadout(GetPlayerId(), LoadoutId);
+	}
+}
+
+ULobbyRosterSubsystem* ALobbyPlayerState::GetRosterSubsystem() const
+{
+	const UWorld* World = GetWorld();
+	return World ? World->GetSubsystem<ULobbyRosterSubsystem>() : nullptr;
+}
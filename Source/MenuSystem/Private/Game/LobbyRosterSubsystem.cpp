@@ -0,0 +1,241 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/LobbyRosterSubsystem.h"
+
+#include "Game/LobbyGameState.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/GameStateBase.h"
+#include "TimerManager.h"
+
+bool ULobbyRosterSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void ULobbyRosterSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// 延迟只由服务器定期采样，客户端通过名单收到
+	if (InWorld.GetNetMode() != NM_Client)
+	{
+		InWorld.GetTimerManager().SetTimer(PingRefreshTimerHandle, this, &ThisClass::UpdateMemberPings, PingRefreshInterval, true);
+	}
+}
+
+void ULobbyRosterSubsystem::AddMember(const APlayerState& PlayerState)
+{
+	FLobbyMember Member;
+	Member.PlayerId = PlayerState.GetPlayerId();
+	Member.PlayerName = PlayerState.GetPlayerName();
+	Member.JoinServerTime = GetWorld()->GetTimeSeconds();
+	Member.CompressedPing = PlayerState.GetCompressedPing();
+	Add(Member);
+	WriteToGameState(Member);
+}
+
+void ULobbyRosterSubsystem::RemoveMember(const APlayerState& PlayerState)
+{
+	const int32 PlayerId = PlayerState.GetPlayerId();
+	Remove(PlayerId);
+
+	if (ALobbyGameState* GameState = GetWorld()->GetGameState<ALobbyGameState>())
+	{
+		GameState->RemoveRosterMember(PlayerId);
+	}
+}
+
+void ULobbyRosterSubsystem::SetMemberState(int32 PlayerId, ELobbyMemberState State)
+{
+	ModifyMember(PlayerId, [this, State](FLobbyMember& Member)
+	{
+		if (Member.State == State) return false;
+		SetState(Member, State);
+		return true;
+	});
+}
+
+void ULobbyRosterSubsystem::SetMemberTeam(int32 PlayerId, uint8 Team)
+{
+	ModifyMember(PlayerId, [Team](FLobbyMember& Member)
+	{
+		if (Member.Team == Team) return false;
+		Member.Team = Team;
+		return true;
+	});
+}
+
+void ULobbyRosterSubsystem::SetMemberLoadout(int32 PlayerId, int32 LoadoutId)
+{
+	ModifyMember(PlayerId, [LoadoutId](FLobbyMember& Member)
+	{
+		if (Member.LoadoutId == LoadoutId) return false;
+		Member.LoadoutId = LoadoutId;
+		return true;
+	});
+}
+
+void ULobbyRosterSubsystem::UpdateMemberPings()
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	if (GameState == nullptr) return;
+
+	for (const APlayerState* PlayerState : GameState->PlayerArray)
+	{
+		if (PlayerState == nullptr) continue;
+
+		const uint8 CompressedPing = PlayerState->GetCompressedPing();
+		ModifyMember(PlayerState->GetPlayerId(), [this, CompressedPing](FLobbyMember& Member)
+		{
+			// 延迟小幅抖动不值得占用带宽
+			if (FMath::Abs(CompressedPing - Member.CompressedPing) * 4 < PingReplicationThresholdMs) return false;
+			Member.CompressedPing = CompressedPing;
+			return true;
+		});
+	}
+}
+
+void ULobbyRosterSubsystem::ModifyMember(int32 PlayerId, TFunctionRef<bool(FLobbyMember&)> Modify)
+{
+	FLobbyMember* Member = Members.Find(PlayerId);
+	if (Member == nullptr || !Modify(*Member)) return;
+
+	WriteToGameState(*Member);
+	MarkChanged(PlayerId);
+}
+
+void ULobbyRosterSubsystem::WriteToGameState(const FLobbyMember& Member)
+{
+	if (ALobbyGameState* GameState = GetWorld()->GetGameState<ALobbyGameState>())
+	{
+		GameState->WriteRosterMember(Member);
+	}
+}
+
+void ULobbyRosterSubsystem::MarkChanged(int32 PlayerId)
+{
+	if (!PendingJoined.Contains(PlayerId))
+	{
+		PendingChanged.AddUnique(PlayerId);
+	}
+	ScheduleBroadcast();
+}
+
+void ULobbyRosterSubsystem::HandleReplicatedAdd(const FLobbyMember& Member)
+{
+	Add(Member);
+}
+
+void ULobbyRosterSubsystem::HandleReplicatedChange(const FLobbyMember& Member)
+{
+	FLobbyMember* Existing = Members.Find(Member.PlayerId);
+	if (Existing == nullptr)
+	{
+		Add(Member);
+		return;
+	}
+	SetState(*Existing, Member.State);
+	*Existing = Member;
+	MarkChanged(Member.PlayerId);
+}
+
+void ULobbyRosterSubsystem::HandleReplicatedRemove(const FLobbyMember& Member)
+{
+	Remove(Member.PlayerId);
+}
+
+void ULobbyRosterSubsystem::HandleReplicatedRoster(TArrayView<const FLobbyMember> Roster)
+{
+	TSet<int32> Present;
+	Present.Reserve(Roster.Num());
+	for (const FLobbyMember& Member : Roster)
+	{
+		Present.Add(Member.PlayerId);
+		const FLobbyMember* Existing = Members.Find(Member.PlayerId);
+		if (Existing == nullptr)
+		{
+			Add(Member);
+		}
+		// 整个数组都会重新收到，只报告真正变化的成员
+		else if (Existing->State != Member.State || Existing->Team != Member.Team || Existing->LoadoutId != Member.LoadoutId
+			|| Existing->CompressedPing != Member.CompressedPing || Existing->PlayerName != Member.PlayerName)
+		{
+			HandleReplicatedChange(Member);
+		}
+	}
+
+	TArray<int32> Gone;
+	for (const TPair<int32, FLobbyMember>& Pair : Members)
+	{
+		if (!Present.Contains(Pair.Key))
+		{
+			Gone.Add(Pair.Key);
+		}
+	}
+	for (const int32 PlayerId : Gone)
+	{
+		Remove(PlayerId);
+	}
+}
+
+void ULobbyRosterSubsystem::Add(const FLobbyMember& Member)
+{
+	if (FLobbyMember* Existing = Members.Find(Member.PlayerId))
+	{
+		SetState(*Existing, Member.State);
+		*Existing = Member;
+		MarkChanged(Member.PlayerId);
+		return;
+	}
+	Members.Add(Member.PlayerId, Member);
+	++NumMembersInState[static_cast<int32>(Member.State)];
+
+	PendingJoined.Add(Member.PlayerId);
+	ScheduleBroadcast();
+}
+
+void ULobbyRosterSubsystem::Remove(int32 PlayerId)
+{
+	FLobbyMember Removed;
+	if (!Members.RemoveAndCopyValue(PlayerId, Removed)) return;
+	--NumMembersInState[static_cast<int32>(Removed.State)];
+	PendingChanged.RemoveSwap(PlayerId);
+
+	// 同一帧内加入又离开的玩家两边都不报告
+	if (PendingJoined.RemoveSwap(PlayerId) == 0)
+	{
+		PendingLeft.Add(PlayerId);
+	}
+	ScheduleBroadcast();
+}
+
+void ULobbyRosterSubsystem::SetState(FLobbyMember& Member, ELobbyMemberState State)
+{
+	--NumMembersInState[static_cast<int32>(Member.State)];
+	Member.State = State;
+	++NumMembersInState[static_cast<int32>(State)];
+}
+
+void ULobbyRosterSubsystem::ScheduleBroadcast()
+{
+	if (bBroadcastScheduled) return;
+
+	bBroadcastScheduled = true;
+	GetWorld()->GetTimerManager().SetTimerForNextTick(this, &ThisClass::BroadcastRosterChanged);
+}
+
+void ULobbyRosterSubsystem::BroadcastRosterChanged()
+{
+	bBroadcastScheduled = false;
+	if (PendingJoined.IsEmpty() && PendingLeft.IsEmpty() && PendingChanged.IsEmpty()) return;
+
+	// 先交换出来，监听者在广播里修改名单时会写入新的批次
+	TArray<int32> Joined = MoveTemp(PendingJoined);
+	TArray<int32> Left = MoveTemp(PendingLeft);
+	TArray<int32> Changed = MoveTemp(PendingChanged);
+	PendingJoined.Reset();
+	PendingLeft.Reset();
+	PendingChanged.Reset();
+	OnRosterChanged.Broadcast(Joined, Left, Changed);
+}
@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/LobbyBandwidthBenchmarkSubsystem.h"
+
+#include "Game/LobbyRosterSubsystem.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerState.h"
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "TimerManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogLobbyBandwidthBenchmark, Log, All);
+
+bool ULobbyBandwidthBenchmarkSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return Super::ShouldCreateSubsystem(Outer) && FParse::Param(FCommandLine::Get(), TEXT("LobbyBandwidthBenchmark"));
+}
+
+bool ULobbyBandwidthBenchmarkSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game;
+}
+
+void ULobbyBandwidthBenchmarkSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkClients="), NumClients);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkWarmup="), WarmupSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkSeconds="), BenchmarkSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkEditsPerSecond="), EditsPerSecond);
+	// 与 ALobbyGameState 读取的是同一个开关
+	bNaiveReplication = FParse::Param(FCommandLine::Get(), TEXT("NaiveLobbyReplication"));
+	if (!FParse::Value(FCommandLine::Get(), TEXT("Output="), OutputPath))
+	{
+		const TCHAR* Mode = bNaiveReplication ? TEXT("Naive") : TEXT("FastArray");
+		OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FString::Printf(TEXT("LobbyBandwidth_%s_%d.json"), Mode, NumClients);
+	}
+	// 两种模式编辑同样的成员序列
+	Random.Initialize(NumClients);
+}
+
+void ULobbyBandwidthBenchmarkSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	if (InWorld.GetNetMode() == NM_Client || InWorld.GetNetMode() == NM_Standalone) return;
+
+	InWorld.GetTimerManager().SetTimer(BenchmarkTimerHandle, this, &ThisClass::CheckClients, 1.f, true);
+	UE_LOG(LogLobbyBandwidthBenchmark, Log, TEXT("Waiting for %d clients, roster replication %s"), NumClients,
+		bNaiveReplication ? TEXT("naive") : TEXT("fast array"));
+}
+
+void ULobbyBandwidthBenchmarkSubsystem::CheckClients()
+{
+	const AGameModeBase* GameMode = GetWorld()->GetAuthGameMode();
+	if (GameMode == nullptr || GameMode->GetNumPlayers() < NumClients) return;
+
+	UE_LOG(LogLobbyBandwidthBenchmark, Log, TEXT("%d clients in, sampling in %.0fs"), GameMode->GetNumPlayers(), WarmupSeconds);
+	GetWorld()->GetTimerManager().SetTimer(BenchmarkTimerHandle, this, &ThisClass::StartSampling, FMath::Max(WarmupSeconds, 0.01f), false);
+}
+
+void ULobbyBandwidthBenchmarkSubsystem::StartSampling()
+{
+	StartOutBytes.Reset();
+	if (const UNetDriver* NetDriver = GetWorld()->GetNetDriver())
+	{
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			StartOutBytes.Add(Connection, Connection->OutTotalBytes);
+		}
+	}
+	NumEdits = 0;
+	SamplingStartTime = FPlatformTime::Seconds();
+
+	FTimerManager& TimerManager = GetWorld()->GetTimerManager();
+	TimerManager.SetTimer(EditTimerHandle, this, &ThisClass::EditRoster, 1.f / FMath::Max(EditsPerSecond, 0.01f), true);
+	TimerManager.SetTimer(BenchmarkTimerHandle, this, &ThisClass::FinishBenchmark, FMath::Max(BenchmarkSeconds, 0.01f), false);
+}
+
+void ULobbyBandwidthBenchmarkSubsystem::EditRoster()
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	ULobbyRosterSubsystem* RosterSubsystem = GetWorld()->GetSubsystem<ULobbyRosterSubsystem>();
+	if (GameState == nullptr || RosterSubsystem == nullptr || GameState->PlayerArray.IsEmpty()) return;
+
+	const APlayerState* PlayerState = GameState->PlayerArray[Random.RandRange(0, GameState->PlayerArray.Num() - 1)];
+	const FLobbyMember* Member = PlayerState ? RosterSubsystem->FindMember(PlayerState->GetPlayerId()) : nullptr;
+	if (Member == nullptr) return;
+
+	if (NumEdits % 2 == 0)
+	{
+		RosterSubsystem->SetMemberState(Member->PlayerId, Member->IsReady() ? ELobbyMemberState::Connected : ELobbyMemberState::Ready);
+	}
+	else
+	{
+		RosterSubsystem->SetMemberTeam(Member->PlayerId, Member->Team == 0 ? 1 : 0);
+	}
+	++NumEdits;
+}
+
+void ULobbyBandwidthBenchmarkSubsystem::FinishBenchmark()
+{
+	GetWorld()->GetTimerManager().ClearTimer(EditTimerHandle);
+	const double SampledSeconds = FPlatformTime::Seconds() - SamplingStartTime;
+
+	// 采样期间断开的连接不计
+	TArray<int64> SentBytes;
+	if (const UNetDriver* NetDriver = GetWorld()->GetNetDriver())
+	{
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			if (const int64* StartBytes = StartOutBytes.Find(Connection))
+			{
+				SentBytes.Add(Connection->OutTotalBytes - *StartBytes);
+			}
+		}
+	}
+	int64 TotalBytes = 0;
+	int64 MaxBytes = 0;
+	for (const int64 Bytes : SentBytes)
+	{
+		TotalBytes += Bytes;
+		MaxBytes = FMath::Max(MaxBytes, Bytes);
+	}
+	const double MeanBytes = SentBytes.IsEmpty() ? 0.0 : static_cast<double>(TotalBytes) / SentBytes.Num();
+
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	Json->SetStringField(TEXT("Replication"), bNaiveReplication ? TEXT("Naive") : TEXT("FastArray"));
+	Json->SetNumberField(TEXT("Clients"), SentBytes.Num());
+	Json->SetNumberField(TEXT("Seconds"), SampledSeconds);
+	Json->SetNumberField(TEXT("Edits"), NumEdits);
+	Json->SetNumberField(TEXT("MeanBytesPerConnection"), MeanBytes);
+	Json->SetNumberField(TEXT("MaxBytesPerConnection"), static_cast<double>(MaxBytes));
+	Json->SetNumberField(TEXT("MeanBytesPerConnectionPerSecond"), SampledSeconds > 0.0 ? MeanBytes / SampledSeconds : 0.0);
+	Json->SetNumberField(TEXT("TotalBytesPerSecond"), SampledSeconds > 0.0 ? TotalBytes / SampledSeconds : 0.0);
+
+	FString Output;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Json, Writer);
+	if (FFileHelper::SaveStringToFile(Output, *OutputPath))
+	{
+		UE_LOG(LogLobbyBandwidthBenchmark, Display, TEXT("Wrote %s"), *OutputPath);
+	}
+	else
+	{
+		UE_LOG(LogLobbyBandwidthBenchmark, Error, TEXT("Could not write %s"), *OutputPath);
+	}
+	UE_LOG(LogLobbyBandwidthBenchmark, Display, TEXT("%s"), *Output);
+
+	FPlatformMisc::RequestExit(false);
+}
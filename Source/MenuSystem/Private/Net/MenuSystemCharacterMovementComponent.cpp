@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/MenuSystemCharacterMovementComponent.h"
+
+#include "Engine/Player.h"
+#include "Engine/World.h"
+#include "GameFramework/GameNetworkManager.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerController.h"
+
+namespace MenuSystemMovement
+{
+	class FSavedMove : public FSavedMove_Character
+	{
+	public:
+		explicit FSavedMove(float InAccelDotThresholdCombine)
+		{
+			AccelDotThresholdCombine = InAccelDotThresholdCombine;
+		}
+	};
+
+	class FPredictionData : public FNetworkPredictionData_Client_Character
+	{
+	public:
+		explicit FPredictionData(const UMenuSystemCharacterMovementComponent& ClientMovement)
+			: FNetworkPredictionData_Client_Character(ClientMovement)
+			, AccelDotThresholdCombine(ClientMovement.AccelDotThresholdCombine)
+		{
+		}
+
+		virtual FSavedMovePtr AllocateNewMove() override
+		{
+			return FSavedMovePtr(new FSavedMove(AccelDotThresholdCombine));
+		}
+
+	private:
+		float AccelDotThresholdCombine;
+	};
+}
+
+FNetworkPredictionData_Client* UMenuSystemCharacterMovementComponent::GetPredictionData_Client() const
+{
+	if (ClientPredictionData == nullptr)
+	{
+		UMenuSystemCharacterMovementComponent* MutableThis = const_cast<UMenuSystemCharacterMovementComponent*>(this);
+		MutableThis->ClientPredictionData = new MenuSystemMovement::FPredictionData(*this);
+	}
+	return ClientPredictionData;
+}
+
+float UMenuSystemCharacterMovementComponent::GetClientNetSendDeltaTime(const APlayerController* PC, const FNetworkPredictionData_Client_Character* ClientData, const FSavedMovePtr& NewMove) const
+{
+	// 与引擎的实现相同，只是频率来自这个组件而不是全局的 GameNetworkManager
+	float NetMoveDelta = NetSendMoveDeltaTime;
+	const UPlayer* Player = PC ? PC->Player : nullptr;
+	if (Player == nullptr) return NetMoveDelta;
+
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	const bool bThrottled = Player->CurrentNetSpeed <= NetSendMoveThrottleAtNetSpeed
+		|| (GameState && GameState->PlayerArray.Num() > NetSendMoveThrottleOverPlayerCount);
+	if (bThrottled)
+	{
+		// 慢速连接上每秒的移动 RPC 不能超过带宽
+		const float MoveRepSize = GetDefault<AGameNetworkManager>()->MoveRepSize;
+		NetMoveDelta = FMath::Max(NetSendMoveDeltaTimeThrottled, 2.f * MoveRepSize / FMath::Max(Player->CurrentNetSpeed, 1));
+	}
+
+	// 站着不动、镜头也没转时再降低频率
+	if (Acceleration.IsZero() && Velocity.IsZero() && ClientData && ClientData->LastAckedMove.IsValid() && ClientData->LastAckedMove->IsMatchingStartControlRotation(PC))
+	{
+		NetMoveDelta = FMath::Max(NetSendMoveDeltaTimeStationary, NetMoveDelta);
+	}
+	return NetMoveDelta;
+}
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/MenuSystemReplicationGraph.h"
+
+#include "ReplicationGraphTypes.h"
+#include "Engine/LevelScriptActor.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerState.h"
+#include "UObject/UObjectIterator.h"
+
+void UMenuSystemReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	ClassRepNodePolicies.InitNewElement = [this](UClass* Class, EMenuSystemRepNodeMapping& NodeMapping) -> bool
+	{
+		NodeMapping = GetMappingPolicy(Class);
+		return true;
+	};
+
+	// 每个会复制的类按自己的 NetUpdateFrequency 和裁剪距离设置复制间隔
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		if (!Class->IsChildOf(AActor::StaticClass()) || Class->HasAnyClassFlags(CLASS_Abstract | CLASS_Deprecated | CLASS_NewerVersionExists)) continue;
+
+		const AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject());
+		if (ActorCDO == nullptr || !ActorCDO->GetIsReplicated()) continue;
+
+		FClassReplicationInfo ClassInfo;
+		ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(ActorCDO->GetNetUpdateFrequency());
+		ClassInfo.SetCullDistanceSquared(Class->IsChildOf(ACharacter::StaticClass())
+			? FMath::Square(CharacterCullDistance)
+			: ActorCDO->GetNetCullDistanceSquared());
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+EMenuSystemRepNodeMapping UMenuSystemReplicationGraph::GetMappingPolicy(const UClass* Class)
+{
+	const AActor* ActorCDO = Class ? Cast<AActor>(Class->GetDefaultObject()) : nullptr;
+	if (ActorCDO == nullptr || !ActorCDO->GetIsReplicated()) return EMenuSystemRepNodeMapping::NotRouted;
+
+	// InitNewElement 只看到具体的类，子类（例如 ALobbyPlayerState）要按父类判断，而且要在 bAlwaysRelevant 之前
+	if (Class->IsChildOf(APlayerState::StaticClass())) return EMenuSystemRepNodeMapping::PlayerState;
+	if (Class->IsChildOf(AReplicationGraphDebugActor::StaticClass()) || Class->IsChildOf(ALevelScriptActor::StaticClass())) return EMenuSystemRepNodeMapping::NotRouted;
+	if (ActorCDO->bOnlyRelevantToOwner) return EMenuSystemRepNodeMapping::NotRouted;
+	if (ActorCDO->bAlwaysRelevant) return EMenuSystemRepNodeMapping::RelevantAllConnections;
+	if (!ActorCDO->IsRootComponentMovable()) return EMenuSystemRepNodeMapping::Spatialize_Static;
+	return ActorCDO->NetDormancy > DORM_Awake ? EMenuSystemRepNodeMapping::Spatialize_Dormancy : EMenuSystemRepNodeMapping::Spatialize_Dynamic;
+}
+
+void UMenuSystemReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = GridCellSize;
+	GridNode->SpatialBias = SpatialBias;
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+
+	PlayerStateNode = CreateNewNode<UReplicationGraphNode_PlayerStateFrequencyLimiter>();
+	PlayerStateNode->TargetActorsPerFrame = PlayerStatesPerFrame;
+	AddGlobalGraphNode(PlayerStateNode);
+}
+
+void UMenuSystemReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	// 连接自己的控制器、Pawn 和视角目标
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* AlwaysRelevantForConnectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(AlwaysRelevantForConnectionNode, RepGraphConnection);
+}
+
+void UMenuSystemReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	const EMenuSystemRepNodeMapping* Policy = ClassRepNodePolicies.Get(ActorInfo.Class);
+	switch (Policy ? *Policy : EMenuSystemRepNodeMapping::NotRouted)
+	{
+	case EMenuSystemRepNodeMapping::RelevantAllConnections:
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	case EMenuSystemRepNodeMapping::Spatialize_Static:
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		break;
+	case EMenuSystemRepNodeMapping::Spatialize_Dynamic:
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		break;
+	case EMenuSystemRepNodeMapping::Spatialize_Dormancy:
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+		break;
+	default:
+		break;
+	}
+}
+
+void UMenuSystemReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	const EMenuSystemRepNodeMapping* Policy = ClassRepNodePolicies.Get(ActorInfo.Class);
+	switch (Policy ? *Policy : EMenuSystemRepNodeMapping::NotRouted)
+	{
+	case EMenuSystemRepNodeMapping::RelevantAllConnections:
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+	case EMenuSystemRepNodeMapping::Spatialize_Static:
+		GridNode->RemoveActor_Static(ActorInfo);
+		break;
+	case EMenuSystemRepNodeMapping::Spatialize_Dynamic:
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+		break;
+	case EMenuSystemRepNodeMapping::Spatialize_Dormancy:
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+		break;
+	default:
+		break;
+	}
+}
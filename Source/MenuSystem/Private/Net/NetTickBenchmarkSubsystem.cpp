@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/NetTickBenchmarkSubsystem.h"
+
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "TimerManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogNetTickBenchmark, Log, All);
+
+bool UNetTickBenchmarkSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return Super::ShouldCreateSubsystem(Outer) && FParse::Param(FCommandLine::Get(), TEXT("NetTickBenchmark"));
+}
+
+bool UNetTickBenchmarkSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game;
+}
+
+void UNetTickBenchmarkSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkClients="), NumClients);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkWarmup="), WarmupSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchmarkSeconds="), BenchmarkSeconds);
+	if (!FParse::Value(FCommandLine::Get(), TEXT("Output="), OutputPath))
+	{
+		const TCHAR* Path = FParse::Param(FCommandLine::Get(), TEXT("NoReplicationGraph")) ? TEXT("Default") : TEXT("ReplicationGraph");
+		OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FString::Printf(TEXT("NetTick_%s_%d.json"), Path, NumClients);
+	}
+
+	// 在网络驱动之前绑定，所以在它之后执行
+	TickFlushEndHandle = GetWorld()->OnTickFlush().AddUObject(this, &ThisClass::OnTickFlushEnd);
+}
+
+void UNetTickBenchmarkSubsystem::Deinitialize()
+{
+	if (UWorld* World = GetWorld())
+	{
+		World->OnTickFlush().Remove(TickFlushBeginHandle);
+		World->OnTickFlush().Remove(TickFlushEndHandle);
+	}
+	Super::Deinitialize();
+}
+
+void UNetTickBenchmarkSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	if (InWorld.GetNetMode() == NM_Client || InWorld.GetNetMode() == NM_Standalone) return;
+
+	// 在网络驱动之后绑定，所以在它之前执行
+	TickFlushBeginHandle = InWorld.OnTickFlush().AddUObject(this, &ThisClass::OnTickFlushBegin);
+	InWorld.GetTimerManager().SetTimer(BenchmarkTimerHandle, this, &ThisClass::CheckClients, 1.f, true);
+	UE_LOG(LogNetTickBenchmark, Log, TEXT("Waiting for %d clients, replication %s"), NumClients,
+		InWorld.GetNetDriver() && InWorld.GetNetDriver()->GetReplicationDriver() ? TEXT("graph") : TEXT("default"));
+}
+
+void UNetTickBenchmarkSubsystem::OnTickFlushBegin(float DeltaSeconds)
+{
+	FlushBeginTime = FPlatformTime::Seconds();
+	FlushBeginFrame = GFrameCounter;
+}
+
+void UNetTickBenchmarkSubsystem::OnTickFlushEnd(float DeltaSeconds)
+{
+	// 绑定顺序不对时开始时间不属于本帧，这一帧不计
+	if (!bSampling || FlushBeginFrame != GFrameCounter) return;
+	FlushTimesMs.Add((FPlatformTime::Seconds() - FlushBeginTime) * 1000.0);
+}
+
+void UNetTickBenchmarkSubsystem::CheckClients()
+{
+	const AGameModeBase* GameMode = GetWorld()->GetAuthGameMode();
+	if (GameMode == nullptr || GameMode->GetNumPlayers() < NumClients) return;
+
+	UE_LOG(LogNetTickBenchmark, Log, TEXT("%d clients in, sampling in %.0fs"), GameMode->GetNumPlayers(), WarmupSeconds);
+	GetWorld()->GetTimerManager().SetTimer(BenchmarkTimerHandle, this, &ThisClass::StartSampling, FMath::Max(WarmupSeconds, 0.01f), false);
+}
+
+void UNetTickBenchmarkSubsystem::StartSampling()
+{
+	FlushTimesMs.Reset();
+	bSampling = true;
+	SamplingStartTime = FPlatformTime::Seconds();
+	GetWorld()->GetTimerManager().SetTimer(BenchmarkTimerHandle, this, &ThisClass::FinishBenchmark, FMath::Max(BenchmarkSeconds, 0.01f), false);
+}
+
+void UNetTickBenchmarkSubsystem::FinishBenchmark()
+{
+	bSampling = false;
+	const double SampledSeconds = FPlatformTime::Seconds() - SamplingStartTime;
+
+	TArray<double> Sorted = FlushTimesMs;
+	Sorted.Sort();
+	auto Percentile = [&Sorted](double P)
+	{
+		return Sorted.IsEmpty() ? 0.0 : Sorted[FMath::Clamp(FMath::CeilToInt32(P * Sorted.Num()) - 1, 0, Sorted.Num() - 1)];
+	};
+	double TotalMs = 0.0;
+	for (const double Ms : Sorted)
+	{
+		TotalMs += Ms;
+	}
+
+	const UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	const AGameModeBase* GameMode = GetWorld()->GetAuthGameMode();
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	Json->SetStringField(TEXT("Replication"), NetDriver && NetDriver->GetReplicationDriver() ? TEXT("ReplicationGraph") : TEXT("Default"));
+	Json->SetNumberField(TEXT("Clients"), GameMode ? GameMode->GetNumPlayers() : 0);
+	Json->SetNumberField(TEXT("Seconds"), SampledSeconds);
+	Json->SetNumberField(TEXT("Frames"), Sorted.Num());
+	Json->SetNumberField(TEXT("MeanMs"), Sorted.IsEmpty() ? 0.0 : TotalMs / Sorted.Num());
+	Json->SetNumberField(TEXT("P50Ms"), Percentile(0.50));
+	Json->SetNumberField(TEXT("P95Ms"), Percentile(0.95));
+	Json->SetNumberField(TEXT("P99Ms"), Percentile(0.99));
+	Json->SetNumberField(TEXT("MaxMs"), Sorted.IsEmpty() ? 0.0 : Sorted.Last());
+
+	FString Output;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Json, Writer);
+	if (FFileHelper::SaveStringToFile(Output, *OutputPath))
+	{
+		UE_LOG(LogNetTickBenchmark, Display, TEXT("Wrote %s"), *OutputPath);
+	}
+	else
+	{
+		UE_LOG(LogNetTickBenchmark, Error, TEXT("Could not write %s"), *OutputPath);
+	}
+	UE_LOG(LogNetTickBenchmark, Display, TEXT("%s"), *Output);
+
+	FPlatformMisc::RequestExit(false);
+}
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AnimationBudgetSubsystem.generated.h"
+
+class USkeletalMeshComponentBudgeted;
+
+/**
+ * How the budgeted character meshes were treated last frame
+ **/
+struct MENUSYSTEM_API FAnimationBudgetFrameStats
+{
+	int32 NumMeshes{0};
+	int32 NumVisible{0};
+	// Ticked below full rate
+	int32 NumThrottled{0};
+	int32 NumSkippedEvaluation{0};
+	int32 NumInterpolated{0};
+};
+
+/**
+ * Turns on the engine's animation budget allocator for this world and feeds it our significance:
+ * the locally controlled character always updates at full rate, everyone else by distance to the nearest
+ * local view, with a penalty when not rendered. The allocator then throttles (URO), interpolates or skips
+ * the least significant meshes to keep the total inside BudgetInMs.
+ * Characters register their mesh from BeginPlay; "MenuSystem.DumpAnimBudget" prints the last frame.
+ **/
+UCLASS(config = Game)
+class MENUSYSTEM_API UAnimationBudgetSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterMesh(USkeletalMeshComponentBudgeted* Mesh);
+	void UnregisterMesh(USkeletalMeshComponentBudgeted* Mesh);
+
+	// Higher is more important; called by the allocator on the game thread
+	float CalculateSignificance(const USkeletalMeshComponentBudgeted& Mesh) const;
+
+	bool IsBudgetEnabled() const { return bBudgetEnabled; }
+	const FAnimationBudgetFrameStats& GetFrameStats() const { return FrameStats; }
+
+private:
+	void UpdateViewLocations();
+	void UpdateFrameStats();
+
+	TArray<TWeakObjectPtr<USkeletalMeshComponentBudgeted>> Meshes;
+	// Every local player's view this frame, split screen included
+	TArray<FVector> ViewLocations;
+	FAnimationBudgetFrameStats FrameStats;
+	bool bBudgetEnabled{false};
+
+	UPROPERTY(config)
+	bool bEnableAnimationBudget{true};
+	// Game thread time all budgeted meshes may take per frame
+	UPROPERTY(config)
+	float BudgetInMs{1.f};
+	// 0-1, how far below full quality the allocator may go under pressure
+	UPROPERTY(config)
+	float MinQuality{0.f};
+	// Slowest a mesh may be ticked, in frames between updates
+	UPROPERTY(config)
+	int32 MaxTickRate{10};
+	UPROPERTY(config)
+	int32 MaxInterpolatedComponents{16};
+	// A character this far from the view has half the significance of one right in front of it
+	UPROPERTY(config)
+	float SignificanceReferenceDistance{1500.f};
+	// Multiplier for characters not rendered recently
+	UPROPERTY(config)
+	float OffscreenSignificanceScale{0.25f};
+};
@@ -6,9 +6,33 @@
 #include "Animation/AnimInstance.h"
 #include "BlasterAnimInstance.generated.h"
 
+class ACharacter;
+class UCharacterMovementComponent;
+
+/**
+ * Everything the anim graph reads, refreshed once per update
+ **/
+USTRUCT(BlueprintType)
+struct MENUSYSTEM_API FBlasterAnimSnapshot
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = Movement)
+	float Speed{0.f};
+	// -1 leaning fully left, 1 fully right
+	UPROPERTY(BlueprintReadOnly, Category = Movement)
+	float Lean{0.f};
+	UPROPERTY(BlueprintReadOnly, Category = Movement)
+	bool bIsInAir{false};
+	UPROPERTY(BlueprintReadOnly, Category = Movement)
+	bool bIsAccelerating{false};
+};
+
 /**
- * 
- */
+ * The game thread only copies a few values off the cached character in NativeUpdateAnimation;
+ * everything derived from them is worked out in NativeThreadSafeUpdateAnimation, so with multi-threaded
+ * animation update the graph and the derivation both run on a worker.
+ **/
 UCLASS()
 class MENUSYSTEM_API UBlasterAnimInstance : public UAnimInstance
 {
@@ -17,4 +41,32 @@ class MENUSYSTEM_API UBlasterAnimInstance : public UAnimInstance
 public:
 	virtual void NativeInitializeAnimation() override;
 	virtual void NativeUpdateAnimation(float DeltaSeconds) override;
+	virtual void NativeThreadSafeUpdateAnimation(float DeltaSeconds) override;
+
+	// Yaw turn rate, in degrees per second, at which Lean reaches 1
+	UPROPERTY(EditDefaultsOnly, Category = Movement)
+	float FullLeanYawRate{180.f};
+	UPROPERTY(EditDefaultsOnly, Category = Movement)
+	float LeanInterpSpeed{6.f};
+
+protected:
+	UPROPERTY(BlueprintReadOnly, Category = Movement)
+	FBlasterAnimSnapshot Movement;
+
+private:
+	// 取不到时（编辑器预览、Pawn 还没生成完）下一帧再试
+	bool CacheOwner();
+
+	UPROPERTY(Transient)
+	TObjectPtr<ACharacter> Character;
+	UPROPERTY(Transient)
+	TObjectPtr<UCharacterMovementComponent> CharacterMovement;
+
+	// Copied on the game thread, read on the worker
+	FVector Velocity{FVector::ZeroVector};
+	float Yaw{0.f};
+	float LastYaw{0.f};
+	bool bFalling{false};
+	bool bHasAcceleration{false};
+	bool bHasLastYaw{false};
 };
@@ -6,15 +6,55 @@
 #include "GameFramework/GameModeBase.h"
 #include "LobbyGameMode.generated.h"
 
+class ULobbyRosterSubsystem;
+class UMultiplayerSessionsSubsystem;
+
 /**
- * 
+ * Starts the match once enough players are in and ready, travelling seamlessly so every connection,
+ * player controller and player state carries over while the match map loads behind the transition map
  */
-UCLASS()
+UCLASS(config=Game)
 class MENUSYSTEM_API ALobbyGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
 
 public:
+	ALobbyGameMode();
+
 	virtual void PostLogin(APlayerController* NewPlayer) override;
+	// Players coming back from the match travel seamlessly and never go through PostLogin
+	virtual void HandleSeamlessTravelPlayer(AController*& C) override;
 	virtual void Logout(AController* Exiting) override;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void AddToRoster(const AController& Controller);
+	// One message per batch of joins/leaves instead of one per player
+	void OnRosterChanged(TArrayView<const int32> JoinedPlayerIds, TArrayView<const int32> LeftPlayerIds, TArrayView<const int32> ChangedPlayerIds);
+	// Start or cancel the countdown as the roster crosses the thresholds
+	void UpdateMatchStart(const ULobbyRosterSubsystem& RosterSubsystem);
+	bool CanStartMatch(const ULobbyRosterSubsystem& RosterSubsystem) const;
+	void StartMatch();
+	UMultiplayerSessionsSubsystem* GetMultiplayerSessionsSubsystem() const;
+
+	FDelegateHandle RosterChangedDelegateHandle;
+	FTimerHandle MatchStartTimerHandle;
+	bool bMatchStarting{false};
+
+	UPROPERTY(Config)
+	FString MatchMapPath{TEXT("/Game/ThirdPerson/Maps/ThirdPersonMap")};
+	UPROPERTY(Config)
+	int32 MinPlayersToStart{2};
+	// 0-1 of the players in the lobby that have to be ready
+	UPROPERTY(Config)
+	float RequiredReadyFraction{1.f};
+	// Start without waiting for ready once this many are in, 0 to always wait
+	UPROPERTY(Config)
+	int32 NumPlayersToStartImmediately{0};
+	// Seconds between the thresholds being met and the travel, for late ready changes to cancel it
+	UPROPERTY(Config)
+	float MatchStartCountdown{5.f};
 };
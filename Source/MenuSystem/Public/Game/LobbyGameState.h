@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "Game/LobbyRosterSubsystem.h"
+#include "LobbyGameState.generated.h"
+
+class ALobbyGameState;
+struct FLobbyRoster;
+
+USTRUCT()
+struct FLobbyRosterEntry : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FLobbyMember Member;
+
+	void PostReplicatedAdd(const FLobbyRoster& InArraySerializer);
+	void PostReplicatedChange(const FLobbyRoster& InArraySerializer);
+	void PreReplicatedRemove(const FLobbyRoster& InArraySerializer);
+};
+
+/**
+ * Replicated lobby roster: only the entries that changed go over the wire, and clients get one callback per entry
+ * which they hand to ULobbyRosterSubsystem
+ **/
+USTRUCT()
+struct FLobbyRoster : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	// Server only, through ALobbyGameState so the property gets marked dirty
+	void AddOrUpdate(const FLobbyMember& Member);
+	void Remove(int32 PlayerId);
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FLobbyRosterEntry, FLobbyRoster>(Entries, DeltaParms, *this);
+	}
+
+	ULobbyRosterSubsystem* GetRosterSubsystem() const;
+
+	UPROPERTY()
+	TArray<FLobbyRosterEntry> Entries;
+
+	UPROPERTY(NotReplicated)
+	TObjectPtr<ALobbyGameState> Owner;
+
+private:
+	// Server side index into Entries by player id; removal swaps the last entry in, order doesn't matter to the fast array
+	TMap<int32, int32> EntryIndexByPlayerId;
+};
+
+template<>
+struct TStructOpsTypeTraits<FLobbyRoster> : public TStructOpsTypeTraitsBase2<FLobbyRoster>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * Dormant between roster edits: the roster is push based, and every edit flushes dormancy,
+ * so an idle lobby costs the net driver nothing per frame.
+ * Run the server with -NaiveLobbyReplication to replicate the whole roster as a plain array instead;
+ * ULobbyBandwidthBenchmarkSubsystem measures the two against each other.
+ */
+UCLASS()
+class MENUSYSTEM_API ALobbyGameState : public AGameStateBase
+{
+	GENERATED_BODY()
+
+public:
+	ALobbyGameState();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PostInitializeComponents() override;
+
+	/**
+	 * Server only, called by ULobbyRosterSubsystem
+	 **/
+	void WriteRosterMember(const FLobbyMember& Member);
+	void RemoveRosterMember(int32 PlayerId);
+
+	// Read it through ULobbyRosterSubsystem, which has it indexed
+	UPROPERTY(Replicated)
+	FLobbyRoster Roster;
+
+protected:
+	// The world time sync has to get through dormancy too
+	virtual void UpdateServerTimeSeconds() override;
+
+	UFUNCTION()
+	void OnRep_NaiveRoster();
+
+private:
+	void MarkRosterDirty();
+
+	// Only filled with -NaiveLobbyReplication, resent whole on every edit
+	UPROPERTY(ReplicatedUsing = OnRep_NaiveRoster)
+	TArray<FLobbyMember> NaiveRoster;
+
+	bool bNaiveRosterReplication{false};
+};
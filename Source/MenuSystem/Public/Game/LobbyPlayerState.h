@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/PlayerState.h"
+#include "LobbyPlayerState.generated.h"
+
+/**
+ * Lobby choices a client makes for itself, sent to the server which writes them into the roster
+ */
+UCLASS()
+class MENUSYSTEM_API ALobbyPlayerState : public APlayerState
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(Server, Reliable, BlueprintCallable)
+	void ServerSetReady(bool bReady);
+	UFUNCTION(Server, Reliable, BlueprintCallable)
+	void ServerSetTeam(uint8 Team);
+	UFUNCTION(Server, Reliable, BlueprintCallable)
+	void ServerSetLoadout(int32 LoadoutId);
+
+private:
+	class ULobbyRosterSubsystem* GetRosterSubsystem() const;
+};
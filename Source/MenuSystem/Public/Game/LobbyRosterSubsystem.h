@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "LobbyRosterSubsystem.generated.h"
+
+class APlayerState;
+
+UENUM(BlueprintType)
+enum class ELobbyMemberState : uint8
+{
+	Connected,
+	Ready
+};
+
+USTRUCT(BlueprintType)
+struct MENUSYSTEM_API FLobbyMember
+{
+	GENERATED_BODY()
+
+	// APlayerState::GetPlayerId, unique on this server
+	UPROPERTY(BlueprintReadOnly)
+	int32 PlayerId{INDEX_NONE};
+	UPROPERTY(BlueprintReadOnly)
+	FString PlayerName;
+	UPROPERTY(BlueprintReadOnly)
+	ELobbyMemberState State{ELobbyMemberState::Connected};
+	// Server world time of the join
+	UPROPERTY(BlueprintReadOnly)
+	float JoinServerTime{0.f};
+	UPROPERTY(BlueprintReadOnly)
+	uint8 Team{0};
+	UPROPERTY(BlueprintReadOnly)
+	int32 LoadoutId{0};
+	// Ping / 4 like APlayerState's, so it fits a byte
+	UPROPERTY()
+	uint8 CompressedPing{0};
+
+	bool IsReady() const { return State == ELobbyMemberState::Ready; }
+	int32 GetPingInMs() const { return CompressedPing * 4; }
+};
+
+/**
+ * At most once per frame, with every join, leave and change since the last one.
+ * A player who joined and left within the frame is in none of them; a joined player is not also in Changed.
+ **/
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnLobbyRosterChanged, TArrayView<const int32> JoinedPlayerIds, TArrayView<const int32> LeftPlayerIds, TArrayView<const int32> ChangedPlayerIds);
+
+/**
+ * Who is in the lobby, indexed by player id. The server edits it through ALobbyGameMode,
+ * clients get the same edits through ALobbyGameState's fast array.
+ **/
+UCLASS()
+class MENUSYSTEM_API ULobbyRosterSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	/**
+	 * Server only, also written into the replicated roster
+	 **/
+	void AddMember(const APlayerState& PlayerState);
+	void RemoveMember(const APlayerState& PlayerState);
+	void SetMemberState(int32 PlayerId, ELobbyMemberState State);
+	void SetMemberTeam(int32 PlayerId, uint8 Team);
+	void SetMemberLoadout(int32 PlayerId, int32 LoadoutId);
+	// Copy every member's ping from its player state; only pings that moved by PingReplicationThresholdMs dirty the entry
+	void UpdateMemberPings();
+
+	/**
+	 * Called by the replicated roster on clients
+	 **/
+	void HandleReplicatedAdd(const FLobbyMember& Member);
+	void HandleReplicatedChange(const FLobbyMember& Member);
+	void HandleReplicatedRemove(const FLobbyMember& Member);
+	// Whole roster at once, for ALobbyGameState's naive replication; diffed against what we have
+	void HandleReplicatedRoster(TArrayView<const FLobbyMember> Roster);
+
+	UFUNCTION(BlueprintPure)
+	int32 GetNumMembers() const { return Members.Num(); }
+	int32 GetNumMembersInState(ELobbyMemberState State) const { return NumMembersInState[static_cast<int32>(State)]; }
+	const FLobbyMember* FindMember(int32 PlayerId) const { return Members.Find(PlayerId); }
+	const TMap<int32, FLobbyMember>& GetMembers() const { return Members; }
+
+	FOnLobbyRosterChanged OnRosterChanged;
+
+private:
+	void Add(const FLobbyMember& Member);
+	void Remove(int32 PlayerId);
+	void SetState(FLobbyMember& Member, ELobbyMemberState State);
+	// Server side edit of an existing member; Modify returns whether it changed anything worth replicating
+	void ModifyMember(int32 PlayerId, TFunctionRef<bool(FLobbyMember&)> Modify);
+	void WriteToGameState(const FLobbyMember& Member);
+	void MarkChanged(int32 PlayerId);
+	// Queue the batched broadcast for the end of this frame
+	void ScheduleBroadcast();
+	void BroadcastRosterChanged();
+
+	TMap<int32, FLobbyMember> Members;
+	int32 NumMembersInState[static_cast<int32>(ELobbyMemberState::Ready) + 1]{};
+
+	TArray<int32> PendingJoined;
+	TArray<int32> PendingLeft;
+	TArray<int32> PendingChanged;
+	bool bBroadcastScheduled{false};
+
+	FTimerHandle PingRefreshTimerHandle;
+	float PingRefreshInterval{2.f};
+	int32 PingReplicationThresholdMs{20};
+};
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "LobbyBandwidthBenchmarkSubsystem.generated.h"
+
+class UNetConnection;
+
+/**
+ * Server side bytes per connection for comparing ALobbyGameState's fast array + push model roster against
+ * -NaiveLobbyReplication. Only active with -LobbyBandwidthBenchmark; once -BenchmarkClients players are in, it waits
+ * -BenchmarkWarmup seconds, then makes -BenchmarkEditsPerSecond roster edits (ready, team) for -BenchmarkSeconds
+ * while counting what every client connection sends, writes the result as JSON and exits:
+ *
+ *   UnrealEditor MenuSystem /Game/ThirdPerson/Maps/Lobby -server -nosteam -LobbyBandwidthBenchmark -BenchmarkClients=64 [-NaiveLobbyReplication] [-Output=<path>]
+ *   UnrealEditor MenuSystem 127.0.0.1 -game -nullrhi -nosound -nosteam      (once per simulated client)
+ *
+ * Run it at 16, 64 and 100 clients with and without -NaiveLobbyReplication; only the roster differs between the two.
+ **/
+UCLASS()
+class MENUSYSTEM_API ULobbyBandwidthBenchmarkSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+private:
+	void CheckClients();
+	void StartSampling();
+	// One edit of a random member, alternating between its ready state and its team
+	void EditRoster();
+	void FinishBenchmark();
+
+	FTimerHandle BenchmarkTimerHandle;
+	FTimerHandle EditTimerHandle;
+
+	int32 NumClients{16};
+	float WarmupSeconds{5.f};
+	float BenchmarkSeconds{30.f};
+	float EditsPerSecond{10.f};
+	FString OutputPath;
+	bool bNaiveReplication{false};
+
+	FRandomStream Random;
+	int32 NumEdits{0};
+	double SamplingStartTime{0.0};
+	// UNetConnection::OutTotalBytes of every client connection when sampling started
+	TMap<TWeakObjectPtr<UNetConnection>, int64> StartOutBytes;
+};
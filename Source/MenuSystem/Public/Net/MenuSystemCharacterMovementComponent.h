@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "MenuSystemCharacterMovementComponent.generated.h"
+
+/**
+ * AMenuSystemCharacter's movement, with its own client move send rates instead of the GameNetworkManager's,
+ * which apply to every pawn. A lobby full of players mostly walks in a straight line or stands still,
+ * so moves are sent less often and saved moves with nearly the same acceleration are combined into one.
+ **/
+UCLASS(config = Game)
+class MENUSYSTEM_API UMenuSystemCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+public:
+	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+
+	// Two saved moves are combined while the cosine between their accelerations stays above this (engine: 0.996)
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Character Movement (Networking)")
+	float AccelDotThresholdCombine{0.98f};
+
+protected:
+	virtual float GetClientNetSendDeltaTime(const APlayerController* PC, const FNetworkPredictionData_Client_Character* ClientData, const FSavedMovePtr& NewMove) const override;
+
+	// Seconds between two move RPCs
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Character Movement (Networking)")
+	float NetSendMoveDeltaTime{1.f / 30.f};
+	// Used instead with more than NetSendMoveThrottleOverPlayerCount players, or on a slow connection
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Character Movement (Networking)")
+	float NetSendMoveDeltaTimeThrottled{0.05f};
+	// Used while neither moving nor turning the camera
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Character Movement (Networking)")
+	float NetSendMoveDeltaTimeStationary{0.1f};
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Character Movement (Networking)")
+	int32 NetSendMoveThrottleOverPlayerCount{24};
+	// Bytes per second
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Character Movement (Networking)")
+	int32 NetSendMoveThrottleAtNetSpeed{15000};
+};
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "MenuSystemReplicationGraph.generated.h"
+
+class UReplicationGraphNode_GridSpatialization2D;
+class UReplicationGraphNode_ActorList;
+class UReplicationGraphNode_PlayerStateFrequencyLimiter;
+
+// Which node a replicated class is routed to, worked out once per class
+enum class EMenuSystemRepNodeMapping : uint8
+{
+	// Owner-only actors (player controllers) come from the per-connection node
+	NotRouted,
+	RelevantAllConnections,
+	// Gathered by the player state frequency limiter itself
+	PlayerState,
+	Spatialize_Static,
+	Spatialize_Dynamic,
+	Spatialize_Dormancy
+};
+
+/**
+ * Replaces the per-actor relevancy pass, which checks every actor against every connection each net tick:
+ * - characters and other movable actors go into a 2D spatial grid, so a connection only looks at nearby cells
+ * - game state and other always-relevant actors sit in one list shared by every connection
+ * - player states are spread over frames in buckets of PlayerStatesPerFrame per connection
+ * - each connection's own controller, pawn and view target come from a per-connection node
+ * Installed for the game net driver by FMenuSystemModule unless -NoReplicationGraph is given.
+ **/
+UCLASS(transient, config = Engine)
+class MENUSYSTEM_API UMenuSystemReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+public:
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+
+	UPROPERTY()
+	TObjectPtr<UReplicationGraphNode_GridSpatialization2D> GridNode;
+	UPROPERTY()
+	TObjectPtr<UReplicationGraphNode_ActorList> AlwaysRelevantNode;
+	UPROPERTY()
+	TObjectPtr<UReplicationGraphNode_PlayerStateFrequencyLimiter> PlayerStateNode;
+
+private:
+	EMenuSystemRepNodeMapping GetMappingPolicy(const UClass* Class);
+
+	TClassMap<EMenuSystemRepNodeMapping> ClassRepNodePolicies;
+
+	UPROPERTY(config)
+	float GridCellSize{5000.f};
+	// Added to actor locations so the whole map falls into positive grid coordinates
+	UPROPERTY(config)
+	FVector2D SpatialBias{-100000.f, -100000.f};
+	// Characters further away than this are not replicated to a connection at all
+	UPROPERTY(config)
+	float CharacterCullDistance{15000.f};
+	UPROPERTY(config)
+	int32 PlayerStatesPerFrame{4};
+};
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "NetTickBenchmarkSubsystem.generated.h"
+
+/**
+ * Server side net tick timing for comparing UMenuSystemReplicationGraph against the default relevancy path.
+ * Only active with -NetTickBenchmark; once -BenchmarkClients players are in, it waits -BenchmarkWarmup seconds,
+ * times every net tick flush for -BenchmarkSeconds, writes the result as JSON and exits:
+ *
+ *   UnrealEditor MenuSystem /Game/ThirdPerson/Maps/Lobby -server -nosteam -NetTickBenchmark -BenchmarkClients=64 [-NoReplicationGraph] [-Output=<path>]
+ *   UnrealEditor MenuSystem 127.0.0.1 -game -nullrhi -nosound -nosteam      (once per simulated client)
+ *
+ * Run it at 16, 64 and 100 clients with and without -NoReplicationGraph.
+ **/
+UCLASS()
+class MENUSYSTEM_API UNetTickBenchmarkSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+private:
+	/**
+	 * The world's tick flush delegate runs its bindings newest first. The net driver binds between Initialize
+	 * and OnWorldBeginPlay, so the binding added in OnWorldBeginPlay runs before it and the one added
+	 * in Initialize after it; together they bracket the flush.
+	 **/
+	void OnTickFlushBegin(float DeltaSeconds);
+	void OnTickFlushEnd(float DeltaSeconds);
+	void CheckClients();
+	void StartSampling();
+	void FinishBenchmark();
+
+	FDelegateHandle TickFlushBeginHandle;
+	FDelegateHandle TickFlushEndHandle;
+	FTimerHandle BenchmarkTimerHandle;
+
+	int32 NumClients{16};
+	float WarmupSeconds{5.f};
+	float BenchmarkSeconds{30.f};
+	FString OutputPath;
+
+	double FlushBeginTime{0.0};
+	uint64 FlushBeginFrame{0};
+	bool bSampling{false};
+	TArray<double> FlushTimesMs;
+	double SamplingStartTime{0.0};
+};